@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* A simple bump allocator for decoded packet structs. Allocations are never released
+ * individually, the entire arena is reset in one go (typically once per frame).
+ * If a frame needs more memory than the arena has, additional chunks are allocated,
+ * and on the next reset they're folded into a single chunk large enough for the
+ * worst frame seen so far. After warm-up, the arena stops touching the heap.
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_CHUNK (256 * 1024)
+
+struct vanc_arena_chunk_s
+{
+	struct vanc_arena_chunk_s *next;
+	size_t size;
+	size_t used;
+	uint8_t *buf;
+};
+
+struct vanc_arena_s
+{
+	struct vanc_arena_chunk_s *head;	/* Current chunk, allocations come from here. */
+	size_t used;				/* Bytes handed out since the last reset, across all chunks. */
+	size_t highWater;			/* Largest 'used' value we've ever seen at reset time. */
+	uint64_t chunkAllocations;		/* Number of times we've had to go back to the heap. */
+};
+
+static struct vanc_arena_chunk_s *arena_chunk_alloc(size_t size)
+{
+	struct vanc_arena_chunk_s *c = malloc(sizeof(*c) + size + ARENA_ALIGN);
+	if (!c)
+		return NULL;
+
+	c->next = NULL;
+	c->size = size;
+	c->used = 0;
+	c->buf = (uint8_t *)(((uintptr_t)(c + 1) + (ARENA_ALIGN - 1)) & ~(uintptr_t)(ARENA_ALIGN - 1));
+
+	return c;
+}
+
+static void arena_chunks_free(struct vanc_arena_chunk_s *c)
+{
+	while (c) {
+		struct vanc_arena_chunk_s *next = c->next;
+		free(c);
+		c = next;
+	}
+}
+
+int vanc_context_enable_arena(struct vanc_context_s *ctx, unsigned int sizeBytes)
+{
+	VALIDATE(ctx);
+	VALIDATE(ctx->priv);
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	if (priv->arena)
+		return KLAPI_OK;
+
+	struct vanc_arena_s *a = calloc(1, sizeof(*a));
+	if (!a)
+		return -ENOMEM;
+
+	if (sizeBytes < ARENA_MIN_CHUNK)
+		sizeBytes = ARENA_MIN_CHUNK;
+
+	a->head = arena_chunk_alloc(sizeBytes);
+	if (!a->head) {
+		free(a);
+		return -ENOMEM;
+	}
+	a->chunkAllocations++;
+
+	priv->arena = a;
+	return KLAPI_OK;
+}
+
+void vanc_context_arena_reset(struct vanc_context_s *ctx)
+{
+	if (!ctx || !ctx->priv)
+		return;
+
+	struct vanc_arena_s *a = getPrivate(ctx)->arena;
+	if (!a)
+		return;
+
+	if (a->used > a->highWater)
+		a->highWater = a->used;
+
+	if (a->head->next) {
+		/* We overflowed during this frame, replace all chunks with a single
+		 * chunk that would have accommodated the entire frame.
+		 */
+		struct vanc_arena_chunk_s *c = arena_chunk_alloc(a->highWater + (a->highWater / 4));
+		if (c) {
+			arena_chunks_free(a->head);
+			a->head = c;
+			a->chunkAllocations++;
+		} else {
+			/* Keep the largest chunk we have, drop the rest. */
+			arena_chunks_free(a->head->next);
+			a->head->next = NULL;
+		}
+	}
+
+	a->head->used = 0;
+	a->used = 0;
+}
+
+void vanc_arena_free(struct vanc_context_s *ctx)
+{
+	struct vanc_arena_s *a = getPrivate(ctx)->arena;
+	if (!a)
+		return;
+
+	arena_chunks_free(a->head);
+	free(a);
+	getPrivate(ctx)->arena = NULL;
+}
+
+static int arena_contains(struct vanc_arena_s *a, void *p)
+{
+	for (struct vanc_arena_chunk_s *c = a->head; c; c = c->next) {
+		if (((uint8_t *)p >= c->buf) && ((uint8_t *)p < c->buf + c->size))
+			return 1;
+	}
+
+	return 0;
+}
+
+void *vanc_malloc(struct vanc_context_s *ctx, size_t size)
+{
+	struct vanc_arena_s *a = ctx->priv ? getPrivate(ctx)->arena : NULL;
+	if (!a)
+		return malloc(size);
+
+	size_t bytes = (size + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+	if (bytes == 0)
+		bytes = ARENA_ALIGN;
+
+	struct vanc_arena_chunk_s *c = a->head;
+	if (c->used + bytes > c->size) {
+		/* Out of space for this frame, chain a new chunk in front of the old. */
+		size_t sz = c->size > bytes ? c->size : bytes;
+		struct vanc_arena_chunk_s *n = arena_chunk_alloc(sz);
+		if (!n)
+			return NULL;
+		a->chunkAllocations++;
+		n->next = c;
+		a->head = n;
+		c = n;
+	}
+
+	void *p = c->buf + c->used;
+	c->used += bytes;
+	a->used += bytes;
+
+	return p;
+}
+
+void *vanc_calloc(struct vanc_context_s *ctx, size_t nmemb, size_t size)
+{
+	if (!ctx->priv || !getPrivate(ctx)->arena)
+		return calloc(nmemb, size);
+
+	void *p = vanc_malloc(ctx, nmemb * size);
+	if (p)
+		memset(p, 0, nmemb * size);
+
+	return p;
+}
+
+void vanc_free(struct vanc_context_s *ctx, void *p)
+{
+	if (!p)
+		return;
+
+	struct vanc_arena_s *a = ctx->priv ? getPrivate(ctx)->arena : NULL;
+	if (a && arena_contains(a, p)) {
+		/* Released in bulk by vanc_context_arena_reset() */
+		return;
+	}
+
+	free(p);
+}
@@ -19,7 +19,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
-/* By design, non of these funcs use the mutex, caller handles locking. */
+/* Each buffer is a single heap allocation, a list node and bookkeeping followed by
+ * the data area. Buffers are tracked on a per size class busy or free list, all list
+ * and stats manipulation happens under the pool mutex.
+ */
 
 #include <libklvanc/vanc.h>
 
@@ -28,40 +31,163 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
+
+#define BUFFER_ALIGN 16
+#define BUFFER_MIN_SHIFT 8	/* Smallest class is 256 bytes */
 
-int vanc_buffer_dump(struct buffer_s *buf)
+struct buffer_entry_s
 {
-	VALIDATE(buf);
-	printf("  buf %p nr = %d ctx = %p\n", (void *)buf, buf->nr, (void *)buf->ctx);
-	return KLAPI_OK;
+	struct xorg_list list;
+	struct vanc_buffer_pool_s *pool;
+	int cls;			/* -1 for oversize buffers, which aren't pooled. */
+	struct buffer_s buf;
+};
+
+struct vanc_buffer_pool_s
+{
+	pthread_mutex_t mutex;
+	struct xorg_list freeList[VANC_BUFFER_CLASSES];
+	struct xorg_list busyList[VANC_BUFFER_CLASSES];
+	struct vanc_buffer_pool_stats_s stats;
+};
+
+static struct vanc_buffer_pool_s *defaultPool;
+static pthread_once_t defaultPoolOnce = PTHREAD_ONCE_INIT;
+
+static void defaultPoolCreate(void)
+{
+	if (vanc_buffer_pool_create(&defaultPool) < 0)
+		vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_CORE, "%s() unable to allocate the default buffer pool\n", __func__);
 }
 
-/* Demonstrate safe list traversal, this could support a direct list delete() */
-int vanc_buffer_dump_list(struct xorg_list *head)
+static struct vanc_buffer_pool_s *getPool(struct vanc_buffer_pool_s *pool)
 {
-	VALIDATE(head);
-	struct buffer_s *iterator = NULL, *next;
-	xorg_list_for_each_entry_safe(iterator, next, head, list) {
-		vanc_buffer_dump(iterator);
+	if (pool)
+		return pool;
+
+	pthread_once(&defaultPoolOnce, defaultPoolCreate);
+	return defaultPool;
+}
+
+static int sizeToClass(size_t sizeBytes)
+{
+	for (int i = 0; i < VANC_BUFFER_CLASSES; i++) {
+		if (sizeBytes <= ((size_t)1 << (BUFFER_MIN_SHIFT + i)))
+			return i;
 	}
 
+	return -1;
+}
+
+static struct buffer_entry_s *entryAlloc(struct vanc_buffer_pool_s *pool, int cls, size_t size)
+{
+	size_t hdr = (sizeof(struct buffer_entry_s) + (BUFFER_ALIGN - 1)) & ~(size_t)(BUFFER_ALIGN - 1);
+
+	struct buffer_entry_s *e;
+	if (posix_memalign((void **)&e, BUFFER_ALIGN, hdr + size) != 0)
+		return NULL;
+
+	xorg_list_init(&e->list);
+	e->pool = pool;
+	e->cls = cls;
+	e->buf.ptr = (uint8_t *)e + hdr;
+	e->buf.size = size;
+
+	return e;
+}
+
+int vanc_buffer_pool_create(struct vanc_buffer_pool_s **pool)
+{
+	VALIDATE(pool);
+
+	struct vanc_buffer_pool_s *p = calloc(1, sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+
+	pthread_mutex_init(&p->mutex, NULL);
+	for (int i = 0; i < VANC_BUFFER_CLASSES; i++) {
+		xorg_list_init(&p->freeList[i]);
+		xorg_list_init(&p->busyList[i]);
+		p->stats.classes[i].size = (size_t)1 << (BUFFER_MIN_SHIFT + i);
+	}
+
+	*pool = p;
 	return KLAPI_OK;
 }
 
-int vanc_buffer_alloc(struct vanc_context_s *ctx, struct buffer_s **pp, unsigned int nr)
+void vanc_buffer_pool_destroy(struct vanc_buffer_pool_s *pool)
+{
+	if (!pool || pool == defaultPool)
+		return;
+
+	struct buffer_entry_s *e, *next;
+	for (int i = 0; i < VANC_BUFFER_CLASSES; i++) {
+		xorg_list_for_each_entry_safe(e, next, &pool->freeList[i], list) {
+			xorg_list_del(&e->list);
+			free(e);
+		}
+		xorg_list_for_each_entry_safe(e, next, &pool->busyList[i], list) {
+			xorg_list_del(&e->list);
+			free(e);
+		}
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+}
+
+int vanc_buffer_alloc(struct vanc_buffer_pool_s *pool, struct buffer_s **pp, size_t sizeBytes)
 {
-	VALIDATE(ctx);
 	VALIDATE(pp);
 
-	struct buffer_s *buf;
-	buf = calloc(1, sizeof(struct buffer_s));
-	if (buf == 0)
+	pool = getPool(pool);
+	if (!pool)
 		return -ENOMEM;
 
-	buf->ctx = ctx;
-	buf->nr = nr;
+	struct buffer_entry_s *e = NULL;
+	int cls = sizeToClass(sizeBytes);
 
-	*pp = buf;
+	if (cls < 0) {
+		e = entryAlloc(pool, -1, sizeBytes);
+		if (!e)
+			return -ENOMEM;
+
+		pthread_mutex_lock(&pool->mutex);
+		pool->stats.oversizeRequests++;
+		pthread_mutex_unlock(&pool->mutex);
+	} else {
+		pthread_mutex_lock(&pool->mutex);
+		if (!xorg_list_is_empty(&pool->freeList[cls])) {
+			e = xorg_list_first_entry(&pool->freeList[cls], struct buffer_entry_s, list);
+			xorg_list_del(&e->list);
+			pool->stats.classes[cls].recycled++;
+		}
+		pthread_mutex_unlock(&pool->mutex);
+
+		/* Miss, grow the class. Allocate outside the lock. */
+		int grown = 0;
+		if (!e) {
+			e = entryAlloc(pool, cls, pool->stats.classes[cls].size);
+			if (!e)
+				return -ENOMEM;
+			grown = 1;
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		xorg_list_add(&e->list, &pool->busyList[cls]);
+		pool->stats.classes[cls].requests++;
+		pool->stats.classes[cls].allocated += grown;
+		pool->stats.classes[cls].inUse++;
+		if (pool->stats.classes[cls].inUse > pool->stats.classes[cls].highWater)
+			pool->stats.classes[cls].highWater = pool->stats.classes[cls].inUse;
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	e->buf.used = 0;
+	e->buf.nr = 0;
+
+	*pp = &e->buf;
 	return KLAPI_OK;
 }
 
@@ -69,8 +195,20 @@ int vanc_buffer_free(struct buffer_s *buf)
 {
 	VALIDATE(buf);
 
-	/* The caller is responsible for removing the buffer form any list. */
-	memset(buf, 0, sizeof(*buf));
+	struct buffer_entry_s *e = container_of(buf, struct buffer_entry_s, buf);
+
+	if (e->cls < 0) {
+		free(e);
+		return KLAPI_OK;
+	}
+
+	struct vanc_buffer_pool_s *pool = e->pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	xorg_list_del(&e->list);
+	xorg_list_add(&e->list, &pool->freeList[e->cls]);
+	pool->stats.classes[e->cls].inUse--;
+	pthread_mutex_unlock(&pool->mutex);
 
 	return KLAPI_OK;
 }
@@ -79,8 +217,44 @@ int vanc_buffer_reset(struct buffer_s *buf)
 {
 	VALIDATE(buf);
 
-	/* Perform any buffer wipes, reset any vars as your library needs */
+	memset(buf->ptr, 0, buf->size);
+	buf->used = 0;
 
 	return KLAPI_OK;
 }
 
+int vanc_buffer_pool_get_stats(struct vanc_buffer_pool_s *pool, struct vanc_buffer_pool_stats_s *stats)
+{
+	VALIDATE(stats);
+
+	pool = getPool(pool);
+	if (!pool)
+		return -ENOMEM;
+
+	pthread_mutex_lock(&pool->mutex);
+	*stats = pool->stats;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return KLAPI_OK;
+}
+
+int vanc_buffer_pool_dump(struct vanc_buffer_pool_s *pool)
+{
+	struct vanc_buffer_pool_stats_s s;
+
+	int ret = vanc_buffer_pool_get_stats(pool, &s);
+	if (ret < 0)
+		return ret;
+
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "Buffer pool %p\n", (void *)getPool(pool));
+	for (int i = 0; i < VANC_BUFFER_CLASSES; i++) {
+		if (s.classes[i].requests == 0)
+			continue;
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  %6zu bytes: requests %" PRIu64 " recycled %" PRIu64 " allocated %u in use %u high water %u\n",
+			s.classes[i].size, s.classes[i].requests, s.classes[i].recycled,
+			s.classes[i].allocated, s.classes[i].inUse, s.classes[i].highWater);
+	}
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  oversize requests %" PRIu64 "\n", s.oversizeRequests);
+
+	return KLAPI_OK;
+}
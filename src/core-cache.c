@@ -21,9 +21,18 @@
 
 #include <libklvanc/vanc.h>
 
+#include "core-private.h"
+
 #include <stdint.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <time.h>
+
+#ifdef CLOCK_REALTIME_COARSE
+#define CACHE_CLOCK_ID CLOCK_REALTIME_COARSE
+#else
+#define CACHE_CLOCK_ID CLOCK_REALTIME
+#endif
 
 /* Maintain a static array of VANC messages, so that at any given time,
  * a user may ask "what message types have I seen on what lines?".
@@ -79,18 +88,25 @@ int vanc_cache_update(struct vanc_context_s *ctx, struct packet_header_s *pkt)
 		s->desc = vanc_lookupDescriptionByType(pkt->type);
 		s->spec = vanc_lookupSpecificationByType(pkt->type);
 	}
-	gettimeofday(&s->lastUpdated, NULL);
+	/* The coarse clock is a vDSO read at a few ns, gettimeofday() isn't. */
+	struct timespec now;
+	clock_gettime(CACHE_CLOCK_ID, &now);
+	s->lastUpdated.tv_sec = now.tv_sec;
+	s->lastUpdated.tv_usec = now.tv_nsec / 1000;
+	s->lastUpdatedMs = ((uint64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
 
 	struct vanc_cache_line_s *line = &s->lines[ pkt->lineNr ];
 	line->active = 1;
 	s->activeCount++;
 
+	/* One header per cache line, allocated on first use then overwritten in place, copying
+	 * only the words this packet uses.
+	 */
 	pthread_mutex_lock(&line->mutex);
-	if (line->pkt) {
-		vanc_packet_free(line->pkt);
-		line->pkt = 0;
-	}
-	vanc_packet_copy(&line->pkt, pkt);
+	if (!line->pkt)
+		line->pkt = malloc(sizeof(*line->pkt));
+	if (line->pkt)
+		vanc_packet_header_copy(line->pkt, pkt);
 	pthread_mutex_unlock(&line->mutex);
 
 	line->count++;
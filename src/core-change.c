@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Change only delivery. For each DID/SDID and line we remember a 64 bit FNV-1a hash of
+ * the last packet delivered, in a small open addressed table, and drop packets whose
+ * hash matches. Only the enabled DID/SDIDs ever reach the table, so it stays a few
+ * dozen entries and lookups are a probe or two.
+ * Types with fields that change every frame whatever the content, the CDP sequence
+ * counters and time code, leave those out of the hash, see hashPacket().
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHANGE_TABLE_MIN 64
+#define CHANGE_REFRESH_DEFAULT_MS 1000
+
+struct change_entry_s
+{
+	uint32_t key;			/* (did << 24) | (sdid << 16) | lineNr */
+	int used;
+	uint64_t hash;
+	uint64_t deliveredMs;
+};
+
+struct vanc_change_only_s
+{
+	uint64_t enabled[65536 / 64];	/* Bitmap indexed by (did << 8) | sdid */
+	unsigned int refreshMs;
+
+	struct change_entry_s *table;
+	unsigned int size;		/* Power of two */
+	unsigned int used;
+};
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+
+static uint64_t hashWords(uint64_t h, const unsigned short *words, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		h ^= words[i];
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+/* CEA-708 CDPs count up in the header and footer, and the CDP checksum follows the
+ * count. A time_code_section, when present, moves on every frame too. Hash the rest of
+ * the packet, so caption padding repeats like any other packet: ADF through cdp_header()
+ * flags, then the sections after any time code up to the footer. The ancillary checksum
+ * word covers all of these, leave it out.
+ */
+static uint64_t hashCDP(const struct packet_view_s *view)
+{
+	const unsigned short *udw = vanc_packet_view_payload(view);
+	unsigned int cdpLength = udw[2] & 0xff;
+
+	if (view->payloadLengthWords < 11 || cdpLength < 11 || cdpLength > view->payloadLengthWords)
+		return hashWords(FNV_OFFSET_BASIS, view->words, view->rawLengthWords);
+
+	/* time_code_present, the section is its id and 4 bytes. */
+	unsigned int start = 7;
+	if ((udw[4] & 0x80) && cdpLength >= 11 + 5 && (udw[7] & 0xff) == 0x71)
+		start += 5;
+
+	uint64_t h = hashWords(FNV_OFFSET_BASIS, view->words, view->payloadOffset + 5);
+	return hashWords(h, udw + start, cdpLength - 4 - start);
+}
+
+static uint64_t hashPacket(const struct packet_view_s *view)
+{
+	if ((view->did & 0xff) == 0x61 && (view->dbnsdid & 0xff) == 0x01)
+		return hashCDP(view);
+
+	return hashWords(FNV_OFFSET_BASIS, view->words, view->rawLengthWords);
+}
+
+static uint32_t keyHash(uint32_t key)
+{
+	key ^= key >> 16;
+	key *= 0x45d9f3b;
+	key ^= key >> 16;
+	return key;
+}
+
+static struct change_entry_s *tableFind(struct change_entry_s *table, unsigned int size, uint32_t key)
+{
+	unsigned int mask = size - 1;
+	unsigned int i = keyHash(key) & mask;
+
+	while (table[i].used && table[i].key != key)
+		i = (i + 1) & mask;
+
+	return &table[i];
+}
+
+static int tableGrow(struct vanc_change_only_s *c)
+{
+	unsigned int size = c->size ? c->size * 2 : CHANGE_TABLE_MIN;
+
+	struct change_entry_s *table = calloc(size, sizeof(*table));
+	if (!table)
+		return -ENOMEM;
+
+	for (unsigned int i = 0; i < c->size; i++) {
+		if (c->table[i].used)
+			*tableFind(table, size, c->table[i].key) = c->table[i];
+	}
+
+	free(c->table);
+	c->table = table;
+	c->size = size;
+
+	return KLAPI_OK;
+}
+
+int vanc_change_only_skip(struct vanc_context_private_s *priv, const struct packet_view_s *view)
+{
+	struct vanc_change_only_s *c = priv->changeOnly;
+
+	unsigned int idx = ((view->did & 0xff) << 8) | (view->dbnsdid & 0xff);
+	if (!(c->enabled[idx >> 6] & (1ULL << (idx & 63))))
+		return 0;
+
+	/* Keep the load under 3/4, if we can't grow just deliver everything. */
+	if ((c->used + 1) * 4 > c->size * 3 && tableGrow(c) < 0)
+		return 0;
+
+	uint32_t key = (idx << 16) | (view->lineNr & 0xffff);
+	uint64_t hash = hashPacket(view);
+
+	struct change_entry_s *e = tableFind(c->table, c->size, key);
+	if (e->used && e->hash == hash) {
+		if (c->refreshMs == 0)
+			return 1;
+
+		uint64_t now = vanc_clock_now_ms();
+		if (now - e->deliveredMs < c->refreshMs)
+			return 1;
+
+		e->deliveredMs = now;
+		return 0;
+	}
+
+	if (!e->used) {
+		e->used = 1;
+		e->key = key;
+		c->used++;
+	}
+	e->hash = hash;
+	e->deliveredMs = c->refreshMs ? vanc_clock_now_ms() : 0;
+
+	return 0;
+}
+
+void vanc_change_only_free(struct vanc_context_s *ctx)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	if (!priv->changeOnly)
+		return;
+
+	free(priv->changeOnly->table);
+	free(priv->changeOnly);
+	priv->changeOnly = NULL;
+}
+
+static struct vanc_change_only_s *changeOnlyGet(struct vanc_context_private_s *priv)
+{
+	if (!priv->changeOnly) {
+		priv->changeOnly = calloc(1, sizeof(struct vanc_change_only_s));
+		if (priv->changeOnly)
+			priv->changeOnly->refreshMs = CHANGE_REFRESH_DEFAULT_MS;
+	}
+
+	return priv->changeOnly;
+}
+
+int vanc_context_set_change_only(struct vanc_context_s *ctx, uint8_t did, uint8_t sdid, int enable)
+{
+	VALIDATE(ctx);
+
+	struct vanc_change_only_s *c = changeOnlyGet(getPrivate(ctx));
+	if (!c)
+		return -ENOMEM;
+
+	unsigned int idx = (did << 8) | sdid;
+	if (enable)
+		c->enabled[idx >> 6] |= (1ULL << (idx & 63));
+	else
+		c->enabled[idx >> 6] &= ~(1ULL << (idx & 63));
+
+	/* Forget what we've seen, so the next packet is delivered whatever the setting. */
+	for (unsigned int i = 0; i < c->size; i++) {
+		if (c->table[i].used && (c->table[i].key >> 16) == idx)
+			c->table[i].hash = 0;
+	}
+
+	return KLAPI_OK;
+}
+
+int vanc_context_set_change_only_refresh(struct vanc_context_s *ctx, unsigned int refreshMs)
+{
+	VALIDATE(ctx);
+
+	struct vanc_change_only_s *c = changeOnlyGet(getPrivate(ctx));
+	if (!c)
+		return -ENOMEM;
+
+	c->refreshMs = refreshMs;
+
+	return KLAPI_OK;
+}
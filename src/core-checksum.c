@@ -25,6 +25,217 @@
 #include <stdio.h>
 #include <stdint.h>
 
+/* Checksum and parity kernels.
+ *
+ * The checksum is a sum modulo 512. Bit 9 of each word carries 512, which vanishes
+ * modulo 512, so there is no need to mask each word, and since 512 divides 65536 the
+ * sum can be accumulated in wrapping 16bit lanes and only masked at the end.
+ *
+ * Parity uses a 256 entry table for short runs (a packet header is three words), and
+ * folds the low byte of 8 or 16 words at a time with shifts for longer arrays.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHECKSUM_X86 1
+#include <immintrin.h>
+#endif
+
+/* Below this many words the table lookups beat the vector setup. */
+#define PARITY_SIMD_MIN 16
+
+struct checksum_kernels_s
+{
+	uint16_t (*sum)(const uint16_t *words, int wordCount);
+	int (*parity_check)(const uint16_t *words, int wordCount);
+	void (*parity_generate)(uint16_t *words, int wordCount);
+};
+
+/* Bits 8 and 9 for every possible low byte. */
+static uint16_t parityBits[256];
+
+static uint16_t sum_c(const uint16_t *words, int wordCount)
+{
+	uint16_t s = 0;
+	for (int i = 0; i < wordCount; i++)
+		s += words[i];
+
+	return s;
+}
+
+static int parity_check_c(const uint16_t *words, int wordCount)
+{
+	for (int i = 0; i < wordCount; i++) {
+		if ((words[i] & 0x300) != parityBits[words[i] & 0xff])
+			return 0;
+	}
+
+	return 1;
+}
+
+static void parity_generate_c(uint16_t *words, int wordCount)
+{
+	for (int i = 0; i < wordCount; i++)
+		words[i] = (words[i] & 0xff) | parityBits[words[i] & 0xff];
+}
+
+#ifdef CHECKSUM_X86
+/* 0x100 where the low byte has odd parity, 0x200 where even. */
+__attribute__((target("sse2")))
+static inline __m128i parity_bits_sse2(__m128i w)
+{
+	__m128i x = _mm_and_si128(w, _mm_set1_epi16(0xff));
+	x = _mm_xor_si128(x, _mm_srli_epi16(x, 4));
+	x = _mm_xor_si128(x, _mm_srli_epi16(x, 2));
+	x = _mm_xor_si128(x, _mm_srli_epi16(x, 1));
+	x = _mm_slli_epi16(_mm_and_si128(x, _mm_set1_epi16(1)), 8);
+	return _mm_sub_epi16(_mm_set1_epi16(0x200), x);
+}
+
+__attribute__((target("sse2")))
+static uint16_t sum_sse2(const uint16_t *words, int wordCount)
+{
+	__m128i acc = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 8 <= wordCount; i += 8)
+		acc = _mm_add_epi16(acc, _mm_loadu_si128((const __m128i *)(words + i)));
+
+	acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 8));
+	acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 4));
+	acc = _mm_add_epi16(acc, _mm_srli_si128(acc, 2));
+
+	return (uint16_t)_mm_cvtsi128_si32(acc) + sum_c(words + i, wordCount - i);
+}
+
+__attribute__((target("sse2")))
+static int parity_check_sse2(const uint16_t *words, int wordCount)
+{
+	const __m128i mask = _mm_set1_epi16(0x300);
+	int i = 0;
+
+	if (wordCount < PARITY_SIMD_MIN)
+		return parity_check_c(words, wordCount);
+
+	for (; i + 8 <= wordCount; i += 8) {
+		__m128i w = _mm_loadu_si128((const __m128i *)(words + i));
+		__m128i ok = _mm_cmpeq_epi16(_mm_and_si128(w, mask), parity_bits_sse2(w));
+		if (_mm_movemask_epi8(ok) != 0xffff)
+			return 0;
+	}
+
+	return parity_check_c(words + i, wordCount - i);
+}
+
+__attribute__((target("sse2")))
+static void parity_generate_sse2(uint16_t *words, int wordCount)
+{
+	const __m128i mask = _mm_set1_epi16(0xff);
+	int i = 0;
+
+	if (wordCount < PARITY_SIMD_MIN) {
+		parity_generate_c(words, wordCount);
+		return;
+	}
+
+	for (; i + 8 <= wordCount; i += 8) {
+		__m128i w = _mm_loadu_si128((const __m128i *)(words + i));
+		w = _mm_or_si128(_mm_and_si128(w, mask), parity_bits_sse2(w));
+		_mm_storeu_si128((__m128i *)(words + i), w);
+	}
+
+	parity_generate_c(words + i, wordCount - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i parity_bits_avx2(__m256i w)
+{
+	__m256i x = _mm256_and_si256(w, _mm256_set1_epi16(0xff));
+	x = _mm256_xor_si256(x, _mm256_srli_epi16(x, 4));
+	x = _mm256_xor_si256(x, _mm256_srli_epi16(x, 2));
+	x = _mm256_xor_si256(x, _mm256_srli_epi16(x, 1));
+	x = _mm256_slli_epi16(_mm256_and_si256(x, _mm256_set1_epi16(1)), 8);
+	return _mm256_sub_epi16(_mm256_set1_epi16(0x200), x);
+}
+
+__attribute__((target("avx2")))
+static uint16_t sum_avx2(const uint16_t *words, int wordCount)
+{
+	__m256i acc = _mm256_setzero_si256();
+	int i = 0;
+
+	for (; i + 16 <= wordCount; i += 16)
+		acc = _mm256_add_epi16(acc, _mm256_loadu_si256((const __m256i *)(words + i)));
+
+	__m128i a = _mm_add_epi16(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	a = _mm_add_epi16(a, _mm_srli_si128(a, 8));
+	a = _mm_add_epi16(a, _mm_srli_si128(a, 4));
+	a = _mm_add_epi16(a, _mm_srli_si128(a, 2));
+
+	return (uint16_t)_mm_cvtsi128_si32(a) + sum_sse2(words + i, wordCount - i);
+}
+
+__attribute__((target("avx2")))
+static int parity_check_avx2(const uint16_t *words, int wordCount)
+{
+	const __m256i mask = _mm256_set1_epi16(0x300);
+	int i = 0;
+
+	if (wordCount < PARITY_SIMD_MIN)
+		return parity_check_c(words, wordCount);
+
+	for (; i + 16 <= wordCount; i += 16) {
+		__m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+		__m256i ok = _mm256_cmpeq_epi16(_mm256_and_si256(w, mask), parity_bits_avx2(w));
+		if ((unsigned int)_mm256_movemask_epi8(ok) != 0xffffffff)
+			return 0;
+	}
+
+	return parity_check_sse2(words + i, wordCount - i);
+}
+
+__attribute__((target("avx2")))
+static void parity_generate_avx2(uint16_t *words, int wordCount)
+{
+	const __m256i mask = _mm256_set1_epi16(0xff);
+	int i = 0;
+
+	if (wordCount < PARITY_SIMD_MIN) {
+		parity_generate_c(words, wordCount);
+		return;
+	}
+
+	for (; i + 16 <= wordCount; i += 16) {
+		__m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+		w = _mm256_or_si256(_mm256_and_si256(w, mask), parity_bits_avx2(w));
+		_mm256_storeu_si256((__m256i *)(words + i), w);
+	}
+
+	parity_generate_sse2(words + i, wordCount - i);
+}
+#endif
+
+static struct checksum_kernels_s kernels = { sum_c, parity_check_c, parity_generate_c };
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void kernels_select(void)
+{
+	for (int i = 0; i < 256; i++)
+		parityBits[i] = __builtin_parity(i) ? 0x100 : 0x200;
+
+#ifdef CHECKSUM_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		kernels.sum = sum_avx2;
+		kernels.parity_check = parity_check_avx2;
+		kernels.parity_generate = parity_generate_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		kernels.sum = sum_sse2;
+		kernels.parity_check = parity_check_sse2;
+		kernels.parity_generate = parity_generate_sse2;
+	}
+#endif
+}
+
 /* Wikipedia:
  * The last word in an ANC packet is the Checksum word. It is computed
  * by computing the sum (modulo 512) of bits 0-8 (not bit 9), of all the other
@@ -41,11 +252,12 @@
  */
 uint16_t vanc_checksum_calculate(uint16_t *words, int wordCount)
 {
-	uint16_t s = 0;
-	for (uint16_t i = 0; i < wordCount; i++) {
-		s += *(words + i);
-		s &= 0x01ff;
-	}
+	if (wordCount <= 0)
+		return 0x200;
+
+	pthread_once(&kernels_once, kernels_select);
+
+	uint16_t s = kernels.sum(words, wordCount) & 0x01ff;
 	s |= ((~s & 0x0100) << 1);
 
 	return s;
@@ -65,18 +277,42 @@ int vanc_checksum_is_valid(uint16_t *words, int wordCount)
 {
 #define LOCAL_DEBUG 0
 #if 0
-	printf("%s(%p, %d): ", __func__, words, wordCount);
-	for (int i = 0; i < wordCount; i++)
-		printf("%04x ", *(words + i));
-	printf("\n");
+	vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_PARSE, "%s(%p, %d)\n", __func__, words, wordCount);
 #endif
 	uint16_t sum = vanc_checksum_calculate(words, wordCount - 1);
 	if (sum != *(words + (wordCount - 1))) {
 #if LOCAL_DEBUG
-		fprintf(stderr, "Checksum calculated as %04x, but passed as %04x\n", sum, *(words + (wordCount - 1)));
+		vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_PARSE, "Checksum calculated as %04x, but passed as %04x\n", sum, *(words + (wordCount - 1)));
 #endif
 		return 0;
 	}
 
 	return 1;
 }
+
+int vanc_parity_is_valid(const uint16_t *words, int wordCount)
+{
+	if (!words || wordCount <= 0)
+		return 1;
+
+	pthread_once(&kernels_once, kernels_select);
+
+	return kernels.parity_check(words, wordCount);
+}
+
+void vanc_parity_generate(uint16_t *words, int wordCount)
+{
+	if (!words || wordCount <= 0)
+		return;
+
+	pthread_once(&kernels_once, kernels_select);
+
+	kernels.parity_generate(words, wordCount);
+}
+
+uint16_t vanc_parity_word(uint8_t value)
+{
+	pthread_once(&kernels_once, kernels_select);
+
+	return value | parityBits[value];
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <time.h>
+
+#ifdef CLOCK_MONOTONIC_COARSE
+#define VANC_CLOCK_ID CLOCK_MONOTONIC_COARSE
+#else
+#define VANC_CLOCK_ID CLOCK_MONOTONIC
+#endif
+
+/* Installed as a pair, the callback is read last so a racing reader never
+ * pairs a new callback with the old context.
+ */
+static vanc_clock_callback clockCallback;
+static void *clockCallbackContext;
+
+void vanc_clock_set_source(vanc_clock_callback cb, void *userContext)
+{
+	__atomic_store_n(&clockCallback, NULL, __ATOMIC_RELEASE);
+	__atomic_store_n(&clockCallbackContext, userContext, __ATOMIC_RELEASE);
+	__atomic_store_n(&clockCallback, cb, __ATOMIC_RELEASE);
+}
+
+uint64_t vanc_clock_now_ns(void)
+{
+	vanc_clock_callback cb = __atomic_load_n(&clockCallback, __ATOMIC_ACQUIRE);
+	if (cb)
+		return cb(__atomic_load_n(&clockCallbackContext, __ATOMIC_ACQUIRE));
+
+	struct timespec ts;
+	clock_gettime(VANC_CLOCK_ID, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
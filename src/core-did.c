@@ -53,22 +53,35 @@ static struct did_s {
 	{ 0x80, 0x07,  "S2010", "ANSI/SCTE 104 - Packet Type 1 (deprecated)"},
 };
 
-const char *klvanc_didLookupDescription(uint16_t did, uint16_t sdid)
+/* (did << 8) | sdid to dids[] index + 1, built once. */
+static uint8_t didIndex[65536];
+static pthread_once_t didIndexOnce = PTHREAD_ONCE_INIT;
+
+static void didIndexBuild(void)
+{
+	for (unsigned int i = 0; i < (sizeof(dids) / sizeof(struct did_s)); i++)
+		didIndex[(dids[i].did << 8) | dids[i].sdid] = i + 1;
+}
+
+static const struct did_s *lookup(uint16_t did, uint16_t sdid)
 {
-	for (unsigned int i = 0; i < (sizeof(dids) / sizeof(struct did_s)); i++) {
-		if ((did == dids[i].did) && (sdid == dids[i].sdid))
-			return dids[i].desc;
-	}
+	if ((did > 0xff) || (sdid > 0xff))
+		return NULL;
+
+	pthread_once(&didIndexOnce, didIndexBuild);
 
-	return "Undefined";
+	uint8_t idx = didIndex[(did << 8) | sdid];
+	return idx ? &dids[idx - 1] : NULL;
 }
 
-const char *klvanc_didLookupSpecification(uint16_t did, uint16_t sdid)
+const char *klvanc_didLookupDescription(uint16_t did, uint16_t sdid)
 {
-	for (unsigned int i = 0; i < (sizeof(dids) / sizeof(struct did_s)); i++) {
-		if ((did == dids[i].did) && (sdid == dids[i].sdid))
-			return dids[i].spec;
-	}
+	const struct did_s *d = lookup(did, sdid);
+	return d ? d->desc : "Undefined";
+}
 
-	return "Undefined";
+const char *klvanc_didLookupSpecification(uint16_t did, uint16_t sdid)
+{
+	const struct did_s *d = lookup(did, sdid);
+	return d ? d->spec : "Undefined";
 }
@@ -0,0 +1,504 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* CEA-608 caption decoder.
+ *
+ * Each of the four caption channels keeps two screens, displayed and non-displayed
+ * memory. Byte pairs are applied to them directly, and every write to displayed memory
+ * compares the cell first, so a channel only accumulates changed rows when the visible
+ * text really changes. Steady state (null padding, repeated control codes, pop-on text
+ * being loaded off screen) costs a handful of byte operations per pair.
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct cc608_channel_s
+{
+	enum eia_608_mode_e mode;
+	struct eia_608_screen_s screens[2];
+	int displayed;			/* screens[] index of displayed memory */
+
+	int row, col;			/* Cursor */
+	uint8_t attr;			/* Attributes for the next character */
+	int rollupRows;			/* 2 - 4 in roll-up mode */
+
+	uint16_t rowsChanged;		/* Displayed rows changed since the last event */
+};
+
+struct cc608_field_s
+{
+	int channel;			/* Data channel 0 or 1, selected by the last control code */
+	unsigned char lastControl[2];	/* For dropping the redundant second copy */
+	int inXds;
+};
+
+struct vanc_eia_608_decoder_s
+{
+	struct cc608_channel_s channels[EIA_608_CHANNELS];
+	struct cc608_field_s fields[2];
+	int cdpSeen;			/* Once CDPs carry 608 data, ignore EIA-608 packets */
+};
+
+/* Basic North American character set, only the codes that differ from ASCII. */
+static uint16_t basic_char(unsigned char c)
+{
+	switch (c) {
+	case 0x2a: return 0x00e1;	/* á */
+	case 0x5c: return 0x00e9;	/* é */
+	case 0x5e: return 0x00ed;	/* í */
+	case 0x5f: return 0x00f3;	/* ó */
+	case 0x60: return 0x00fa;	/* ú */
+	case 0x7b: return 0x00e7;	/* ç */
+	case 0x7c: return 0x00f7;	/* ÷ */
+	case 0x7d: return 0x00d1;	/* Ñ */
+	case 0x7e: return 0x00f1;	/* ñ */
+	case 0x7f: return 0x25a0;	/* ■ */
+	default:   return c;
+	}
+}
+
+/* 0x11/0x19 0x30 - 0x3f */
+static const uint16_t specialChars[16] = {
+	0x00ae, 0x00b0, 0x00bd, 0x00bf, 0x2122, 0x00a2, 0x00a3, 0x266a,
+	0x00e0, 0x0020, 0x00e8, 0x00e2, 0x00ea, 0x00ee, 0x00f4, 0x00fb,
+};
+
+/* 0x12/0x1a 0x20 - 0x3f, Spanish, misc and French */
+static const uint16_t extendedChars1[32] = {
+	0x00c1, 0x00c9, 0x00d3, 0x00da, 0x00dc, 0x00fc, 0x2018, 0x00a1,
+	0x002a, 0x0027, 0x2014, 0x00a9, 0x2120, 0x2022, 0x201c, 0x201d,
+	0x00c0, 0x00c2, 0x00c7, 0x00c8, 0x00ca, 0x00cb, 0x00eb, 0x00ce,
+	0x00cf, 0x00ef, 0x00d4, 0x00d9, 0x00f9, 0x00db, 0x00ab, 0x00bb,
+};
+
+/* 0x13/0x1b 0x20 - 0x3f, Portuguese, German and Danish */
+static const uint16_t extendedChars2[32] = {
+	0x00c3, 0x00e3, 0x00cd, 0x00cc, 0x00ec, 0x00d2, 0x00f2, 0x00d5,
+	0x00f5, 0x007b, 0x007d, 0x005c, 0x005e, 0x005f, 0x007c, 0x007e,
+	0x00c4, 0x00e4, 0x00d6, 0x00f6, 0x00df, 0x00a5, 0x00a4, 0x2502,
+	0x00c5, 0x00e5, 0x00d8, 0x00f8, 0x250c, 0x2510, 0x2514, 0x2518,
+};
+
+/* PAC row, indexed by the low three bits of the first byte. Add one when bit 5 of the second is set. */
+static const int pacRows[8] = { 10, 0, 2, 11, 13, 4, 6, 8 };
+
+static struct eia_608_screen_s *displayed(struct cc608_channel_s *ch)
+{
+	return &ch->screens[ch->displayed];
+}
+
+static struct eia_608_screen_s *target(struct cc608_channel_s *ch)
+{
+	/* Pop-on captions are built off screen, everything else is written in place. */
+	if (ch->mode == EIA_608_MODE_POPON)
+		return &ch->screens[!ch->displayed];
+	return displayed(ch);
+}
+
+static void cell_set(struct cc608_channel_s *ch, struct eia_608_screen_s *s, int row, int col, uint16_t c, uint8_t attr)
+{
+	if (s->ch[row][col] == c && s->attr[row][col] == attr)
+		return;
+
+	s->ch[row][col] = c;
+	s->attr[row][col] = attr;
+	if (s == displayed(ch))
+		ch->rowsChanged |= 1 << row;
+}
+
+static void row_clear(struct cc608_channel_s *ch, struct eia_608_screen_s *s, int row, int col)
+{
+	for (; col < EIA_608_COLUMNS; col++)
+		cell_set(ch, s, row, col, 0, 0);
+}
+
+static void screen_clear(struct cc608_channel_s *ch, struct eia_608_screen_s *s)
+{
+	for (int row = 0; row < EIA_608_ROWS; row++)
+		row_clear(ch, s, row, 0);
+}
+
+static void put_char(struct cc608_channel_s *ch, uint16_t c)
+{
+	if (ch->mode == EIA_608_MODE_NONE || ch->mode == EIA_608_MODE_TEXT)
+		return;
+
+	cell_set(ch, target(ch), ch->row, ch->col, c, ch->attr);
+	if (ch->col < EIA_608_COLUMNS - 1)
+		ch->col++;
+}
+
+static void backspace(struct cc608_channel_s *ch)
+{
+	if (ch->col > 0)
+		ch->col--;
+	cell_set(ch, target(ch), ch->row, ch->col, 0, 0);
+}
+
+static void roll_up(struct cc608_channel_s *ch)
+{
+	struct eia_608_screen_s *s = displayed(ch);
+	int top = ch->row - ch->rollupRows + 1;
+	if (top < 0)
+		top = 0;
+
+	for (int row = top; row < ch->row; row++) {
+		if (memcmp(s->ch[row], s->ch[row + 1], sizeof(s->ch[row])) == 0 &&
+			memcmp(s->attr[row], s->attr[row + 1], sizeof(s->attr[row])) == 0)
+			continue;
+		memcpy(s->ch[row], s->ch[row + 1], sizeof(s->ch[row]));
+		memcpy(s->attr[row], s->attr[row + 1], sizeof(s->attr[row]));
+		ch->rowsChanged |= 1 << row;
+	}
+	row_clear(ch, s, ch->row, 0);
+}
+
+/* Rows outside the roll-up window are erased when the window moves or shrinks. */
+static void rollup_clip(struct cc608_channel_s *ch)
+{
+	int top = ch->row - ch->rollupRows + 1;
+	for (int row = 0; row < EIA_608_ROWS; row++) {
+		if (row < top || row > ch->row)
+			row_clear(ch, displayed(ch), row, 0);
+	}
+}
+
+static void end_of_caption(struct cc608_channel_s *ch)
+{
+	struct eia_608_screen_s *was = displayed(ch);
+	struct eia_608_screen_s *now = &ch->screens[!ch->displayed];
+
+	for (int row = 0; row < EIA_608_ROWS; row++) {
+		if (memcmp(was->ch[row], now->ch[row], sizeof(was->ch[row])) ||
+			memcmp(was->attr[row], now->attr[row], sizeof(was->attr[row])))
+			ch->rowsChanged |= 1 << row;
+	}
+	ch->displayed = !ch->displayed;
+}
+
+static void misc_control(struct cc608_channel_s *ch, unsigned char c2)
+{
+	switch (c2) {
+	case 0x20: /* RCL - Resume caption loading */
+		ch->mode = EIA_608_MODE_POPON;
+		break;
+	case 0x21: /* BS - Backspace */
+		backspace(ch);
+		break;
+	case 0x24: /* DER - Delete to end of row */
+		row_clear(ch, target(ch), ch->row, ch->col);
+		break;
+	case 0x25: /* RU2 - Roll-up captions, 2 rows */
+	case 0x26: /* RU3 */
+	case 0x27: /* RU4 */
+		if (ch->mode != EIA_608_MODE_ROLLUP) {
+			screen_clear(ch, displayed(ch));
+			screen_clear(ch, &ch->screens[!ch->displayed]);
+			ch->row = EIA_608_ROWS - 1;
+			ch->col = 0;
+			ch->attr = 0;
+		}
+		ch->mode = EIA_608_MODE_ROLLUP;
+		ch->rollupRows = c2 - 0x23;
+		rollup_clip(ch);
+		break;
+	case 0x29: /* RDC - Resume direct captioning */
+		ch->mode = EIA_608_MODE_PAINTON;
+		break;
+	case 0x2a: /* TR - Text restart */
+	case 0x2b: /* RTD - Resume text display */
+		ch->mode = EIA_608_MODE_TEXT;
+		break;
+	case 0x2c: /* EDM - Erase displayed memory */
+		screen_clear(ch, displayed(ch));
+		break;
+	case 0x2d: /* CR - Carriage return */
+		if (ch->mode == EIA_608_MODE_ROLLUP)
+			roll_up(ch);
+		ch->col = 0;
+		ch->attr = 0;
+		break;
+	case 0x2e: /* ENM - Erase non-displayed memory */
+		screen_clear(ch, &ch->screens[!ch->displayed]);
+		break;
+	case 0x2f: /* EOC - End of caption */
+		end_of_caption(ch);
+		ch->mode = EIA_608_MODE_POPON;
+		break;
+	default: /* AOF, AON and FON are obsolete or cosmetic */
+		break;
+	}
+}
+
+static void pac(struct cc608_channel_s *ch, unsigned char c1, unsigned char c2)
+{
+	int row = pacRows[c1 & 0x07];
+	if ((c1 & 0x07) != 0 && (c2 & 0x20))
+		row++;
+
+	uint8_t attr = (c2 & 0x01) ? EIA_608_ATTR_UNDERLINE : 0;
+	int col = 0;
+	int code = (c2 >> 1) & 0x0f;
+	if (code < 7)
+		attr |= code;
+	else if (code == 7)
+		attr |= EIA_608_ATTR_ITALICS;
+	else
+		col = (code - 8) * 4;
+
+	if (ch->mode == EIA_608_MODE_ROLLUP && row != ch->row) {
+		/* The window moves with its base row, contents and all. */
+		struct eia_608_screen_s *s = displayed(ch);
+		struct eia_608_screen_s copy = *s;
+		for (int i = 0; i < ch->rollupRows; i++) {
+			int from = ch->row - i, to = row - i;
+			if (from < 0 || to < 0)
+				break;
+			for (int j = 0; j < EIA_608_COLUMNS; j++)
+				cell_set(ch, s, to, j, copy.ch[from][j], copy.attr[from][j]);
+		}
+		ch->row = row;
+		rollup_clip(ch);
+	}
+
+	ch->row = row;
+	ch->col = col;
+	ch->attr = attr;
+}
+
+static void mid_row(struct cc608_channel_s *ch, unsigned char c2)
+{
+	uint8_t attr = (c2 & 0x01) ? EIA_608_ATTR_UNDERLINE : 0;
+	int code = (c2 >> 1) & 0x07;
+	if (code == 7)
+		attr |= EIA_608_ATTR_ITALICS | (ch->attr & EIA_608_ATTR_COLOR_MASK);
+	else
+		attr |= code;
+
+	/* Mid-row codes occupy a cell, displayed as a space. */
+	put_char(ch, ' ');
+	ch->attr = attr;
+}
+
+static void emit(struct vanc_context_s *ctx, int channel)
+{
+	struct vanc_eia_608_decoder_s *d = getPrivate(ctx)->eia608;
+	struct cc608_channel_s *ch = &d->channels[channel];
+
+	if (!ch->rowsChanged)
+		return;
+
+	struct eia_608_event_s ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.type = EIA_608_EVENT_SCREEN;
+	ev.channel = channel + 1;
+	ev.mode = ch->mode;
+	ev.screen = displayed(ch);
+	ev.rowsChanged = ch->rowsChanged;
+	ch->rowsChanged = 0;
+
+	vanc_callback(ctx, eia_608_event, &ev);
+}
+
+static void emit_xds(struct vanc_context_s *ctx, unsigned char c1, unsigned char c2)
+{
+	struct eia_608_event_s ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.type = EIA_608_EVENT_XDS;
+	ev.xds[0] = c1;
+	ev.xds[1] = c2;
+
+	vanc_callback(ctx, eia_608_event, &ev);
+}
+
+static int odd_parity(unsigned char b)
+{
+	return __builtin_parity(b);
+}
+
+void vanc_eia_608_decode(struct vanc_context_s *ctx, int field, unsigned char b1, unsigned char b2, int fromCdp)
+{
+	struct vanc_eia_608_decoder_s *d = getPrivate(ctx)->eia608;
+	if (!d)
+		return;
+
+	if (fromCdp)
+		d->cdpSeen = 1;
+	else if (d->cdpSeen)
+		return;
+
+	if (field != 1 && field != 2)
+		return;
+
+	struct cc608_field_s *f = &d->fields[field - 1];
+	unsigned char c1 = b1 & 0x7f;
+	unsigned char c2 = b2 & 0x7f;
+
+	/* Padding */
+	if (c1 == 0 && c2 == 0)
+		return;
+
+	/* XDS, field 2 only. Runs until the end code, or a caption control code interrupts it. */
+	if (field == 2 && c1 >= 0x01 && c1 <= 0x0f) {
+		f->inXds = (c1 != 0x0f);
+		emit_xds(ctx, c1, c2);
+		return;
+	}
+	if (f->inXds && c1 >= 0x20) {
+		emit_xds(ctx, c1, c2);
+		return;
+	}
+
+	if (c1 >= 0x10 && c1 <= 0x1f) {
+		f->inXds = 0;
+
+		/* Control codes need good parity on both bytes, and are usually sent twice. */
+		if (!odd_parity(b1) || !odd_parity(b2))
+			return;
+		if (f->lastControl[0] == c1 && f->lastControl[1] == c2) {
+			f->lastControl[0] = 0;
+			return;
+		}
+		f->lastControl[0] = c1;
+		f->lastControl[1] = c2;
+
+		f->channel = (c1 & 0x08) ? 1 : 0;
+		int channel = ((field - 1) * 2) + f->channel;
+		struct cc608_channel_s *ch = &d->channels[channel];
+		unsigned char c = c1 & 0x17;
+
+		if (c2 >= 0x40)
+			pac(ch, c, c2);
+		else if ((c == 0x14 || c == 0x15) && c2 >= 0x20 && c2 <= 0x2f)
+			misc_control(ch, c2);
+		else if (c == 0x17 && c2 >= 0x21 && c2 <= 0x23) {
+			/* TO1 - TO3, tab offsets */
+			ch->col += c2 - 0x20;
+			if (ch->col >= EIA_608_COLUMNS)
+				ch->col = EIA_608_COLUMNS - 1;
+		} else if (c == 0x11 && c2 >= 0x20 && c2 <= 0x2f)
+			mid_row(ch, c2);
+		else if (c == 0x11 && c2 >= 0x30)
+			put_char(ch, specialChars[c2 - 0x30]);
+		else if ((c == 0x12 || c == 0x13) && c2 >= 0x20 && c2 <= 0x3f) {
+			/* Extended characters replace the standard fallback sent just before them. */
+			backspace(ch);
+			put_char(ch, c == 0x12 ? extendedChars1[c2 - 0x20] : extendedChars2[c2 - 0x20]);
+		}
+		/* Background and font attribute codes aren't tracked. */
+
+		emit(ctx, channel);
+		return;
+	}
+
+	/* Printable characters, for the channel the last control code selected. */
+	f->lastControl[0] = 0;
+	if (c1 < 0x20)
+		return;
+
+	int channel = ((field - 1) * 2) + f->channel;
+	struct cc608_channel_s *ch = &d->channels[channel];
+	put_char(ch, odd_parity(b1) ? basic_char(c1) : 0x25a0);
+	if (c2 >= 0x20)
+		put_char(ch, odd_parity(b2) ? basic_char(c2) : 0x25a0);
+
+	emit(ctx, channel);
+}
+
+int vanc_context_enable_eia_608_decoder(struct vanc_context_s *ctx, int enable)
+{
+	VALIDATE(ctx);
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	if (!enable) {
+		free(priv->eia608);
+		priv->eia608 = NULL;
+		return KLAPI_OK;
+	}
+
+	if (priv->eia608)
+		return KLAPI_OK;
+
+	priv->eia608 = calloc(1, sizeof(*priv->eia608));
+	if (!priv->eia608)
+		return -ENOMEM;
+
+	return KLAPI_OK;
+}
+
+const struct eia_608_screen_s *vanc_eia_608_get_screen(struct vanc_context_s *ctx, int channel)
+{
+	if (!ctx || channel < 1 || channel > EIA_608_CHANNELS)
+		return NULL;
+
+	struct vanc_eia_608_decoder_s *d = getPrivate(ctx)->eia608;
+	if (!d)
+		return NULL;
+
+	return displayed(&d->channels[channel - 1]);
+}
+
+int eia_608_screen_row_to_utf8(const struct eia_608_screen_s *screen, int row, char *buf, size_t len)
+{
+	if (!screen || !buf || len == 0 || row < 0 || row >= EIA_608_ROWS)
+		return -EINVAL;
+
+	int last = EIA_608_COLUMNS - 1;
+	while (last >= 0 && screen->ch[row][last] == 0)
+		last--;
+
+	size_t n = 0;
+	for (int col = 0; col <= last; col++) {
+		uint16_t c = screen->ch[row][col];
+		char tmp[3];
+		int l;
+
+		if (c == 0)
+			c = ' ';
+		if (c < 0x80) {
+			tmp[0] = c;
+			l = 1;
+		} else if (c < 0x800) {
+			tmp[0] = 0xc0 | (c >> 6);
+			tmp[1] = 0x80 | (c & 0x3f);
+			l = 2;
+		} else {
+			tmp[0] = 0xe0 | (c >> 12);
+			tmp[1] = 0x80 | ((c >> 6) & 0x3f);
+			tmp[2] = 0x80 | (c & 0x3f);
+			l = 3;
+		}
+		if (n + l >= len)
+			break;
+		memcpy(buf + n, tmp, l);
+		n += l;
+	}
+	buf[n] = 0;
+
+	return n;
+}
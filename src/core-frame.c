@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int vanc_frame_collect(struct vanc_context_s *ctx, const struct vanc_decoder_s *dec, void *decodedPacket)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	enum packet_type_e type = dec->type;
+
+	if (!priv->frame || !ctx->callbacks || !ctx->callbacks->frame_end)
+		return 0;
+	if (type <= VANC_TYPE_UNDEFINED || type >= VANC_TYPE_MAX)
+		return 0;
+
+	/* The arrays are kept between frames, so after the first few frames this never allocates. */
+	struct vanc_frame_collect_s *c = &priv->collect[type];
+	if (c->count == c->allocated) {
+		unsigned int allocated = c->allocated ? c->allocated * 2 : 16;
+		void **packets = realloc(c->packets, allocated * sizeof(void *));
+		if (!packets)
+			return 0;
+		c->packets = packets;
+
+		const struct vanc_decoder_s **decoders = realloc(c->decoders, allocated * sizeof(*decoders));
+		if (!decoders)
+			return 0;
+		c->decoders = decoders;
+		c->allocated = allocated;
+	}
+
+	c->decoders[c->count] = dec;
+	c->packets[c->count++] = decodedPacket;
+
+	return 1;
+}
+
+static void frame_release(struct vanc_context_s *ctx)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	for (int t = 0; t < VANC_TYPE_MAX; t++) {
+		struct vanc_frame_collect_s *c = &priv->collect[t];
+		for (unsigned int i = 0; i < c->count; i++)
+			vanc_packet_decoded_free(ctx, c->decoders[i], c->packets[i]);
+		c->count = 0;
+	}
+}
+
+void vanc_frame_free(struct vanc_context_s *ctx)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	frame_release(ctx);
+	for (int t = 0; t < VANC_TYPE_MAX; t++) {
+		free(priv->collect[t].packets);
+		free(priv->collect[t].decoders);
+		priv->collect[t].packets = NULL;
+		priv->collect[t].decoders = NULL;
+		priv->collect[t].allocated = 0;
+	}
+
+	free(priv->unpacked);
+	priv->unpacked = NULL;
+	priv->unpackedAllocated = 0;
+}
+
+int vanc_frame_line_words(const struct vanc_frame_line_s *line, unsigned short **buf, unsigned int *allocated,
+	unsigned short **words, unsigned int *wordCount)
+{
+	if (line->words) {
+		*words = line->words;
+		*wordCount = line->wordCount;
+		return KLAPI_OK;
+	}
+
+	*words = NULL;
+	*wordCount = 0;
+
+	/* Lines the caller had nothing for. */
+	if (!line->v210 || !line->v210Width)
+		return KLAPI_OK;
+
+	/* Most VANC lines are blanking, don't bother unpacking the ones without an ADF. */
+	unsigned int width = (line->v210Width / 6) * 6;
+	if (klvanc_v210_line_find_adf(line->v210, width) < 0)
+		return KLAPI_OK;
+
+	/* Luma followed by chroma, klvanc_v210_line_to_nv20() insists on width * 3 words of room. */
+	unsigned int needed = width * 3;
+	if (needed > *allocated) {
+		unsigned short *p = realloc(*buf, needed * sizeof(unsigned short));
+		if (!p)
+			return -ENOMEM;
+		*buf = p;
+		*allocated = needed;
+	}
+
+	/* Every luma and chroma word we parse gets written, no need to clear the buffer. */
+	if (klvanc_v210_line_to_nv20(line->v210, *buf, needed * sizeof(unsigned short), width) < 0)
+		return KLAPI_OK;
+
+	*words = *buf;
+	*wordCount = width * 2;
+
+	return KLAPI_OK;
+}
+
+static int frame_parse_lines(struct vanc_context_s *ctx, struct vanc_frame_s *frame)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	int packetCount = 0;
+
+	for (unsigned int i = 0; i < frame->lineCount; i++) {
+		unsigned short *words;
+		unsigned int wordCount;
+
+		/* Outside the line range, don't bother unpacking. */
+		if (!vanc_line_wanted(priv, frame->lines[i].lineNr))
+			continue;
+
+		uint64_t start = vanc_stats_clock(priv);
+		int ret = vanc_frame_line_words(&frame->lines[i], &priv->unpacked, &priv->unpackedAllocated,
+			&words, &wordCount);
+		vanc_stat_add(priv->stats.unpackNs, vanc_stats_since(priv, start));
+		if (ret < 0)
+			return ret;
+		if (!words || !wordCount)
+			continue;
+
+		int count = vanc_packet_parse(ctx, frame->lines[i].lineNr, words, wordCount);
+		if (count < 0)
+			return count;
+		packetCount += count;
+	}
+
+	return packetCount;
+}
+
+int vanc_frame_parse(struct vanc_context_s *ctx, struct vanc_frame_s *frame)
+{
+	VALIDATE(ctx);
+	VALIDATE(frame);
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	/* Not re-entrant, don't call vanc_frame_parse() from a callback. */
+	if (priv->frame)
+		return -EBUSY;
+
+	frame->frameNr = priv->frameCount++;
+	frame->packetCount = 0;
+	memset(&frame->timecode, 0, sizeof(frame->timecode));
+	memset(&frame->types[0], 0, sizeof(frame->types));
+
+	priv->frame = frame;
+	memset(&priv->timecode, 0, sizeof(priv->timecode));
+
+	vanc_callback(ctx, frame_begin, frame);
+
+	int ret;
+	if (priv->workers)
+		ret = vanc_workers_frame_parse(ctx, frame);
+	else
+		ret = frame_parse_lines(ctx, frame);
+	if (ret > 0)
+		frame->packetCount = ret;
+	frame->timecode = priv->timecode;
+
+	if (ctx->callbacks && ctx->callbacks->frame_end) {
+		for (int t = 0; t < VANC_TYPE_MAX; t++) {
+			frame->types[t].packets = priv->collect[t].packets;
+			frame->types[t].count = priv->collect[t].count;
+		}
+
+		/* Packets decoded ahead of the ATC packet went out without the timecode, every
+		 * built in packet struct starts with its header, so stamp them all now.
+		 */
+		for (int t = VANC_TYPE_UNDEFINED + 1; t < VANC_TYPE_USER; t++) {
+			for (unsigned int i = 0; i < priv->collect[t].count; i++)
+				((struct packet_header_s *)priv->collect[t].packets[i])->timecode = priv->timecode;
+		}
+
+		vanc_callback(ctx, frame_end, frame);
+
+		memset(&frame->types[0], 0, sizeof(frame->types));
+	}
+
+	frame_release(ctx);
+	priv->frame = NULL;
+
+	/* Nothing from this frame is referenced any more, hand the arena back in one go. */
+	if (priv->arena)
+		vanc_context_arena_reset(ctx);
+
+	if (ret < 0)
+		return ret;
+
+	return frame->packetCount;
+}
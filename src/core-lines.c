@@ -19,7 +19,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <libklvanc/vanc.h>
 #include <libklvanc/vanc-lines.h>
+#include <libklvanc/pixels.h>
+
+#include "core-private.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,10 +43,8 @@ struct vanc_line_s *vanc_line_create(int line_number)
 void vanc_line_free(struct vanc_line_s *line)
 {
 	for (int i = 0; i < MAX_VANC_ENTRIES; i++) {
-		if (line->p_entries[i] != NULL) {
-			free(line->p_entries[i]->payload);
-			free(line->p_entries[i]);
-		}
+		if (line->p_entries[i] != NULL)
+			vanc_buffer_free(line->p_entries[i]->buf);
 	}
 	free(line);
 }
@@ -52,17 +54,15 @@ int vanc_line_insert(struct vanc_line_set_s *vanc_lines, uint16_t * pixels,
 {
 	int i;
 	struct vanc_line_s *line = vanc_lines->lines[0];
-	struct vanc_entry_s *new_entry =
-	    (struct vanc_entry_s *)malloc(sizeof(struct vanc_entry_s));
-	if (new_entry == NULL)
-		return -ENOMEM;
 
-	new_entry->payload =
-	    (uint16_t *) malloc(pixel_width * sizeof(uint16_t));
-	if (new_entry->payload == NULL) {
-		free(new_entry);
+	/* The entry and its payload share a single recycled pool buffer. */
+	struct buffer_s *buf;
+	if (vanc_buffer_alloc(NULL, &buf, sizeof(struct vanc_entry_s) + pixel_width * sizeof(uint16_t)) < 0)
 		return -ENOMEM;
-	}
+
+	struct vanc_entry_s *new_entry = (struct vanc_entry_s *)buf->ptr;
+	new_entry->buf = buf;
+	new_entry->payload = (uint16_t *)(new_entry + 1);
 	memcpy(new_entry->payload, pixels, pixel_width * sizeof(uint16_t));
 	new_entry->h_offset = horizontal_offset;
 	new_entry->pixel_width = pixel_width;
@@ -83,18 +83,16 @@ int vanc_line_insert(struct vanc_line_set_s *vanc_lines, uint16_t * pixels,
 
 	if (i == MAX_VANC_LINES) {
 		/* Array is full */
-		fprintf(stderr, "array of lines is full!\n");
-		free(new_entry->payload);
-		free(new_entry);
+		vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_GENERATE, "array of lines is full!\n");
+		vanc_buffer_free(buf);
 		return -ENOMEM;
 	}
 
 	/* Now insert the VANC entry into the line */
 	if (line->num_entries == MAX_VANC_ENTRIES) {
 		/* Array is full */
-		fprintf(stderr, "line is full!\n");
-		free(new_entry->payload);
-		free(new_entry);
+		vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_GENERATE, "line is full!\n");
+		vanc_buffer_free(buf);
 		return -ENOMEM;
 	}
 
@@ -115,6 +113,29 @@ static int vanc_ent_comp(const void *a, const void *b)
 	return 1;
 }
 
+/* Check all words after the VANC start words for illegal values */
+static int payload_is_legal(int line_number, const uint16_t *payload, int pixel_width, int h_offset)
+{
+	for (int j = 3; j < pixel_width; j++) {
+		if (payload[j] <= 0x0003 || payload[j] >= 0x03FC) {
+			vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_GENERATE,
+				"VANC line %d has entry with illegal payload at offset %d. Skipping.  offset=%d len=%d\n",
+				line_number, j, h_offset, pixel_width);
+			if (vanc_log_enabled(VANC_LOG_DEBUG, VANC_LOG_CAT_GENERATE)) {
+				char words[VANC_LOG_MSG_MAX];
+				int n = 0;
+				words[0] = 0;
+				for (int k = 0; k < pixel_width && n < (int)sizeof(words); k++)
+					n += snprintf(words + n, sizeof(words) - n, "%04x ", payload[k]);
+				vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_GENERATE, "%s\n", words);
+			}
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 int generate_vanc_line(struct vanc_line_s *line, uint16_t ** outbuf,
 		       int *out_len, int line_pixel_width)
 {
@@ -139,29 +160,14 @@ int generate_vanc_line(struct vanc_line_s *line, uint16_t ** outbuf,
 			entry->h_offset = pixels_used;
 		}
 
-		/* Check all bytes after VANC start words for illegal values */
-		for (int j = 3; j < entry->pixel_width; j++) {
-			if (entry->payload[j] <= 0x0003
-			    || entry->payload[j] >= 0x03FC) {
-				fprintf(stderr,
-					"VANC line %d has entry with illegal payload at offset %d. Skipping.  offset=%d len=%d",
-					line->line_number, j, entry->h_offset,
-					entry->pixel_width);
-				for (int k = 0; k < entry->pixel_width; k++) {
-					fprintf(stderr, "%04x ",
-						entry->payload[k]);
-				}
-				fprintf(stderr, "\n");
-				entry->pixel_width = 0;
-				break;
-			}
-		}
+		if (!payload_is_legal(line->line_number, entry->payload, entry->pixel_width, entry->h_offset))
+			entry->pixel_width = 0;
 
 		/* Don't let sum of all VANC entries overflow end of line */
 		if ((entry->h_offset + entry->pixel_width) > line_pixel_width) {
 			/* Set the length to zero so this entry gets skipped */
-			fprintf(stderr,
-				"VANC line %d would overflow thus skipping.  offset=%d len=%d",
+			vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_GENERATE,
+				"VANC line %d would overflow thus skipping.  offset=%d len=%d\n",
 				line->line_number, entry->h_offset,
 				entry->pixel_width);
 			entry->pixel_width = 0;
@@ -186,3 +192,288 @@ int generate_vanc_line(struct vanc_line_s *line, uint16_t ** outbuf,
 	}
 	return 0;
 }
+
+/* Frame composer. Entries live in a preallocated array, chained per line in horizontal
+ * offset order, their payloads in one contiguous word arena. The lines in use are kept
+ * sorted so reset and iteration only touch those.
+ */
+struct composer_entry_s
+{
+	int h_offset;
+	int pixel_width;
+	int arena_offset;
+	int next;			/* Index of the next entry on the line, -1 at the end */
+};
+
+struct vanc_composer_s
+{
+	int max_line_number;
+	int *line_head;			/* Indexed by line number, -1 when the line is empty */
+
+	int *used_lines;		/* Ascending */
+	int num_used_lines;
+
+	struct composer_entry_s *entries;
+	int max_entries;
+	int num_entries;
+
+	uint16_t *arena;
+	int arena_words;
+	int arena_used;
+};
+
+int vanc_composer_alloc(struct vanc_composer_s **composer, int max_line_number, int max_packets, int arena_words)
+{
+	if (!composer || max_line_number < 1 || max_packets < 1 || arena_words < 1)
+		return -EINVAL;
+
+	struct vanc_composer_s *c = calloc(1, sizeof(*c));
+	if (!c)
+		return -ENOMEM;
+
+	c->max_line_number = max_line_number;
+	c->max_entries = max_packets;
+	c->arena_words = arena_words;
+	c->line_head = malloc((max_line_number + 1) * sizeof(int));
+	c->used_lines = malloc((max_line_number + 1) * sizeof(int));
+	c->entries = malloc(max_packets * sizeof(struct composer_entry_s));
+	c->arena = malloc(arena_words * sizeof(uint16_t));
+	if (!c->line_head || !c->used_lines || !c->entries || !c->arena) {
+		vanc_composer_free(c);
+		return -ENOMEM;
+	}
+
+	for (int i = 0; i <= max_line_number; i++)
+		c->line_head[i] = -1;
+
+	*composer = c;
+	return 0;
+}
+
+void vanc_composer_free(struct vanc_composer_s *c)
+{
+	if (!c)
+		return;
+
+	free(c->line_head);
+	free(c->used_lines);
+	free(c->entries);
+	free(c->arena);
+	free(c);
+}
+
+void vanc_composer_reset(struct vanc_composer_s *c)
+{
+	if (!c)
+		return;
+
+	for (int i = 0; i < c->num_used_lines; i++)
+		c->line_head[c->used_lines[i]] = -1;
+
+	c->num_used_lines = 0;
+	c->num_entries = 0;
+	c->arena_used = 0;
+}
+
+int vanc_composer_insert(struct vanc_composer_s *c, const uint16_t *pixels,
+	int pixel_width, int line_number, int horizontal_offset)
+{
+	if (!c || !pixels || pixel_width < 1 || line_number < 1 || line_number > c->max_line_number)
+		return -EINVAL;
+
+	if (c->num_entries == c->max_entries || c->arena_used + pixel_width > c->arena_words) {
+		vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_GENERATE, "composer is full, dropping packet for line %d\n", line_number);
+		return -ENOSPC;
+	}
+
+	int idx = c->num_entries++;
+	struct composer_entry_s *entry = &c->entries[idx];
+	entry->h_offset = horizontal_offset;
+	entry->pixel_width = pixel_width;
+	entry->arena_offset = c->arena_used;
+	memcpy(c->arena + c->arena_used, pixels, pixel_width * sizeof(uint16_t));
+	c->arena_used += pixel_width;
+
+	if (c->line_head[line_number] == -1) {
+		/* First packet on this line, keep the used lines in order. */
+		int i = c->num_used_lines++;
+		while (i > 0 && c->used_lines[i - 1] > line_number) {
+			c->used_lines[i] = c->used_lines[i - 1];
+			i--;
+		}
+		c->used_lines[i] = line_number;
+	}
+
+	/* Chain in offset order, after any entries with the same offset. */
+	int *link = &c->line_head[line_number];
+	while (*link != -1 && c->entries[*link].h_offset <= horizontal_offset)
+		link = &c->entries[*link].next;
+	entry->next = *link;
+	*link = idx;
+
+	return 0;
+}
+
+int vanc_composer_next_line(struct vanc_composer_s *c, int line_number)
+{
+	if (!c)
+		return -1;
+
+	/* used_lines is ascending, find the first line past line_number. */
+	int lo = 0, hi = c->num_used_lines;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (c->used_lines[mid] > line_number)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return lo < c->num_used_lines ? c->used_lines[lo] : -1;
+}
+
+int vanc_composer_generate_line(struct vanc_composer_s *c, int line_number,
+	uint16_t *out_buf, int *out_len, int line_pixel_width)
+{
+	if (!c || !out_buf || !out_len || line_number < 1 || line_number > c->max_line_number)
+		return -EINVAL;
+
+	int pixels_used = 0;
+
+	/* Entries are already in offset order, place them back to back
+	   (see SMPTE ST291-1-2011 Sec 7.3) */
+	for (int i = c->line_head[line_number]; i != -1; i = c->entries[i].next) {
+		const struct composer_entry_s *entry = &c->entries[i];
+		const uint16_t *payload = c->arena + entry->arena_offset;
+
+		if (!payload_is_legal(line_number, payload, entry->pixel_width, pixels_used))
+			continue;
+
+		/* Don't let sum of all VANC entries overflow end of line */
+		if ((pixels_used + entry->pixel_width) > line_pixel_width) {
+			vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_GENERATE,
+				"VANC line %d would overflow thus skipping.  offset=%d len=%d\n",
+				line_number, pixels_used, entry->pixel_width);
+			continue;
+		}
+
+		memcpy(out_buf + pixels_used, payload, entry->pixel_width * sizeof(uint16_t));
+		pixels_used += entry->pixel_width;
+	}
+
+	*out_len = pixels_used;
+	return 0;
+}
+
+/* Streams samples into a v210 row a group at a time. */
+struct v210_writer_s
+{
+	uint32_t *dst;
+	uint16_t samples[12];
+	int count;
+};
+
+#define V210_BLANK_Y 0x040
+#define V210_BLANK_C 0x200
+
+static inline void v210_put(struct v210_writer_s *w, uint16_t sample)
+{
+	w->samples[w->count++] = sample;
+	if (w->count == 12) {
+		vanc_v210_pack_group(w->samples, w->dst);
+		w->dst += 4;
+		w->count = 0;
+	}
+}
+
+static void write_line_v210(struct vanc_composer_s *c, const struct vanc_display_mode_s *mode,
+	int line_number, uint32_t *dst)
+{
+	struct v210_writer_s w = { dst, { 0 }, 0 };
+	int capacity = mode->placement == VANC_PLACEMENT_INTERLEAVED ? mode->width * 2 : mode->width;
+	int pixels_used = 0;
+
+	/* Same placement as vanc_composer_generate_line(), back to back in offset order. */
+	for (int i = c->line_head[line_number]; i != -1; i = c->entries[i].next) {
+		const struct composer_entry_s *entry = &c->entries[i];
+		const uint16_t *payload = c->arena + entry->arena_offset;
+
+		if (!payload_is_legal(line_number, payload, entry->pixel_width, pixels_used))
+			continue;
+
+		if ((pixels_used + entry->pixel_width) > capacity) {
+			vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_GENERATE,
+				"VANC line %d would overflow thus skipping.  offset=%d len=%d\n",
+				line_number, pixels_used, entry->pixel_width);
+			continue;
+		}
+
+		for (int j = 0; j < entry->pixel_width; j++) {
+			switch (mode->placement) {
+			case VANC_PLACEMENT_LUMA:
+				v210_put(&w, V210_BLANK_C);
+				v210_put(&w, payload[j]);
+				break;
+			case VANC_PLACEMENT_CHROMA:
+				v210_put(&w, payload[j]);
+				v210_put(&w, V210_BLANK_Y);
+				break;
+			default:
+				v210_put(&w, payload[j]);
+			}
+		}
+		pixels_used += entry->pixel_width;
+	}
+
+	/* Blank the remainder of the row, a group at a time once we're aligned. */
+	int samples = mode->placement == VANC_PLACEMENT_INTERLEAVED ? pixels_used : pixels_used * 2;
+	int total = KLVANC_V210_LINE_BYTES(mode->width) / 16 * 12;
+	while (w.count && samples < total) {
+		v210_put(&w, (samples & 1) ? V210_BLANK_Y : V210_BLANK_C);
+		samples++;
+	}
+
+	static const uint16_t blank[12] = {
+		V210_BLANK_C, V210_BLANK_Y, V210_BLANK_C, V210_BLANK_Y, V210_BLANK_C, V210_BLANK_Y,
+		V210_BLANK_C, V210_BLANK_Y, V210_BLANK_C, V210_BLANK_Y, V210_BLANK_C, V210_BLANK_Y,
+	};
+	uint32_t blank_group[4];
+	vanc_v210_pack_group(blank, blank_group);
+	for (; samples < total; samples += 12, w.dst += 4)
+		memcpy(w.dst, blank_group, sizeof(blank_group));
+}
+
+int vanc_composer_write_v210(struct vanc_composer_s *c, const struct vanc_display_mode_s *mode,
+	vanc_v210_line_func get_line, void *userContext)
+{
+	if (!c || !mode || !get_line || mode->width <= 0)
+		return -EINVAL;
+	if (mode->num_ranges < 0 || mode->num_ranges > VANC_DISPLAY_MODE_MAX_RANGES)
+		return -EINVAL;
+
+	int lines = 0;
+	for (int r = 0; r < mode->num_ranges; r++) {
+		int first = mode->ranges[r].first;
+		int last = mode->ranges[r].last;
+		if (first < 1 || last > c->max_line_number || first > last)
+			return -EINVAL;
+
+		for (int line_number = first; line_number <= last; line_number++) {
+			uint32_t *dst = NULL;
+			int dstSizeBytes = 0;
+
+			int ret = get_line(userContext, line_number, &dst, &dstSizeBytes);
+			if (ret < 0)
+				return ret;
+			if (!dst)
+				continue;
+			if (dstSizeBytes < KLVANC_V210_LINE_BYTES(mode->width))
+				return -EINVAL;
+
+			write_line_v210(c, mode, line_number, dst);
+			lines++;
+		}
+	}
+
+	return lines;
+}
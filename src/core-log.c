@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Diagnostics.
+ *
+ * In async mode messages are formatted straight into a slot of a bounded multi producer,
+ * single consumer ring. Each slot carries a sequence number, producers claim a position
+ * with a CAS on the head and publish by advancing the slot sequence, so logging from any
+ * number of threads (including the parse workers) never takes a lock or touches I/O.
+ * Producers post a semaphore, the drain thread sleeps on it and hands messages to the sink.
+ * Producers count themselves in logRingUsers while they hold the ring pointer, so turning
+ * async mode off can wait for any still writing a slot before the ring is freed.
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <inttypes.h>
+
+#define LOG_RING_DEFAULT 1024
+
+struct log_slot_s
+{
+	uint64_t seq;
+	enum vanc_log_level_e level;
+	enum vanc_log_category_e category;
+	char msg[VANC_LOG_MSG_MAX];
+};
+
+struct log_ring_s
+{
+	struct log_slot_s *slots;
+	uint64_t mask;
+	uint64_t head;			/* Next position to claim, producers */
+	uint64_t tail;			/* Next position to drain, drain thread only */
+	uint64_t dropped;
+
+	sem_t sem;
+	pthread_t thread;
+	int running;
+};
+
+struct log_rate_s
+{
+	int enabled;
+	int lock;			/* Spinlock guarding blk */
+	struct klrestricted_code_path_block_s blk;
+	unsigned int suppressed;
+};
+
+static int logLevel = VANC_LOG_INFO;
+static vanc_log_callback logCallback;
+static void *logCallbackContext;
+static struct log_rate_s logRates[VANC_LOG_CAT_MAX];
+static struct log_ring_s *logRing;
+static unsigned int logRingUsers;
+
+static void sink(enum vanc_log_level_e level, enum vanc_log_category_e category, const char *msg)
+{
+	if (logCallback) {
+		logCallback(logCallbackContext, level, category, msg);
+		return;
+	}
+
+	fputs(msg, level <= VANC_LOG_WARN ? stderr : stdout);
+}
+
+/* Claim a ring slot, or NULL if the ring is full. */
+static struct log_slot_s *ring_claim(struct log_ring_s *r)
+{
+	uint64_t pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+
+	while (1) {
+		struct log_slot_s *slot = &r->slots[pos & r->mask];
+		uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		int64_t diff = (int64_t)(seq - pos);
+
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&r->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				return slot;
+		} else if (diff < 0) {
+			__atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+			return NULL;
+		} else
+			pos = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	}
+}
+
+static void ring_publish(struct log_ring_s *r, struct log_slot_s *slot)
+{
+	/* The slot was claimed at seq, readable once seq + 1 is visible. */
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+	sem_post(&r->sem);
+}
+
+static void ring_drain(struct log_ring_s *r)
+{
+	while (1) {
+		struct log_slot_s *slot = &r->slots[r->tail & r->mask];
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != r->tail + 1)
+			break;
+
+		sink(slot->level, slot->category, slot->msg);
+
+		__atomic_store_n(&slot->seq, r->tail + r->mask + 1, __ATOMIC_RELEASE);
+		r->tail++;
+	}
+
+	uint64_t dropped = __atomic_exchange_n(&r->dropped, 0, __ATOMIC_RELAXED);
+	if (dropped) {
+		char msg[96];
+		snprintf(msg, sizeof(msg), "libklvanc: %" PRIu64 " log messages dropped, ring full\n", dropped);
+		sink(VANC_LOG_WARN, VANC_LOG_CAT_CORE, msg);
+	}
+}
+
+static void *ring_thread(void *p)
+{
+	struct log_ring_s *r = p;
+
+	while (__atomic_load_n(&r->running, __ATOMIC_ACQUIRE)) {
+		sem_wait(&r->sem);
+		ring_drain(r);
+	}
+	ring_drain(r);
+
+	return NULL;
+}
+
+static void emitv(enum vanc_log_level_e level, enum vanc_log_category_e category, const char *fmt, va_list ap)
+{
+	/* Count ourselves in before looking at the ring, pairs with vanc_log_disable_async(). */
+	__atomic_add_fetch(&logRingUsers, 1, __ATOMIC_SEQ_CST);
+	struct log_ring_s *r = __atomic_load_n(&logRing, __ATOMIC_SEQ_CST);
+
+	if (r) {
+		struct log_slot_s *slot = ring_claim(r);
+		if (slot) {
+			slot->level = level;
+			slot->category = category;
+			vsnprintf(slot->msg, sizeof(slot->msg), fmt, ap);
+			ring_publish(r, slot);
+		}
+		__atomic_sub_fetch(&logRingUsers, 1, __ATOMIC_RELEASE);
+		return;
+	}
+	__atomic_sub_fetch(&logRingUsers, 1, __ATOMIC_RELEASE);
+
+	char msg[VANC_LOG_MSG_MAX];
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	sink(level, category, msg);
+}
+
+static void emit(enum vanc_log_level_e level, enum vanc_log_category_e category, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	emitv(level, category, fmt, ap);
+	va_end(ap);
+}
+
+/* A token bucket per category. The first message let through after a run of
+ * suppressed ones reports how many were dropped.
+ */
+static int rate_allow(enum vanc_log_category_e category)
+{
+	struct log_rate_s *rl = &logRates[category];
+
+	if (!__atomic_load_n(&rl->enabled, __ATOMIC_RELAXED))
+		return 1;
+
+	while (__atomic_test_and_set(&rl->lock, __ATOMIC_ACQUIRE))
+		;
+	int allow = klrestricted_code_path_block_execute(&rl->blk);
+	unsigned int suppressed = 0;
+	if (allow) {
+		suppressed = rl->suppressed;
+		rl->suppressed = 0;
+	} else
+		rl->suppressed++;
+	__atomic_clear(&rl->lock, __ATOMIC_RELEASE);
+
+	if (suppressed)
+		emit(VANC_LOG_WARN, category, "libklvanc: %u messages suppressed by rate limit\n", suppressed);
+
+	return allow;
+}
+
+int vanc_log_enabled(enum vanc_log_level_e level, enum vanc_log_category_e category)
+{
+	if ((int)level > logLevel)
+		return 0;
+	if ((unsigned int)category >= VANC_LOG_CAT_MAX)
+		return 0;
+
+	return 1;
+}
+
+void vanc_log(enum vanc_log_level_e level, enum vanc_log_category_e category, const char *fmt, ...)
+{
+	if (!vanc_log_enabled(level, category))
+		return;
+	if (!rate_allow(category))
+		return;
+
+	va_list ap;
+	va_start(ap, fmt);
+	emitv(level, category, fmt, ap);
+	va_end(ap);
+}
+
+void vanc_log_set_callback(vanc_log_callback cb, void *userContext)
+{
+	logCallbackContext = userContext;
+	logCallback = cb;
+}
+
+void vanc_log_set_level(enum vanc_log_level_e level)
+{
+	logLevel = level;
+}
+
+int vanc_log_set_rate_limit(enum vanc_log_category_e category, unsigned int maxPerSecond)
+{
+	if ((unsigned int)category >= VANC_LOG_CAT_MAX)
+		return -EINVAL;
+
+	struct log_rate_s *rl = &logRates[category];
+
+	__atomic_store_n(&rl->enabled, 0, __ATOMIC_RELAXED);
+	while (__atomic_test_and_set(&rl->lock, __ATOMIC_ACQUIRE))
+		;
+	klrestricted_code_path_block_initialize_rate(&rl->blk, category, 1, maxPerSecond, maxPerSecond);
+	rl->suppressed = 0;
+	__atomic_clear(&rl->lock, __ATOMIC_RELEASE);
+	__atomic_store_n(&rl->enabled, maxPerSecond ? 1 : 0, __ATOMIC_RELAXED);
+
+	return KLAPI_OK;
+}
+
+int vanc_log_enable_async(unsigned int ringEntries)
+{
+	if (logRing)
+		return KLAPI_OK;
+
+	if (ringEntries == 0)
+		ringEntries = LOG_RING_DEFAULT;
+
+	unsigned int entries = 2;
+	while (entries < ringEntries)
+		entries <<= 1;
+
+	struct log_ring_s *r = calloc(1, sizeof(*r));
+	if (!r)
+		return -ENOMEM;
+
+	r->slots = calloc(entries, sizeof(struct log_slot_s));
+	if (!r->slots) {
+		free(r);
+		return -ENOMEM;
+	}
+
+	r->mask = entries - 1;
+	for (unsigned int i = 0; i < entries; i++)
+		r->slots[i].seq = i;
+
+	sem_init(&r->sem, 0, 0);
+	r->running = 1;
+	if (pthread_create(&r->thread, NULL, ring_thread, r) != 0) {
+		sem_destroy(&r->sem);
+		free(r->slots);
+		free(r);
+		return -ENOMEM;
+	}
+
+	__atomic_store_n(&logRing, r, __ATOMIC_RELEASE);
+
+	return KLAPI_OK;
+}
+
+void vanc_log_disable_async(void)
+{
+	struct log_ring_s *r = logRing;
+	if (!r)
+		return;
+
+	/* New messages go straight to the sink from here on. Producers that picked up the
+	 * ring before it was withdrawn are counted in logRingUsers, let them finish.
+	 */
+	__atomic_store_n(&logRing, NULL, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&logRingUsers, __ATOMIC_ACQUIRE))
+		sched_yield();
+
+	__atomic_store_n(&r->running, 0, __ATOMIC_RELEASE);
+	sem_post(&r->sem);
+	pthread_join(r->thread, NULL);
+
+	sem_destroy(&r->sem);
+	free(r->slots);
+	free(r);
+}
@@ -32,9 +32,9 @@ int dump_EIA_608(struct vanc_context_s *ctx, void *p)
 	struct packet_eia_608_s *pkt = p;
 
 	if (ctx->verbose)
-		printf("%s() %p\n", __func__, (void *)pkt);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s() %p\n", __func__, (void *)pkt);
 
-	printf("%s() EIA608: %02x %02x %02x : marker-bits %02x cc_valid %d cc_type %d cc_data_1 %02x cc_data_2 %02x\n",
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s() EIA608: %02x %02x %02x : marker-bits %02x cc_valid %d cc_type %d cc_data_1 %02x cc_data_2 %02x\n",
 		__func__,
 		pkt->payload[0],
 		pkt->payload[1],
@@ -48,17 +48,27 @@ int dump_EIA_608(struct vanc_context_s *ctx, void *p)
 	return KLAPI_OK;
 }
 
+int vanc_encode_eia_608(const struct packet_eia_608_s *pkt, uint16_t *words, unsigned int wordCount)
+{
+	VALIDATE(pkt);
+
+	uint8_t b[3];
+	b[0] = (pkt->field == 1 ? 0x80 : 0x00) | (pkt->line_offset & 0x1f);
+	b[1] = pkt->cc_data_1;
+	b[2] = pkt->cc_data_2;
+
+	return vanc_encode_packet(0x61, 0x02, b, sizeof(b), words, wordCount);
+}
+
 int parse_EIA_608(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp)
 {
 	if (ctx->verbose)
-		printf("%s()\n", __func__);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s()\n", __func__);
 
-	struct packet_eia_608_s *pkt = calloc(1, sizeof(*pkt));
+	struct packet_eia_608_s *pkt = vanc_packet_decoded_alloc(ctx, sizeof(*pkt), hdr);
 	if (!pkt)
 		return -ENOMEM;
 
-	memcpy(&pkt->hdr, hdr, sizeof(*hdr));
-
         /* Parsed */
 	pkt->payload[0] = hdr->payload[0];
 	pkt->payload[1] = hdr->payload[1];
@@ -70,8 +80,12 @@ int parse_EIA_608(struct vanc_context_s *ctx, struct packet_header_s *hdr, void
 	pkt->cc_data_1 = pkt->payload[1];
 	pkt->cc_data_2 = pkt->payload[2];
 
-	if (ctx->callbacks && ctx->callbacks->eia_608)
-		ctx->callbacks->eia_608(ctx->callback_context, ctx, pkt);
+	pkt->field = (pkt->payload[0] & 0x80) ? 1 : 2;
+	pkt->line_offset = pkt->payload[0] & 0x1f;
+
+	vanc_eia_608_decode(ctx, pkt->field, pkt->cc_data_1, pkt->cc_data_2, 0);
+
+	vanc_callback(ctx, eia_608, pkt);
 
 	*pp = pkt;
 	return KLAPI_OK;
@@ -27,31 +27,327 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define CDP_TIME_CODE_SECTION_ID	0x71
+#define CDP_CCDATA_SECTION_ID		0x72
+#define CDP_CCSVCINFO_SECTION_ID	0x73
+#define CDP_FOOTER_ID			0x74
+#define CDP_FUTURE_SECTION_ID_FIRST	0x75
+#define CDP_FUTURE_SECTION_ID_LAST	0xef
+
+const char *eia_708b_frame_rate_to_string(unsigned char cdp_frame_rate)
+{
+	switch(cdp_frame_rate) {
+	case 0x01:
+		return "23.976";
+	case 0x02:
+		return "24";
+	case 0x03:
+		return "25";
+	case 0x04:
+		return "29.97";
+	case 0x05:
+		return "30";
+	case 0x06:
+		return "50";
+	case 0x07:
+		return "59.94";
+	case 0x08:
+		return "60";
+	default:
+		return "Reserved";
+	}
+}
+
 int dump_EIA_708B(struct vanc_context_s *ctx, void *p)
 {
 	struct packet_eia_708b_s *pkt = p;
 
 	if (ctx->verbose)
-		printf("%s() %p\n", __func__, (void *)pkt);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s() %p\n", __func__, (void *)pkt);
+
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s() CDP length: %d frame rate: %s seq: 0x%04x/0x%04x checksum: %s%s\n", __func__,
+		pkt->cdp_length,
+		eia_708b_frame_rate_to_string(pkt->cdp_frame_rate),
+		pkt->cdp_hdr_sequence_cntr,
+		pkt->cdp_footer_sequence_cntr,
+		pkt->checksum_valid ? "OK" : "BAD",
+		pkt->sequence_discontinuity ? " (discontinuity)" : "");
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->flags time_code %d ccdata %d svcinfo %d start %d change %d complete %d active %d\n",
+		pkt->time_code_present,
+		pkt->ccdata_present,
+		pkt->svcinfo_present,
+		pkt->svc_info_start,
+		pkt->svc_info_change,
+		pkt->svc_info_complete,
+		pkt->caption_service_active);
+
+	if (pkt->time_code_present)
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->time_code %02d:%02d:%02d%c%02d field %d\n",
+			pkt->tc_hours, pkt->tc_minutes, pkt->tc_seconds,
+			pkt->tc_drop_frame ? ';' : ':', pkt->tc_frames, pkt->tc_field_flag);
+
+	for (int i = 0; i < pkt->cc_count; i++) {
+		const struct eia_708b_cc_data_s *cc = &pkt->cc_data[i];
+		if (!cc->cc_valid)
+			continue;
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->cc_data[%02d] type %d data 0x%02x 0x%02x\n",
+			i, cc->cc_type, cc->cc_data[0], cc->cc_data[1]);
+	}
+
+	for (int i = 0; i < pkt->svc_count; i++)
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->svc[%d] service %d language '%s'\n",
+			i, pkt->svc[i].caption_service_number, pkt->svc[i].language);
 
 	return KLAPI_OK;
 }
 
+static int parse_time_code_section(struct packet_eia_708b_s *pkt, const unsigned char *b)
+{
+	pkt->tc_hours = (((b[0] >> 4) & 0x03) * 10) + (b[0] & 0x0f);
+	pkt->tc_minutes = (((b[1] >> 4) & 0x07) * 10) + (b[1] & 0x0f);
+	pkt->tc_field_flag = b[2] >> 7;
+	pkt->tc_seconds = (((b[2] >> 4) & 0x07) * 10) + (b[2] & 0x0f);
+	pkt->tc_drop_frame = b[3] >> 7;
+	pkt->tc_frames = (((b[3] >> 4) & 0x03) * 10) + (b[3] & 0x0f);
+
+	return 4;
+}
+
+static void parse_svc(struct eia_708b_svc_s *svc, const unsigned char *b)
+{
+	if (b[0] & 0x40)
+		svc->caption_service_number = b[0] & 0x3f;	/* csn_size */
+	else
+		svc->caption_service_number = b[0] & 0x1f;
+
+	memcpy(svc->svc_data_byte, b + 1, sizeof(svc->svc_data_byte));
+	memcpy(svc->language, svc->svc_data_byte, 3);
+	svc->language[3] = 0;
+}
+
+int vanc_encode_eia_708b(const struct packet_eia_708b_s *pkt, uint16_t *words, unsigned int wordCount)
+{
+	VALIDATE(pkt);
+
+	if (pkt->cc_count > EIA_708B_CC_DATA_MAX || pkt->svc_count > EIA_708B_SVC_INFO_MAX)
+		return -EINVAL;
+
+	uint8_t b[256];
+	struct vanc_byte_writer_s w = { b, sizeof(b), 0, 0 };
+
+	/* cdp_header(), cdp_length is patched in once we know it. */
+	vanc_put16(&w, EIA_708B_CDP_IDENTIFIER);
+	vanc_put8(&w, 0);
+	vanc_put8(&w, (pkt->cdp_frame_rate << 4) | 0x0f);
+	vanc_put8(&w, (pkt->time_code_present ? 0x80 : 0) |
+		(pkt->ccdata_present ? 0x40 : 0) |
+		(pkt->svcinfo_present ? 0x20 : 0) |
+		(pkt->svc_info_start ? 0x10 : 0) |
+		(pkt->svc_info_change ? 0x08 : 0) |
+		(pkt->svc_info_complete ? 0x04 : 0) |
+		(pkt->caption_service_active ? 0x02 : 0) |
+		0x01);
+	vanc_put16(&w, pkt->cdp_hdr_sequence_cntr);
+
+	if (pkt->time_code_present) {
+		vanc_put8(&w, CDP_TIME_CODE_SECTION_ID);
+		vanc_put8(&w, 0xc0 | ((pkt->tc_hours / 10) << 4) | (pkt->tc_hours % 10));
+		vanc_put8(&w, 0x80 | ((pkt->tc_minutes / 10) << 4) | (pkt->tc_minutes % 10));
+		vanc_put8(&w, (pkt->tc_field_flag << 7) | ((pkt->tc_seconds / 10) << 4) | (pkt->tc_seconds % 10));
+		vanc_put8(&w, (pkt->tc_drop_frame << 7) | ((pkt->tc_frames / 10) << 4) | (pkt->tc_frames % 10));
+	}
+
+	if (pkt->ccdata_present) {
+		vanc_put8(&w, CDP_CCDATA_SECTION_ID);
+		vanc_put8(&w, 0xe0 | pkt->cc_count);
+		for (int i = 0; i < pkt->cc_count; i++) {
+			const struct eia_708b_cc_data_s *cc = &pkt->cc_data[i];
+			vanc_put8(&w, 0xf8 | (cc->cc_valid ? 0x04 : 0) | (cc->cc_type & 0x03));
+			vanc_put8(&w, cc->cc_data[0]);
+			vanc_put8(&w, cc->cc_data[1]);
+		}
+	}
+
+	if (pkt->svcinfo_present) {
+		vanc_put8(&w, CDP_CCSVCINFO_SECTION_ID);
+		vanc_put8(&w, 0x80 |
+			(pkt->svc_info_start ? 0x40 : 0) |
+			(pkt->svc_info_change ? 0x20 : 0) |
+			(pkt->svc_info_complete ? 0x10 : 0) |
+			pkt->svc_count);
+		for (int i = 0; i < pkt->svc_count; i++) {
+			const struct eia_708b_svc_s *svc = &pkt->svc[i];
+			if (svc->caption_service_number > 0x1f)
+				vanc_put8(&w, 0xc0 | (svc->caption_service_number & 0x3f));	/* csn_size */
+			else
+				vanc_put8(&w, 0xa0 | svc->caption_service_number);
+			vanc_put_bytes(&w, svc->svc_data_byte, sizeof(svc->svc_data_byte));
+		}
+	}
+
+	vanc_put8(&w, CDP_FOOTER_ID);
+	vanc_put16(&w, pkt->cdp_hdr_sequence_cntr);
+	vanc_put8(&w, 0);
+	if (w.overflow)
+		return -EINVAL;
+
+	/* Fill in the length, then the checksum so all cdp_length bytes sum to zero. */
+	b[2] = w.pos;
+	unsigned char sum = 0;
+	for (unsigned int i = 0; i < w.pos - 1; i++)
+		sum += b[i];
+	b[w.pos - 1] = -sum;
+
+	return vanc_encode_packet(0x61, 0x01, b, w.pos, words, wordCount);
+}
+
+/* Sequence continuity is tracked per stream, one per DID/SDID and line, so captions on two
+ * lines or fields each count alone. Inserters don't always hold a stream to one line, so a
+ * CDP that continues any stream with its DID/SDID belongs to that stream, wherever it is.
+ * Returns 1 if the CDP doesn't follow on from the stream it belongs to.
+ */
+static int cdp_sequence_discontinuity(struct vanc_context_private_s *priv, const struct packet_header_s *hdr,
+	unsigned short sequence)
+{
+	uint32_t key = ((hdr->did & 0xff) << 24) | ((hdr->dbnsdid & 0xff) << 16) | (hdr->lineNr & 0xffff);
+	struct vanc_cdp_stream_s *stream = NULL;
+	int discontinuity = 0;
+
+	for (unsigned int i = 0; i < priv->cdpStreamCount; i++) {
+		struct vanc_cdp_stream_s *s = &priv->cdpStreams[i];
+		if ((s->key >> 16) == (key >> 16) && (unsigned short)(s->sequence + 1) == sequence) {
+			stream = s;
+			break;
+		}
+		if (s->key == key)
+			stream = s;
+	}
+
+	if (stream)
+		discontinuity = (unsigned short)(stream->sequence + 1) != sequence;
+	else if (priv->cdpStreamCount < CDP_STREAMS_MAX)
+		stream = &priv->cdpStreams[priv->cdpStreamCount++];
+	else {
+		stream = &priv->cdpStreams[priv->cdpStreamNext];
+		priv->cdpStreamNext = (priv->cdpStreamNext + 1) % CDP_STREAMS_MAX;
+	}
+
+	stream->key = key;
+	stream->sequence = sequence;
+
+	return discontinuity;
+}
+
 int parse_EIA_708B(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp)
 {
 	if (ctx->verbose)
-		printf("%s()\n", __func__);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s()\n", __func__);
 
-	struct packet_eia_708b_s *pkt = calloc(1, sizeof(*pkt));
+	/* Work on the 8 bit bytes, a CDP fits a single packet. */
+	unsigned char b[256];
+	int len = hdr->payloadLengthWords;
+	if (len > (int)sizeof(b))
+		len = sizeof(b);
+	for (int i = 0; i < len; i++)
+		b[i] = sanitizeWord(hdr->payload[i]);
+
+	/* cdp_header() is 7 bytes, the footer 4. */
+	if (len < 11)
+		return -EINVAL;
+	if (((b[0] << 8) | b[1]) != EIA_708B_CDP_IDENTIFIER)
+		return -EINVAL;
+	if (b[2] < 11 || b[2] > len)
+		return -EINVAL;
+
+	struct packet_eia_708b_s *pkt = vanc_packet_decoded_alloc(ctx, sizeof(*pkt), hdr);
 	if (!pkt)
 		return -ENOMEM;
 
-	memcpy(&pkt->hdr, hdr, sizeof(*hdr));
+	pkt->cdp_identifier = EIA_708B_CDP_IDENTIFIER;
+	pkt->cdp_length = b[2];
+	pkt->cdp_frame_rate = b[3] >> 4;
+	pkt->time_code_present = (b[4] >> 7) & 1;
+	pkt->ccdata_present = (b[4] >> 6) & 1;
+	pkt->svcinfo_present = (b[4] >> 5) & 1;
+	pkt->svc_info_start = (b[4] >> 4) & 1;
+	pkt->svc_info_change = (b[4] >> 3) & 1;
+	pkt->svc_info_complete = (b[4] >> 2) & 1;
+	pkt->caption_service_active = (b[4] >> 1) & 1;
+	pkt->cdp_hdr_sequence_cntr = (b[5] << 8) | b[6];
+
+	/* Sections, in the order the spec requires them. Everything has to fit ahead of the footer. */
+	int end = pkt->cdp_length - 4;
+	int i = 7;
 
-	if (ctx->callbacks && ctx->callbacks->eia_708b)
-		ctx->callbacks->eia_708b(ctx->callback_context, ctx, pkt);
+	if (pkt->time_code_present) {
+		if (i + 5 > end || b[i] != CDP_TIME_CODE_SECTION_ID)
+			goto err;
+		i += 1 + parse_time_code_section(pkt, &b[i + 1]);
+	}
+
+	if (pkt->ccdata_present) {
+		if (i + 2 > end || b[i] != CDP_CCDATA_SECTION_ID)
+			goto err;
+		pkt->cc_count = b[i + 1] & 0x1f;
+		i += 2;
+		if (i + (pkt->cc_count * 3) > end)
+			goto err;
+		for (int j = 0; j < pkt->cc_count; j++, i += 3) {
+			pkt->cc_data[j].cc_valid = (b[i] >> 2) & 1;
+			pkt->cc_data[j].cc_type = b[i] & 0x03;
+			pkt->cc_data[j].cc_data[0] = b[i + 1];
+			pkt->cc_data[j].cc_data[1] = b[i + 2];
+		}
+	}
+
+	if (pkt->svcinfo_present) {
+		if (i + 2 > end || b[i] != CDP_CCSVCINFO_SECTION_ID)
+			goto err;
+		pkt->svc_count = b[i + 1] & 0x0f;
+		i += 2;
+		if (i + (pkt->svc_count * 7) > end)
+			goto err;
+		for (int j = 0; j < pkt->svc_count; j++, i += 7)
+			parse_svc(&pkt->svc[j], &b[i]);
+	}
+
+	/* Skip any future_section()s we don't understand. */
+	while (i < end && b[i] >= CDP_FUTURE_SECTION_ID_FIRST && b[i] <= CDP_FUTURE_SECTION_ID_LAST) {
+		if (i + 2 > end)
+			goto err;
+		i += 2 + b[i + 1];
+	}
+
+	if (i != end || b[i] != CDP_FOOTER_ID)
+		goto err;
+
+	pkt->cdp_footer_sequence_cntr = (b[i + 1] << 8) | b[i + 2];
+	pkt->packet_checksum = b[i + 3];
+
+	unsigned char sum = 0;
+	for (int j = 0; j < pkt->cdp_length; j++)
+		sum += b[j];
+	pkt->checksum_valid = (sum == 0);
+	pkt->sequence_valid = (pkt->cdp_hdr_sequence_cntr == pkt->cdp_footer_sequence_cntr);
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	pkt->sequence_discontinuity = cdp_sequence_discontinuity(priv, hdr, pkt->cdp_hdr_sequence_cntr);
+
+	if (priv->strict && (!pkt->checksum_valid || !pkt->sequence_valid))
+		goto err;
+
+	for (int j = 0; j < pkt->cc_count; j++) {
+		if (pkt->cc_data[j].cc_valid && pkt->cc_data[j].cc_type < 2)
+			vanc_eia_608_decode(ctx, pkt->cc_data[j].cc_type + 1,
+				pkt->cc_data[j].cc_data[0], pkt->cc_data[j].cc_data[1], 1);
+	}
+
+	vanc_callback(ctx, eia_708b, pkt);
 
 	*pp = pkt;
 	return KLAPI_OK;
-}
 
+err:
+	vanc_free(ctx, pkt);
+	return -EINVAL;
+}
@@ -31,26 +31,36 @@
 int dump_KL_U64LE_COUNTER(struct vanc_context_s *ctx, void *p)
 {
 	if (ctx->verbose)
-		printf("%s()\n", __func__);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s()\n", __func__);
 
 	struct packet_kl_u64le_counter_s *pkt = p;
 
-	printf("%s() KL_U64LE_COUNTER: %" PRIu64 " [%" PRIx64 "]\n", __func__, pkt->counter, pkt->counter);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s() KL_U64LE_COUNTER: %" PRIu64 " [%" PRIx64 "]\n", __func__, pkt->counter, pkt->counter);
 
 	return KLAPI_OK;
 }
 
+int vanc_encode_kl_u64le_counter(const struct packet_kl_u64le_counter_s *pkt, uint16_t *words, unsigned int wordCount)
+{
+	VALIDATE(pkt);
+
+	/* Most significant byte first, the way parse_KL_U64LE_COUNTER() reads it back. */
+	uint8_t b[8];
+	for (int i = 0; i < 8; i++)
+		b[i] = pkt->counter >> (56 - (i * 8));
+
+	return vanc_encode_packet(0x40, 0xfe, b, sizeof(b), words, wordCount);
+}
+
 int parse_KL_U64LE_COUNTER(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp)
 {
 	if (ctx->verbose)
-		printf("%s()\n", __func__);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s()\n", __func__);
 
-	struct packet_kl_u64le_counter_s *pkt = calloc(1, sizeof(*pkt));
+	struct packet_kl_u64le_counter_s *pkt = vanc_packet_decoded_alloc(ctx, sizeof(*pkt), hdr);
 	if (!pkt)
 		return -ENOMEM;
 
-	memcpy(&pkt->hdr, hdr, sizeof(*hdr));
-
 	pkt->counter = 0;
 	pkt->counter |= (uint64_t)sanitizeWord(hdr->payload[0]) << 56;
 	pkt->counter |= (uint64_t)sanitizeWord(hdr->payload[1]) << 48;
@@ -61,8 +71,7 @@ int parse_KL_U64LE_COUNTER(struct vanc_context_s *ctx, struct packet_header_s *h
 	pkt->counter |= (uint64_t)sanitizeWord(hdr->payload[6]) <<  8;
 	pkt->counter |= (uint64_t)sanitizeWord(hdr->payload[7]);
 
-	if (ctx->callbacks && ctx->callbacks->kl_i64le_counter)
-		ctx->callbacks->kl_i64le_counter(ctx->callback_context, ctx, pkt);
+	vanc_callback(ctx, kl_i64le_counter, pkt);
 
 	*pp = pkt;
 	return KLAPI_OK;
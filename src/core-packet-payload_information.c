@@ -68,11 +68,11 @@ const char *aspectRatio_to_string(enum payload_aspect_ratio_e ar)
 int dump_PAYLOAD_INFORMATION(struct vanc_context_s *ctx, void *p)
 {
 	if (ctx->verbose)
-		printf("%s()\n", __func__);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s()\n", __func__);
 
 	struct packet_payload_information_s *pkt = p;
 
-	printf("%s() AFD: %s Aspect Ratio: %s Flags: 0x%x Value1: 0x%x Value2: 0x%x\n", __func__,
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s() AFD: %s Aspect Ratio: %s Flags: 0x%x Value1: 0x%x Value2: 0x%x\n", __func__,
 		afd_to_string(pkt->afd),
 		aspectRatio_to_string(pkt->aspectRatio),
 		pkt->barDataFlags,
@@ -83,16 +83,65 @@ int dump_PAYLOAD_INFORMATION(struct vanc_context_s *ctx, void *p)
 	return KLAPI_OK;
 }
 
+int vanc_encode_payload_information(const struct packet_payload_information_s *pkt, uint16_t *words, unsigned int wordCount)
+{
+	VALIDATE(pkt);
+
+	unsigned char afd;
+	switch(pkt->afd) {
+	case AFD_BOX_16x9_TOP:
+		afd = 0x02;
+		break;
+	case AFD_BOX_14x9_TOP:
+		afd = 0x03;
+		break;
+	case AFD_BOX_16x9_CENTER:
+		afd = 0x04;
+		break;
+	case AFD_FULL_FRAME:
+		afd = 0x08;
+		break;
+	case AFD_16x9_CENTER:
+		afd = 0x0a;
+		break;
+	case AFD_14x9_CENTER:
+		afd = 0x0b;
+		break;
+	case AFD_4x3_WITH_ALTERNATIVE_14x9_CENTER:
+		afd = 0x0d;
+		break;
+	case AFD_16x9_WITH_ALTERNATIVE_14x9_CENTER:
+		afd = 0x0e;
+		break;
+	case AFD_16x9_WITH_ALTERNATIVE_4x3_CENTER:
+		afd = 0x0f;
+		break;
+	default:
+		afd = 0x00;
+	}
+
+	uint8_t b[8];
+	b[0] = (afd << 3) | (pkt->aspectRatio == ASPECT_16x9 ? 0x04 : 0x00);
+	b[1] = 0;
+	b[2] = 0;
+	b[3] = pkt->barDataFlags << 4;
+	b[4] = pkt->barDataValue[0] >> 8;
+	b[5] = pkt->barDataValue[0];
+	b[6] = pkt->barDataValue[1] >> 8;
+	b[7] = pkt->barDataValue[1];
+
+	return vanc_encode_packet(0x41, 0x05, b, sizeof(b), words, wordCount);
+}
+
 int parse_PAYLOAD_INFORMATION(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp)
 {
 	if (ctx->verbose)
-		printf("%s()\n", __func__);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s()\n", __func__);
 
-	struct packet_payload_information_s *pkt = calloc(1, sizeof(*pkt));
+	struct packet_payload_information_s *pkt = vanc_packet_decoded_alloc(ctx, sizeof(*pkt), hdr);
 	if (!pkt)
 		return -ENOMEM;
 
-	memcpy(&pkt->hdr, hdr, sizeof(*hdr));
 	unsigned char afd = (sanitizeWord(hdr->payload[0]) >> 3) & 0x0f;
 
 	switch(afd) {
@@ -138,8 +187,7 @@ int parse_PAYLOAD_INFORMATION(struct vanc_context_s *ctx, struct packet_header_s
 	pkt->barDataValue[1]  = sanitizeWord(hdr->payload[6]) << 8;
 	pkt->barDataValue[1] |= sanitizeWord(hdr->payload[7]);
 
-	if (ctx->callbacks && ctx->callbacks->payload_information)
-		ctx->callbacks->payload_information(ctx->callback_context, ctx, pkt);
+	vanc_callback(ctx, payload_information, pkt);
 
 	*pp = pkt;
 	return KLAPI_OK;
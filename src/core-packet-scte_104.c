@@ -27,7 +27,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define PRINT_DEBUG_MEMBER_INT(m) printf(" %s = 0x%x\n", #m, m);
+#define PRINT_DEBUG_MEMBER_INT(m) vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " %s = 0x%x\n", #m, m);
 
 static const char *spliceInsertTypeName(unsigned char type)
 {
@@ -97,18 +97,26 @@ static const char *mom_operationName(unsigned short opID)
 	}
 }
 
-static void hexdump(unsigned char *buf, unsigned int len, int bytesPerRow /* Typically 16 */, char *indent)
+static void hexdump(enum vanc_log_level_e level, enum vanc_log_category_e category, unsigned char *buf,
+	unsigned int len, int bytesPerRow /* Typically 16 */, char *indent)
 {
-	printf("%s", indent);
-	for (unsigned int i = 0; i < len; i++)
-		printf("%02x%s", buf[i], ((i + 1) % bytesPerRow) ? " " : "\n%s");
-	printf("\n");
+	char line[VANC_LOG_MSG_MAX];
+
+	if (!vanc_log_enabled(level, category))
+		return;
+
+	for (unsigned int i = 0; i < len; i += bytesPerRow) {
+		int n = snprintf(line, sizeof(line), "%s", indent);
+		for (unsigned int j = i; j < len && j < i + bytesPerRow && n < (int)sizeof(line); j++)
+			n += snprintf(line + n, sizeof(line) - n, "%02x ", buf[j]);
+		vanc_log(level, category, "%s\n", line);
+	}
 }
 
 static unsigned char *parse_splice_request_data(unsigned char *p, struct splice_request_data *d)
 {
 	d->splice_insert_type  = *(p++);
-	d->splice_event_id     = *(p + 0) << 24 | *(p + 1) << 16 | *(p + 2) <<  8 | *(p + 3); p += 4;
+	d->splice_event_id     = (uint32_t)*(p + 0) << 24 | *(p + 1) << 16 | *(p + 2) <<  8 | *(p + 3); p += 4;
 	d->unique_program_id   = *(p + 0) << 8 | *(p + 1); p += 2;
 	d->pre_roll_time       = *(p + 0) << 8 | *(p + 1); p += 2;
 	d->brk_duration        = *(p + 0) << 8 | *(p + 1); p += 2;
@@ -125,7 +133,7 @@ static unsigned char *parse_splice_request_data(unsigned char *p, struct splice_
 		break;
 	default:
 		/* We don't support this splice command */
-		fprintf(stderr, "%s() splice_insert_type 0x%x [%s], error.\n", __func__,
+		vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_DECODE, "%s() splice_insert_type 0x%x [%s], error.\n", __func__,
 			d->splice_insert_type,
 		spliceInsertTypeName(d->splice_insert_type));
 	}
@@ -133,12 +141,124 @@ static unsigned char *parse_splice_request_data(unsigned char *p, struct splice_
 	return p;
 }
 
-static unsigned char *parse_mom_timestamp(unsigned char *p, struct multiple_operation_message_timestamp *ts)
+/* Returns 1 once decoded, or < 0. */
+static int decode_mom_op(struct multiple_operation_message_operation *op)
 {
+	const unsigned char *p = op->data;
+	unsigned int len = op->data_length;
+
+	switch (op->opID) {
+	case MO_SPLICE_REQUEST_DATA:
+		if (len < 14)
+			return -EINVAL;
+		parse_splice_request_data(op->data, &op->sr_data);
+		return 1;
+	case MO_SPLICE_NULL_REQUEST_DATA:
+	case MO_START_SCHEDULE_DOWNLOAD_REQUEST_DATA:
+		return 1;
+	case MO_TIME_SIGNAL_REQUEST_DATA:
+		if (len < 2)
+			return -EINVAL;
+		op->timesignal_data.pre_roll_time = p[0] << 8 | p[1];
+		return 1;
+	case MO_ENCRYPTED_DPI_REQUEST_DATA:
+		if (len < 2)
+			return -EINVAL;
+		op->encrypted_dpi_data.encryption_algorithm = p[0];
+		op->encrypted_dpi_data.cw_index = p[1];
+		return 1;
+	case MO_INSERT_DESCRIPTOR_REQUEST_DATA:
+		if (len < 1)
+			return -EINVAL;
+		op->descriptor_data.descriptor_count = p[0];
+		op->descriptor_data.descriptor_bytes_length = len - 1;
+		op->descriptor_data.descriptor_bytes = p + 1;
+		return 1;
+	case MO_INSERT_DTMF_REQUEST_DATA: {
+		struct scte104_dtmf_descriptor_request_data *d = &op->dtmf_data;
+		if (len < 2)
+			return -EINVAL;
+		d->pre_roll_time = p[0];
+		d->dtmf_length = p[1];
+		if (d->dtmf_length > sizeof(d->dtmf_char) || 2 + d->dtmf_length > len)
+			return -EINVAL;
+		memcpy(d->dtmf_char, p + 2, d->dtmf_length);
+		return 1;
+	}
+	case MO_INSERT_AVAIL_DESCRIPTOR_REQUEST_DATA:
+		if (len < 1 || 1 + (p[0] * 4) > len)
+			return -EINVAL;
+		op->avail_descriptor_data.num_provider_avails = p[0];
+		op->avail_descriptor_data.provider_avail_ids = p + 1;
+		return 1;
+	case MO_INSERT_SEGMENTATION_REQUEST_DATA: {
+		struct scte104_segmentation_descriptor_request_data *d = &op->segmentation_data;
+		if (len < 9 || 9 + p[8] + 3 > len)
+			return -EINVAL;
+		d->segmentation_event_id = (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+		d->segmentation_event_cancel_indicator = p[4];
+		d->duration = p[5] << 8 | p[6];
+		d->segmentation_upid_type = p[7];
+		d->segmentation_upid_length = p[8];
+		d->segmentation_upid = p + 9;
+		p += 9 + d->segmentation_upid_length;
+		len -= 9 + d->segmentation_upid_length;
+		d->segmentation_type_id = p[0];
+		d->segment_num = p[1];
+		d->segments_expected = p[2];
+
+		/* Older encoders stop here, their segments carry no delivery restrictions. */
+		d->delivery_not_restricted_flag = 1;
+		if (len >= 9) {
+			d->duration_extension_frames = p[3];
+			d->delivery_not_restricted_flag = p[4];
+			d->web_delivery_allowed_flag = p[5];
+			d->no_regional_blackout_flag = p[6];
+			d->archive_allowed_flag = p[7];
+			d->device_restrictions = p[8];
+		}
+		return 1;
+	}
+	case MO_PROPRIETARY_COMMAND_REQUEST_DATA:
+		if (len < 5)
+			return -EINVAL;
+		op->proprietary_data.proprietary_id = (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+		op->proprietary_data.proprietary_command = p[4];
+		op->proprietary_data.proprietary_data_length = len - 5;
+		op->proprietary_data.proprietary_data = p + 5;
+		return 1;
+	default:
+		return -ENOTSUP;
+	}
+}
+
+int scte_104_decode_mom_op(struct multiple_operation_message_operation *op)
+{
+	if (!op)
+		return -EINVAL;
+
+	if (op->decodeState == 0)
+		op->decodeState = decode_mom_op(op);
+
+	return op->decodeState > 0 ? 0 : op->decodeState;
+}
+
+/* Returns the first byte after the timestamp, or NULL if the message ends inside it. */
+static unsigned char *parse_mom_timestamp(unsigned char *p, const unsigned char *end,
+	struct multiple_operation_message_timestamp *ts)
+{
+	static const unsigned char timeLength[4] = { 0, 6, 4, 2 };
+
+	if (p >= end)
+		return NULL;
+
 	ts->time_type = *(p++);
+	if (ts->time_type < sizeof(timeLength) && p + timeLength[ts->time_type] > end)
+		return NULL;
+
 	switch (ts->time_type) {
 	case 1:
-		ts->time_type_1.UTC_seconds      = *(p + 0) << 24 | *(p + 1) << 16 | *(p + 2) << 8 | *(p + 3);
+		ts->time_type_1.UTC_seconds      = (uint32_t)*(p + 0) << 24 | *(p + 1) << 16 | *(p + 2) << 8 | *(p + 3);
 		ts->time_type_1.UTC_microseconds = *(p + 4) << 8 | *(p + 5);
 		p += 6;
 		break;
@@ -158,7 +278,7 @@ static unsigned char *parse_mom_timestamp(unsigned char *p, struct multiple_oper
 		/* The spec says no time is defined, this is a legitimate state. */
 		break;
 	default:
-		fprintf(stderr, "%s() unsupported time_type 0x%x, assuming no time.\n", __func__, ts->time_type);
+		vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_DECODE, "%s() unsupported time_type 0x%x, assuming no time.\n", __func__, ts->time_type);
 	}
 
 	return p;
@@ -168,11 +288,11 @@ static int dump_mom(struct vanc_context_s *ctx, struct packet_scte_104_s *pkt)
 {
 	struct multiple_operation_message *m = &pkt->mo_msg;
 
-	printf("SCTE104 multiple_operation_message struct\n");
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "SCTE104 multiple_operation_message struct\n");
 	PRINT_DEBUG_MEMBER_INT(pkt->payloadDescriptorByte);
 
 	PRINT_DEBUG_MEMBER_INT(m->rsvd);
-	printf("    rsvd = %s\n", m->rsvd == 0xFFFF ? "Multiple_Ops (Reserved)" : "UNSUPPORTED");
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "    rsvd = %s\n", m->rsvd == 0xFFFF ? "Multiple_Ops (Reserved)" : "UNSUPPORTED");
 	PRINT_DEBUG_MEMBER_INT(m->messageSize);
 	PRINT_DEBUG_MEMBER_INT(m->protocol_version);
 	PRINT_DEBUG_MEMBER_INT(m->AS_index);
@@ -183,20 +303,42 @@ static int dump_mom(struct vanc_context_s *ctx, struct packet_scte_104_s *pkt)
 
 	for (int i = 0; i < m->num_ops; i++) {
        		struct multiple_operation_message_operation *o = &m->ops[i];
-		printf("\n opID[%d] = %s\n", i, mom_operationName(o->opID));
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "\n opID[%d] = %s\n", i, mom_operationName(o->opID));
 		PRINT_DEBUG_MEMBER_INT(o->opID);
 		PRINT_DEBUG_MEMBER_INT(o->data_length);
 		if (o->data_length)
-			hexdump(o->data, o->data_length, 32, "    ");
-		if (o->opID == MO_INIT_REQUEST_DATA) {
-			struct splice_request_data *d = &pkt->sr_data;
+			hexdump(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, o->data, o->data_length, 32, "    ");
+		if (scte_104_decode_mom_op(o) < 0)
+			continue;
+		if (o->opID == MO_TIME_SIGNAL_REQUEST_DATA) {
+			PRINT_DEBUG_MEMBER_INT(o->timesignal_data.pre_roll_time);
+		} else if (o->opID == MO_INSERT_DTMF_REQUEST_DATA) {
+			PRINT_DEBUG_MEMBER_INT(o->dtmf_data.pre_roll_time);
+			vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "    dtmf = %.*s\n", o->dtmf_data.dtmf_length, o->dtmf_data.dtmf_char);
+		} else if (o->opID == MO_INSERT_AVAIL_DESCRIPTOR_REQUEST_DATA) {
+			PRINT_DEBUG_MEMBER_INT(o->avail_descriptor_data.num_provider_avails);
+		} else if (o->opID == MO_INSERT_SEGMENTATION_REQUEST_DATA) {
+			struct scte104_segmentation_descriptor_request_data *d = &o->segmentation_data;
+			PRINT_DEBUG_MEMBER_INT(d->segmentation_event_id);
+			PRINT_DEBUG_MEMBER_INT(d->segmentation_event_cancel_indicator);
+			PRINT_DEBUG_MEMBER_INT(d->duration);
+			PRINT_DEBUG_MEMBER_INT(d->segmentation_upid_type);
+			PRINT_DEBUG_MEMBER_INT(d->segmentation_upid_length);
+			PRINT_DEBUG_MEMBER_INT(d->segmentation_type_id);
+			PRINT_DEBUG_MEMBER_INT(d->segment_num);
+			PRINT_DEBUG_MEMBER_INT(d->segments_expected);
+		} else if (o->opID == MO_PROPRIETARY_COMMAND_REQUEST_DATA) {
+			PRINT_DEBUG_MEMBER_INT(o->proprietary_data.proprietary_id);
+			PRINT_DEBUG_MEMBER_INT(o->proprietary_data.proprietary_command);
+		} else if (o->opID == MO_INIT_REQUEST_DATA) {
+			struct splice_request_data *d = &o->sr_data;
 			PRINT_DEBUG_MEMBER_INT(d->splice_insert_type);
-			printf("    splice_insert_type = %s\n", spliceInsertTypeName(d->splice_insert_type));
+			vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "    splice_insert_type = %s\n", spliceInsertTypeName(d->splice_insert_type));
 			PRINT_DEBUG_MEMBER_INT(d->splice_event_id);
 			PRINT_DEBUG_MEMBER_INT(d->unique_program_id);
 			PRINT_DEBUG_MEMBER_INT(d->pre_roll_time);
 			PRINT_DEBUG_MEMBER_INT(d->brk_duration);
-			printf("    break_duration = %d (1/10th seconds)\n", d->brk_duration);
+			vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "    break_duration = %d (1/10th seconds)\n", d->brk_duration);
 			PRINT_DEBUG_MEMBER_INT(d->avail_num);
 			PRINT_DEBUG_MEMBER_INT(d->avails_expected);
 			PRINT_DEBUG_MEMBER_INT(d->auto_return_flag);
@@ -211,13 +353,13 @@ static int dump_som(struct vanc_context_s *ctx, struct packet_scte_104_s *pkt)
         struct splice_request_data *d = &pkt->sr_data;
 	struct single_operation_message *m = &pkt->so_msg;
 
-	printf("SCTE104 single_operation_message struct\n");
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "SCTE104 single_operation_message struct\n");
 	PRINT_DEBUG_MEMBER_INT(pkt->payloadDescriptorByte);
 
 	PRINT_DEBUG_MEMBER_INT(m->opID);
-	printf("   opID = %s\n", som_operationName(m->opID));
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "   opID = %s\n", som_operationName(m->opID));
 	PRINT_DEBUG_MEMBER_INT(m->messageSize);
-	printf("   message_size = %d bytes\n", m->messageSize);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "   message_size = %d bytes\n", m->messageSize);
 	PRINT_DEBUG_MEMBER_INT(m->result);
 	PRINT_DEBUG_MEMBER_INT(m->result_extension);
 	PRINT_DEBUG_MEMBER_INT(m->protocol_version);
@@ -227,21 +369,24 @@ static int dump_som(struct vanc_context_s *ctx, struct packet_scte_104_s *pkt)
 
 	if (m->opID == SO_INIT_REQUEST_DATA) {
 		PRINT_DEBUG_MEMBER_INT(d->splice_insert_type);
-		printf("   splice_insert_type = %s\n", spliceInsertTypeName(d->splice_insert_type));
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "   splice_insert_type = %s\n", spliceInsertTypeName(d->splice_insert_type));
 		PRINT_DEBUG_MEMBER_INT(d->splice_event_id);
 		PRINT_DEBUG_MEMBER_INT(d->unique_program_id);
 		PRINT_DEBUG_MEMBER_INT(d->pre_roll_time);
 		PRINT_DEBUG_MEMBER_INT(d->brk_duration);
-		printf("   break_duration = %d (1/10th seconds)\n", d->brk_duration);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "   break_duration = %d (1/10th seconds)\n", d->brk_duration);
 		PRINT_DEBUG_MEMBER_INT(d->avail_num);
 		PRINT_DEBUG_MEMBER_INT(d->avails_expected);
 		PRINT_DEBUG_MEMBER_INT(d->auto_return_flag);
 	} else
-		printf("   unsupported m->opID = 0x%x\n", m->opID);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "   unsupported m->opID = 0x%x\n", m->opID);
 
-	for (int i = 0; i < pkt->payloadLengthBytes; i++)
-		printf("%02x ", pkt->payload[i]);
-	printf("\n");
+	char line[VANC_LOG_MSG_MAX];
+	int n = 0;
+	line[0] = 0;
+	for (int i = 0; i < pkt->payloadLengthBytes && n < (int)sizeof(line); i++)
+		n += snprintf(line + n, sizeof(line) - n, "%02x ", pkt->payload[i]);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s\n", line);
 
 	return KLAPI_OK;
 }
@@ -251,7 +396,7 @@ int dump_SCTE_104(struct vanc_context_s *ctx, void *p)
 	struct packet_scte_104_s *pkt = p;
 
 	if (ctx->verbose)
-		printf("%s() %p\n", __func__, (void *)pkt);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s() %p\n", __func__, (void *)pkt);
 
 	if (pkt->so_msg.opID == SO_INIT_REQUEST_DATA)
 		return dump_som(ctx, pkt);
@@ -259,39 +404,356 @@ int dump_SCTE_104(struct vanc_context_s *ctx, void *p)
 	return dump_mom(ctx, pkt);
 }
 
+void free_SCTE_104(struct vanc_context_s *ctx, void *p)
+{
+	struct packet_scte_104_s *pkt = p;
+
+	if (pkt->so_msg.opID == 0xFFFF && pkt->mo_msg.ops)
+		vanc_free(ctx, pkt->mo_msg.ops);
+
+	vanc_free(ctx, pkt);
+}
+
+static void reassembly_orphan(struct vanc_context_private_s *priv, struct vanc_scte_104_reassembly_s *r, const char *why)
+{
+	vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_DECODE, "%s() discarding partial message from line %d, %s\n",
+		__func__, r->lineNr, why);
+	vanc_stat_add(priv->stats.scte104Orphaned, 1);
+	r->active = 0;
+}
+
+/* Accumulate one packet of a multi packet message. Returns the slot holding the
+ * complete message once the final packet arrives, otherwise NULL.
+ */
+static struct vanc_scte_104_reassembly_s *reassemble(struct vanc_context_s *ctx, struct packet_header_s *hdr,
+	int continued, int following)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	struct vanc_scte_104_reassembly_s *r = NULL, *oldest = NULL, *unused = NULL;
+	uint64_t now = vanc_clock_now_ms();
+
+	vanc_stat_add(priv->stats.scte104Fragments, 1);
+
+	for (int i = 0; i < SCTE_104_REASSEMBLY_SLOTS; i++) {
+		struct vanc_scte_104_reassembly_s *s = &priv->scte104[i];
+		if (s->active && now - s->startMs > priv->scte104TimeoutMs)
+			reassembly_orphan(priv, s, "timed out");
+		if (!s->active) {
+			if (!unused)
+				unused = s;
+			continue;
+		}
+		if (s->did == hdr->did && s->sdid == hdr->dbnsdid)
+			r = s;
+		if (!oldest || s->startMs < oldest->startMs)
+			oldest = s;
+	}
+
+	if (!continued) {
+		/* First packet of a new message. */
+		if (r)
+			reassembly_orphan(priv, r, "interrupted by a new message");
+		else if (unused)
+			r = unused;
+		else {
+			reassembly_orphan(priv, oldest, "no free reassembly slots");
+			r = oldest;
+		}
+		r->active = 1;
+		r->did = hdr->did;
+		r->sdid = hdr->dbnsdid;
+		r->lineNr = hdr->lineNr;
+		r->startMs = now;
+		r->len = 0;
+	} else if (!r) {
+		vanc_stat_add(priv->stats.scte104Orphaned, 1);
+		return NULL;
+	}
+
+	unsigned int bytes = hdr->payloadLengthWords - 1;
+	if (r->len + bytes > sizeof(r->buf)) {
+		reassembly_orphan(priv, r, "message too large");
+		return NULL;
+	}
+	for (unsigned int i = 0; i < bytes; i++)
+		r->buf[r->len + i] = sanitizeWord(hdr->payload[1 + i]);
+	r->len += bytes;
+
+	if (following)
+		return NULL;
+
+	r->active = 0;
+	vanc_stat_add(priv->stats.scte104Reassembled, 1);
+	return r;
+}
+
+int vanc_context_set_scte_104_timeout(struct vanc_context_s *ctx, unsigned int timeoutMs)
+{
+	VALIDATE(ctx);
+
+	getPrivate(ctx)->scte104TimeoutMs = timeoutMs;
+
+	return KLAPI_OK;
+}
+
+static void put_splice_request_data(struct vanc_byte_writer_s *w, const struct splice_request_data *d)
+{
+	vanc_put8(w, d->splice_insert_type);
+	vanc_put32(w, d->splice_event_id);
+	vanc_put16(w, d->unique_program_id);
+	vanc_put16(w, d->pre_roll_time);
+	vanc_put16(w, d->brk_duration);
+	vanc_put8(w, d->avail_num);
+	vanc_put8(w, d->avails_expected);
+	vanc_put8(w, d->auto_return_flag);
+}
+
+/* The inverse of decode_mom_op(), for operations built by hand without raw data. */
+static int put_mom_op_data(struct vanc_byte_writer_s *w, const struct multiple_operation_message_operation *op)
+{
+	switch (op->opID) {
+	case MO_SPLICE_REQUEST_DATA:
+		put_splice_request_data(w, &op->sr_data);
+		break;
+	case MO_SPLICE_NULL_REQUEST_DATA:
+	case MO_START_SCHEDULE_DOWNLOAD_REQUEST_DATA:
+		break;
+	case MO_TIME_SIGNAL_REQUEST_DATA:
+		vanc_put16(w, op->timesignal_data.pre_roll_time);
+		break;
+	case MO_ENCRYPTED_DPI_REQUEST_DATA:
+		vanc_put8(w, op->encrypted_dpi_data.encryption_algorithm);
+		vanc_put8(w, op->encrypted_dpi_data.cw_index);
+		break;
+	case MO_INSERT_DESCRIPTOR_REQUEST_DATA: {
+		const struct scte104_insert_descriptor_request_data *d = &op->descriptor_data;
+		if (d->descriptor_bytes_length && !d->descriptor_bytes)
+			return -EINVAL;
+		vanc_put8(w, d->descriptor_count);
+		vanc_put_bytes(w, d->descriptor_bytes, d->descriptor_bytes_length);
+		break;
+	}
+	case MO_INSERT_DTMF_REQUEST_DATA: {
+		const struct scte104_dtmf_descriptor_request_data *d = &op->dtmf_data;
+		if (d->dtmf_length > sizeof(d->dtmf_char))
+			return -EINVAL;
+		vanc_put8(w, d->pre_roll_time);
+		vanc_put8(w, d->dtmf_length);
+		vanc_put_bytes(w, (const uint8_t *)d->dtmf_char, d->dtmf_length);
+		break;
+	}
+	case MO_INSERT_AVAIL_DESCRIPTOR_REQUEST_DATA: {
+		const struct scte104_avail_descriptor_request_data *d = &op->avail_descriptor_data;
+		if (d->num_provider_avails && !d->provider_avail_ids)
+			return -EINVAL;
+		vanc_put8(w, d->num_provider_avails);
+		vanc_put_bytes(w, d->provider_avail_ids, d->num_provider_avails * 4);
+		break;
+	}
+	case MO_INSERT_SEGMENTATION_REQUEST_DATA: {
+		const struct scte104_segmentation_descriptor_request_data *d = &op->segmentation_data;
+		if (d->segmentation_upid_length && !d->segmentation_upid)
+			return -EINVAL;
+		vanc_put32(w, d->segmentation_event_id);
+		vanc_put8(w, d->segmentation_event_cancel_indicator);
+		vanc_put16(w, d->duration);
+		vanc_put8(w, d->segmentation_upid_type);
+		vanc_put8(w, d->segmentation_upid_length);
+		vanc_put_bytes(w, d->segmentation_upid, d->segmentation_upid_length);
+		vanc_put8(w, d->segmentation_type_id);
+		vanc_put8(w, d->segment_num);
+		vanc_put8(w, d->segments_expected);
+		vanc_put8(w, d->duration_extension_frames);
+		vanc_put8(w, d->delivery_not_restricted_flag);
+		vanc_put8(w, d->web_delivery_allowed_flag);
+		vanc_put8(w, d->no_regional_blackout_flag);
+		vanc_put8(w, d->archive_allowed_flag);
+		vanc_put8(w, d->device_restrictions);
+		break;
+	}
+	case MO_PROPRIETARY_COMMAND_REQUEST_DATA: {
+		const struct scte104_proprietary_command_request_data *d = &op->proprietary_data;
+		if (d->proprietary_data_length && !d->proprietary_data)
+			return -EINVAL;
+		vanc_put32(w, d->proprietary_id);
+		vanc_put8(w, d->proprietary_command);
+		vanc_put_bytes(w, d->proprietary_data, d->proprietary_data_length);
+		break;
+	}
+	default:
+		return -ENOTSUP;
+	}
+
+	return KLAPI_OK;
+}
+
+static void put_mom_timestamp(struct vanc_byte_writer_s *w, const struct multiple_operation_message_timestamp *ts)
+{
+	vanc_put8(w, ts->time_type);
+	switch (ts->time_type) {
+	case 1:
+		vanc_put32(w, ts->time_type_1.UTC_seconds);
+		vanc_put16(w, ts->time_type_1.UTC_microseconds);
+		break;
+	case 2:
+		vanc_put8(w, ts->time_type_2.hours);
+		vanc_put8(w, ts->time_type_2.minutes);
+		vanc_put8(w, ts->time_type_2.seconds);
+		vanc_put8(w, ts->time_type_2.frames);
+		break;
+	case 3:
+		vanc_put8(w, ts->time_type_3.GPI_number);
+		vanc_put8(w, ts->time_type_3.GPI_edge);
+		break;
+	}
+}
+
+/* Serialize the message into buf, messageSize is patched in at bytes 2 and 3. */
+static int put_message(const struct packet_scte_104_s *pkt, struct vanc_byte_writer_s *w)
+{
+	if (pkt->so_msg.opID == SO_INIT_REQUEST_DATA) {
+		const struct single_operation_message *m = &pkt->so_msg;
+		vanc_put16(w, m->opID);
+		vanc_put16(w, 0);
+		vanc_put16(w, m->result);
+		vanc_put16(w, m->result_extension);
+		vanc_put8(w, m->protocol_version);
+		vanc_put8(w, m->AS_index);
+		vanc_put8(w, m->message_number);
+		vanc_put16(w, m->DPI_PID_index);
+		put_splice_request_data(w, &pkt->sr_data);
+	} else
+	if (pkt->so_msg.opID == 0xFFFF /* Multiple Operation Message */) {
+		const struct multiple_operation_message *mom = &pkt->mo_msg;
+		if (mom->num_ops && !mom->ops)
+			return -EINVAL;
+		vanc_put16(w, 0xffff);
+		vanc_put16(w, 0);
+		vanc_put8(w, mom->protocol_version);
+		vanc_put8(w, mom->AS_index);
+		vanc_put8(w, mom->message_number);
+		vanc_put16(w, mom->DPI_PID_index);
+		vanc_put8(w, mom->SCTE35_protocol_version);
+		put_mom_timestamp(w, &mom->timestamp);
+		vanc_put8(w, mom->num_ops);
+
+		for (int i = 0; i < mom->num_ops; i++) {
+			const struct multiple_operation_message_operation *o = &mom->ops[i];
+			vanc_put16(w, o->opID);
+			unsigned int lengthPos = w->pos;
+			vanc_put16(w, 0);
+			if (o->data)
+				vanc_put_bytes(w, o->data, o->data_length);
+			else {
+				int ret = put_mom_op_data(w, o);
+				if (ret < 0)
+					return ret;
+			}
+			if (w->overflow)
+				return -ENOSPC;
+			unsigned int len = w->pos - lengthPos - 2;
+			w->buf[lengthPos + 0] = len >> 8;
+			w->buf[lengthPos + 1] = len;
+		}
+	} else
+		return -ENOTSUP;
+
+	if (w->overflow)
+		return -ENOSPC;
+
+	w->buf[2] = w->pos >> 8;
+	w->buf[3] = w->pos;
+
+	return KLAPI_OK;
+}
+
+int vanc_encode_scte_104(const struct packet_scte_104_s *pkt, uint16_t *words, unsigned int wordCount)
+{
+	VALIDATE(pkt);
+	VALIDATE(words);
+
+	uint8_t msg[SCTE_104_MESSAGE_MAX];
+	struct vanc_byte_writer_s w = { msg, sizeof(msg), 0, 0 };
+
+	int ret = put_message(pkt, &w);
+	if (ret < 0)
+		return ret;
+
+	/* One payload descriptor byte plus up to 254 message bytes per packet, SMPTE 2010 5.3.3. */
+	unsigned int total = 0;
+	for (unsigned int offset = 0; offset < w.pos; ) {
+		unsigned int len = w.pos - offset;
+		if (len > 254)
+			len = 254;
+
+		uint8_t b[255];
+		b[0] = (0x01 << 3) | (pkt->duplicate_msg & 0x01);	/* Version 1 */
+		if (offset)
+			b[0] |= 0x04;					/* continued_pkt */
+		if (offset + len < w.pos)
+			b[0] |= 0x02;					/* following_pkt */
+		memcpy(b + 1, msg + offset, len);
+
+		ret = vanc_encode_packet(0x41, 0x07, b, len + 1, words + total, wordCount - total);
+		if (ret < 0)
+			return ret;
+
+		total += ret;
+		offset += len;
+	}
+
+	return total;
+}
+
 int parse_SCTE_104(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp)
 {
 	if (ctx->verbose)
-		printf("%s()\n", __func__);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s()\n", __func__);
+
+	if (hdr->payloadLengthWords < 1)
+		return -EINVAL;
+
+	unsigned char payloadDescriptorByte = sanitizeWord(hdr->payload[0]);
+	int continued = (payloadDescriptorByte >> 2) & 0x01;
+	int following = (payloadDescriptorByte >> 1) & 0x01;
+
+	/* SMPTE 2010 version 1 is the only version defined. */
+	if (((payloadDescriptorByte >> 3) & 0x03) != 0x01)
+		return -EINVAL;
+
+	struct vanc_scte_104_reassembly_s *r = NULL;
+	if (continued || following) {
+		r = reassemble(ctx, hdr, continued, following);
+		if (!r) {
+			/* Nothing to decode until the final packet arrives. */
+			*pp = NULL;
+			return KLAPI_OK;
+		}
+	}
 
-	struct packet_scte_104_s *pkt = calloc(1, sizeof(*pkt));
+	struct packet_scte_104_s *pkt = vanc_packet_decoded_alloc(ctx, sizeof(*pkt), hdr);
 	if (!pkt)
 		return -ENOMEM;
 
-	memcpy(&pkt->hdr, hdr, sizeof(*hdr));
+	pkt->payloadDescriptorByte = payloadDescriptorByte;
+	pkt->version               = (pkt->payloadDescriptorByte >> 3) & 0x03;
+	pkt->continued_pkt         = continued;
+	pkt->following_pkt         = following;
+	pkt->duplicate_msg         = pkt->payloadDescriptorByte & 0x01;
 
-        pkt->payloadDescriptorByte = hdr->payload[0];
-        pkt->version               = (pkt->payloadDescriptorByte >> 3) & 0x03;
-        pkt->continued_pkt         = (pkt->payloadDescriptorByte >> 2) & 0x01;
-        pkt->following_pkt         = (pkt->payloadDescriptorByte >> 1) & 0x01;
-        pkt->duplicate_msg         = pkt->payloadDescriptorByte & 0x01;
-
-	/* We only support SCTE104 messages of type
-	 * single_operation_message() that are completely
-	 * self containined with a single VANC line, and
-	 * are not continuation messages.
-	 * Eg. payloadDescriptor value 0x08.
+	/* First byte is the payloadDescriptor, the rest is the SCTE104 message,
+	 * up to 254 bytes per packet, item 5.3.3 page 7.
 	 */
-	if (pkt->payloadDescriptorByte != 0x08) {
-		free(pkt);
-		return -1;
+	if (r) {
+		pkt->hdr.lineNr = r->lineNr;
+		memcpy(pkt->payload, r->buf, r->len);
+		pkt->payloadLengthBytes = r->len;
+	} else {
+		pkt->payloadLengthBytes = hdr->payloadLengthWords - 1;
+		for (unsigned int i = 0; i < pkt->payloadLengthBytes; i++)
+			pkt->payload[i] = sanitizeWord(hdr->payload[1 + i]);
 	}
 
-	/* First byte is the padloadDescriptor, the rest is the SCTE104 message...
-	 * up to 200 bytes in length item 5.3.3 page 7 */
-	for (int i = 0; i < 200; i++)
-		pkt->payload[i] = hdr->payload[1 + i];
-
 	struct single_operation_message *m = &pkt->so_msg;
 	struct multiple_operation_message *mom = &pkt->mo_msg;
 
@@ -300,10 +762,23 @@ int parse_SCTE_104(struct vanc_context_s *ctx, struct packet_header_s *hdr, void
 	 * We rely on checking som.opID during the dump process
 	 * to determinate the structure type.
 	 */
+	if (pkt->payloadLengthBytes < 2) {
+		vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_DECODE, "%s() message too short for an opID, error.\n", __func__);
+		vanc_free(ctx, pkt);
+		return -EINVAL;
+	}
 	m->opID = pkt->payload[0] << 8 | pkt->payload[1];
 
 	if (m->opID == SO_INIT_REQUEST_DATA) {
 
+		/* Header and splice_request_data, up to auto_return_flag. */
+		if (pkt->payloadLengthBytes < 27) {
+			vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_DECODE, "%s() SOM of %d bytes is truncated, error.\n",
+				__func__, pkt->payloadLengthBytes);
+			vanc_free(ctx, pkt);
+			return -EINVAL;
+		}
+
 		/* TODO: Will we ever see a trigger in a SOM. Interal discussion says
 		 *       no. We'll leave this active for the time being, pending removal.
 		 */
@@ -318,7 +793,7 @@ int parse_SCTE_104(struct vanc_context_s *ctx, struct packet_header_s *hdr, void
 		struct splice_request_data *d = &pkt->sr_data;
 
 		d->splice_insert_type  = pkt->payload[13];
-		d->splice_event_id     = pkt->payload[14] << 24 |
+		d->splice_event_id     = (uint32_t)pkt->payload[14] << 24 |
 			pkt->payload[15] << 16 | pkt->payload[16] <<  8 | pkt->payload[17];
 		d->unique_program_id   = pkt->payload[18] << 8 | pkt->payload[19];
 		d->pre_roll_time       = pkt->payload[20] << 8 | pkt->payload[21];
@@ -334,12 +809,24 @@ int parse_SCTE_104(struct vanc_context_s *ctx, struct packet_header_s *hdr, void
 			break;
 		default:
 			/* We don't support this splice command */
-			fprintf(stderr, "%s() splice_insert_type 0x%x, error.\n", __func__, d->splice_insert_type);
-			free(pkt);
+			vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_DECODE, "%s() splice_insert_type 0x%x, error.\n", __func__, d->splice_insert_type);
+			vanc_free(ctx, pkt);
 			return -1;
 		}
 	} else
 	if (m->opID == 0xFFFF /* Multiple Operation Message */) {
+		unsigned char *p = &pkt->payload[10];
+		unsigned char *end = &pkt->payload[pkt->payloadLengthBytes];
+
+		/* The fixed header, then a timestamp and num_ops at the least. */
+		if (pkt->payloadLengthBytes < 10 ||
+		    !(p = parse_mom_timestamp(p, end, &mom->timestamp)) || p >= end) {
+			vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_DECODE, "%s() MOM of %d bytes is truncated, error.\n",
+				__func__, pkt->payloadLengthBytes);
+			vanc_free(ctx, pkt);
+			return -EINVAL;
+		}
+
 		mom->rsvd                    = pkt->payload[0] << 8 | pkt->payload[1];
 		mom->messageSize             = pkt->payload[2] << 8 | pkt->payload[3];
 		mom->protocol_version        = pkt->payload[4];
@@ -348,36 +835,35 @@ int parse_SCTE_104(struct vanc_context_s *ctx, struct packet_header_s *hdr, void
 		mom->DPI_PID_index           = pkt->payload[7] << 8 | pkt->payload[8];
 		mom->SCTE35_protocol_version = pkt->payload[9];
 
-		unsigned char *p = &pkt->payload[10];
-		p = parse_mom_timestamp(p, &mom->timestamp);
-		
 		mom->num_ops = *(p++);
-		mom->ops = calloc(mom->num_ops, sizeof(struct multiple_operation_message_operation));
+		mom->ops = vanc_calloc(ctx, mom->num_ops, sizeof(struct multiple_operation_message_operation));
 		if (!mom->ops) {
-			fprintf(stderr, "%s() unable to allocate momo ram, error.\n", __func__);
-			free(pkt);
+			vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_DECODE, "%s() unable to allocate momo ram, error.\n", __func__);
+			vanc_free(ctx, pkt);
 			return -1;
 		}
 
 		for (int i = 0; i < mom->num_ops; i++) {
         		struct multiple_operation_message_operation *o = &mom->ops[i];
+			if (p + 4 > end || p + 4 + ((*(p + 2) << 8) | *(p + 3)) > end) {
+				vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_DECODE, "%s() mom op %d runs past the end of the message, error.\n",
+					__func__, i);
+				free_SCTE_104(ctx, pkt);
+				return -EINVAL;
+			}
 			o->opID = *(p + 0) << 8 | *(p + 1);
 			o->data_length = *(p + 2) << 8 | *(p + 3);
-			o->data = malloc(o->data_length);
-			if (!o->data) {
-				fprintf(stderr, "%s() Unable to allocate memory for mom op, error.\n", __func__);
-			} else {
-				memcpy(o->data, p + 4, o->data_length);
-			}
+			/* Operations stay as raw bytes in the payload, decoded on demand. */
+			o->data = p + 4;
 			p += (4 + o->data_length);
 
-			if (o->opID == MO_INIT_REQUEST_DATA)
-				parse_splice_request_data(o->data, &pkt->sr_data);
+			if (o->opID == MO_INIT_REQUEST_DATA && scte_104_decode_mom_op(o) == 0)
+				pkt->sr_data = o->sr_data;
 
-#if 1
-			printf("opID = 0x%04x [%s], length = 0x%04x : ", o->opID, mom_operationName(o->opID), o->data_length);
-			hexdump(o->data, o->data_length, 32, "");
-#endif
+			vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_DECODE, "opID = 0x%04x [%s], length = 0x%04x\n",
+				o->opID, mom_operationName(o->opID), o->data_length);
+			if (o->data_length)
+				hexdump(VANC_LOG_DEBUG, VANC_LOG_CAT_DECODE, o->data, o->data_length, 32, "    ");
 		}
 
 		/* We'll parse this message but we'll only look for INIT_REQUEST_DATA
@@ -386,13 +872,12 @@ int parse_SCTE_104(struct vanc_context_s *ctx, struct packet_header_s *hdr, void
 		 */
 	}
 	else {
-		fprintf(stderr, "%s() Unsupported opID = %x, error.\n", __func__, m->opID);
-		free(pkt);
+		vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_DECODE, "%s() Unsupported opID = %x, error.\n", __func__, m->opID);
+		vanc_free(ctx, pkt);
 		return -1;
 	}
 
-	if (ctx->callbacks && ctx->callbacks->scte_104)
-		ctx->callbacks->scte_104(ctx->callback_context, ctx, pkt);
+	vanc_callback(ctx, scte_104, pkt);
 
 	*pp = pkt;
 	return KLAPI_OK;
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* SMPTE 12M-2 ancillary time code. Each of the 16 UDWs carries one nibble of the
+ * 64 bit time code word in bits 4-7, UDW1 holding bits 0-3, and one distributed
+ * binary bit in bit 3. UDW1-8 carry DBB1 and UDW9-16 DBB2, least significant bit first.
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SMPTE_12_2_UDW_COUNT 16
+
+const char *smpte_12_2_dbb1_to_string(unsigned char dbb1)
+{
+	switch (dbb1) {
+	case SMPTE_12_2_DBB1_LTC:   return "LTC";
+	case SMPTE_12_2_DBB1_VITC1: return "VITC1";
+	case SMPTE_12_2_DBB1_VITC2: return "VITC2";
+	case 0x06:                  return "Locally generated time address and user data";
+	case 0x7d:                  return "Video tape data";
+	case 0x7e:                  return "Film data";
+	case 0x7f:                  return "Production data";
+	default:                    return "Reserved";
+	}
+}
+
+int dump_SMPTE_12_2(struct vanc_context_s *ctx, void *p)
+{
+	struct packet_smpte_12_2_s *pkt = p;
+
+	if (ctx->verbose)
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s() %p\n", __func__, (void *)pkt);
+
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " dbb1 = 0x%02x (%s)\n", pkt->dbb1, smpte_12_2_dbb1_to_string(pkt->dbb1));
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " dbb2 = 0x%02x\n", pkt->dbb2);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  vitc_line_select = %d\n", pkt->vitc_line_select);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  line_duplication_flag = %d\n", pkt->line_duplication_flag);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  tc_validity_flag = %d\n", pkt->tc_validity_flag);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  user_bits_process_flag = %d\n", pkt->user_bits_process_flag);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " timecode = %02d:%02d:%02d%c%02d\n",
+		pkt->hours, pkt->minutes, pkt->seconds, pkt->drop_frame_flag ? ';' : ':', pkt->frames);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " drop_frame_flag = %d color_frame_flag = %d\n",
+		pkt->drop_frame_flag, pkt->color_frame_flag);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " flags 27/43/58/59 = %d/%d/%d/%d\n",
+		pkt->flag27, pkt->flag43, pkt->flag58, pkt->flag59);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " binary_groups = %x %x %x %x %x %x %x %x\n",
+		pkt->binary_group[0], pkt->binary_group[1], pkt->binary_group[2], pkt->binary_group[3],
+		pkt->binary_group[4], pkt->binary_group[5], pkt->binary_group[6], pkt->binary_group[7]);
+
+	return KLAPI_OK;
+}
+
+/* Which ATC packet supplies the frame timecode, when a frame carries several. Higher wins. */
+static int timecodePriority(unsigned char dbb1)
+{
+	switch (dbb1) {
+	case SMPTE_12_2_DBB1_LTC:   return 3;
+	case SMPTE_12_2_DBB1_VITC1: return 2;
+	case SMPTE_12_2_DBB1_VITC2: return 1;
+	default:                    return 0;
+	}
+}
+
+static void update_timecode(struct vanc_context_private_s *priv, const struct packet_smpte_12_2_s *pkt)
+{
+	struct vanc_timecode_s *tc = &priv->timecode;
+
+	int priority = timecodePriority(pkt->dbb1);
+	if (priority == 0 || pkt->tc_validity_flag)
+		return;
+	if (pkt->hours > 23 || pkt->minutes > 59 || pkt->seconds > 59 || pkt->frames > 59)
+		return;
+
+	/* Within a frame the best source sticks, otherwise the latest packet wins. */
+	if (priv->frame && tc->valid && timecodePriority(tc->source) > priority)
+		return;
+
+	tc->valid = 1;
+	tc->source = pkt->dbb1;
+	tc->hours = pkt->hours;
+	tc->minutes = pkt->minutes;
+	tc->seconds = pkt->seconds;
+	tc->frames = pkt->frames;
+	tc->dropFrame = pkt->drop_frame_flag;
+}
+
+int parse_SMPTE_12_2(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp)
+{
+	if (ctx->verbose)
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s()\n", __func__);
+
+	if (hdr->payloadLengthWords < SMPTE_12_2_UDW_COUNT)
+		return -EINVAL;
+
+	struct packet_smpte_12_2_s *pkt = vanc_packet_decoded_alloc(ctx, sizeof(*pkt), hdr);
+	if (!pkt)
+		return -ENOMEM;
+
+	unsigned char n[SMPTE_12_2_UDW_COUNT];
+	for (int i = 0; i < SMPTE_12_2_UDW_COUNT; i++) {
+		unsigned char w = sanitizeWord(hdr->payload[i]);
+		n[i] = w >> 4;
+		if (i < 8)
+			pkt->dbb1 |= ((w >> 3) & 0x01) << i;
+		else
+			pkt->dbb2 |= ((w >> 3) & 0x01) << (i - 8);
+	}
+
+	pkt->vitc_line_select       = pkt->dbb2 & 0x1f;
+	pkt->line_duplication_flag  = (pkt->dbb2 >> 5) & 0x01;
+	pkt->tc_validity_flag       = (pkt->dbb2 >> 6) & 0x01;
+	pkt->user_bits_process_flag = (pkt->dbb2 >> 7) & 0x01;
+
+	/* Time address nibbles are the even UDWs, counting from zero, binary groups the odd. */
+	pkt->frames           = (n[2] & 0x03) * 10 + (n[0] & 0x0f);
+	pkt->drop_frame_flag  = (n[2] >> 2) & 0x01;
+	pkt->color_frame_flag = (n[2] >> 3) & 0x01;
+	pkt->seconds          = (n[6] & 0x07) * 10 + (n[4] & 0x0f);
+	pkt->flag27           = (n[6] >> 3) & 0x01;
+	pkt->minutes          = (n[10] & 0x07) * 10 + (n[8] & 0x0f);
+	pkt->flag43           = (n[10] >> 3) & 0x01;
+	pkt->hours            = (n[14] & 0x03) * 10 + (n[12] & 0x0f);
+	pkt->flag58           = (n[14] >> 2) & 0x01;
+	pkt->flag59           = (n[14] >> 3) & 0x01;
+
+	for (int i = 0; i < 8; i++)
+		pkt->binary_group[i] = n[(i * 2) + 1];
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	update_timecode(priv, pkt);
+
+	/* This packet is stamped with the timecode it carries, like the ones that follow. */
+	pkt->hdr.timecode = priv->timecode;
+
+	vanc_callback(ctx, smpte_12_2, pkt);
+
+	*pp = pkt;
+	return KLAPI_OK;
+}
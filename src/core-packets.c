@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 
 static int isValidHeader(struct vanc_context_s *ctx, unsigned short *arr, unsigned int len)
 {
@@ -36,114 +37,200 @@ static int isValidHeader(struct vanc_context_s *ctx, unsigned short *arr, unsign
 	}
 
 	if (ctx->verbose > 1)
-		printf("%04x %04x %04x %s\n", *(arr + 0), *(arr + 1), *(arr + 2), ret ? "valid": "invalid");
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%04x %04x %04x %s\n", *(arr + 0), *(arr + 1), *(arr + 2), ret ? "valid": "invalid");
 	return ret;
 }
 
-static struct type_s
-{
-	unsigned short did, sdid;
-	enum packet_type_e type;
-	const char *spec;
-	const char *description;
-	int (*parse)(struct vanc_context_s *, struct packet_header_s *, void **);
-	int (*dump)(struct vanc_context_s *, void *);
-} types[] = {
-	{ 0x40, 0xfe, VANC_TYPE_KL_UINT64_COUNTER, "KLABS", "UINT64 LE Frame Counter", parse_KL_U64LE_COUNTER, dump_KL_U64LE_COUNTER, },
-	{ 0x41, 0x05, VANC_TYPE_PAYLOAD_INFORMATION, "SMPTE 2016-3 AFD", "Payload Information", parse_PAYLOAD_INFORMATION, dump_PAYLOAD_INFORMATION, },
-	{ 0x41, 0x07, VANC_TYPE_SCTE_104, "SMPTE Packet Type 2", "SCTE 104", parse_SCTE_104, dump_SCTE_104, },
-	{ 0x80, 0x07, VANC_TYPE_SCTE_104, "SMPTE Packet Type 1 (Deprecated)", "SCTE 104", parse_SCTE_104, dump_SCTE_104, },
-	{ 0x61, 0x01, VANC_TYPE_EIA_708B, "SMPTE", "EIA_708B", parse_EIA_708B, dump_EIA_708B, },
-	{ 0x61, 0x02, VANC_TYPE_EIA_608, "SMPTE", "EIA_608", parse_EIA_608, dump_EIA_608, },
+static const struct vanc_decoder_s types[] = {
+	{ 0x40, 0xfe, VANC_TYPE_KL_UINT64_COUNTER, "KLABS", "UINT64 LE Frame Counter", parse_KL_U64LE_COUNTER, dump_KL_U64LE_COUNTER, NULL, },
+	{ 0x41, 0x05, VANC_TYPE_PAYLOAD_INFORMATION, "SMPTE 2016-3 AFD", "Payload Information", parse_PAYLOAD_INFORMATION, dump_PAYLOAD_INFORMATION, NULL, },
+	{ 0x41, 0x07, VANC_TYPE_SCTE_104, "SMPTE Packet Type 2", "SCTE 104", parse_SCTE_104, dump_SCTE_104, free_SCTE_104, },
+	{ 0x80, 0x07, VANC_TYPE_SCTE_104, "SMPTE Packet Type 1 (Deprecated)", "SCTE 104", parse_SCTE_104, dump_SCTE_104, free_SCTE_104, },
+	{ 0x61, 0x01, VANC_TYPE_EIA_708B, "SMPTE", "EIA_708B", parse_EIA_708B, dump_EIA_708B, NULL, },
+	{ 0x61, 0x02, VANC_TYPE_EIA_608, "SMPTE", "EIA_608", parse_EIA_608, dump_EIA_608, NULL, },
+	{ 0x60, 0x60, VANC_TYPE_SMPTE_12_2, "S12M-2", "Ancillary Time Code", parse_SMPTE_12_2, dump_SMPTE_12_2, NULL, },
 };
 
-static enum packet_type_e lookupTypeByDID(unsigned short did, unsigned short sdid)
+/* Type to types[] index + 1, built once. */
+static int typeIndex[VANC_TYPE_MAX];
+static pthread_once_t typeIndexOnce = PTHREAD_ONCE_INIT;
+
+static void typeIndexBuild(void)
 {
-	for (int i = 0; i < (sizeof(types) / sizeof(struct type_s)); i++) {
-		if ((types[i].did == did) && (types[i].sdid == sdid))
-			return types[i].type;
-	}
+	for (int i = (sizeof(types) / sizeof(types[0])) - 1; i >= 0; i--)
+		typeIndex[types[i].type] = i + 1;
+}
 
-	return VANC_TYPE_UNDEFINED;
+static const struct vanc_decoder_s *lookupByType(enum packet_type_e type)
+{
+	if (type <= VANC_TYPE_UNDEFINED || type >= VANC_TYPE_MAX)
+		return NULL;
+
+	pthread_once(&typeIndexOnce, typeIndexBuild);
+	return typeIndex[type] ? &types[typeIndex[type] - 1] : NULL;
 }
 
 const char *vanc_lookupDescriptionByType(enum packet_type_e type)
 {
-	for (int i = 0; i < (sizeof(types) / sizeof(struct type_s)); i++) {
-		if (types[i].type == type)
-			return types[i].description;
-	}
+	if (type == VANC_TYPE_USER)
+		return "User Registered";
 
-	return "UNDEFINED";
+	const struct vanc_decoder_s *t = lookupByType(type);
+	return t ? t->description : "UNDEFINED";
 }
 
 const char *vanc_lookupSpecificationByType(enum packet_type_e type)
 {
-	for (int i = 0; i < (sizeof(types) / sizeof(struct type_s)); i++) {
-		if (types[i].type == type)
-			return types[i].spec;
+	if (type == VANC_TYPE_USER)
+		return "User Registered";
+
+	const struct vanc_decoder_s *t = lookupByType(type);
+	return t ? t->spec : "UNDEFINED";
+}
+
+static int addDecoder(struct vanc_context_private_s *priv, const struct vanc_decoder_s *dec)
+{
+	unsigned int key = ((dec->did & 0xff) << 8) | (dec->sdid & 0xff);
+
+	/* Replace any existing decoder for this DID/SDID in place. */
+	uint8_t idx = priv->decoderIndex[key];
+	if (idx == 0) {
+		if (priv->decoderCount == MAX_DECODERS)
+			return -ENOMEM;
+		idx = ++priv->decoderCount;
 	}
 
-	return "UNDEFINED";
+	priv->decoders[idx - 1] = *dec;
+	priv->decoderIndex[key] = idx;
+
+	return KLAPI_OK;
 }
 
+int vanc_decoders_alloc(struct vanc_context_s *ctx)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	priv->decoderIndex = calloc(65536, sizeof(uint8_t));
+	if (!priv->decoderIndex)
+		return -ENOMEM;
+
+	for (int i = 0; i < (sizeof(types) / sizeof(types[0])); i++)
+		addDecoder(priv, &types[i]);
+
+	return KLAPI_OK;
+}
 
-static int parseByType(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp)
+void vanc_decoders_free(struct vanc_context_s *ctx)
 {
-	*pp = 0;
-	for (int i = 0; i < (sizeof(types) / sizeof(struct type_s)); i++) {
-		if ((types[i].type == hdr->type) && (types[i].parse))
-			return types[i].parse(ctx, hdr, pp);
-	}
+	struct vanc_context_private_s *priv = getPrivate(ctx);
 
-	return -EINVAL;
+	free(priv->decoderIndex);
+	priv->decoderIndex = NULL;
+	priv->decoderCount = 0;
 }
 
-static int dumpByType(struct vanc_context_s *ctx, struct packet_header_s *hdr)
+int vanc_register_decoder(struct vanc_context_s *ctx, uint8_t did, uint8_t sdid,
+	int (*parse)(struct vanc_context_s *, struct packet_header_s *, void **),
+	int (*dump)(struct vanc_context_s *, void *),
+	void (*free)(struct vanc_context_s *, void *))
 {
-	for (int i = 0; i < (sizeof(types) / sizeof(struct type_s)); i++) {
-		if ((types[i].type == hdr->type) && (types[i].dump))
-			return types[i].dump(ctx, hdr);
-	}
+	VALIDATE(ctx);
+	VALIDATE(parse);
+
+	struct vanc_decoder_s dec = {
+		.did = did,
+		.sdid = sdid,
+		.type = VANC_TYPE_USER,
+		.spec = klvanc_didLookupSpecification(did, sdid),
+		.description = klvanc_didLookupDescription(did, sdid),
+		.parse = parse,
+		.dump = dump,
+		.free = free,
+	};
+
+	return addDecoder(getPrivate(ctx), &dec);
+}
 
-	return -EINVAL;
+void vanc_packet_decoded_free(struct vanc_context_s *ctx, const struct vanc_decoder_s *dec, void *p)
+{
+	if (dec && dec->free)
+		dec->free(ctx, p);
+	else
+		vanc_free(ctx, p);
 }
 
-static int parse(struct vanc_context_s *ctx, unsigned short *arr, unsigned int len,
-	struct packet_header_s **hdr)
+/* Validate the ADF and header words and describe the packet, without copying anything. */
+static int parse_view(struct vanc_context_s *ctx, unsigned short *arr, unsigned int len,
+	struct packet_view_s *v)
 {
 	if (!isValidHeader(ctx, arr, len)) {
 		return -EINVAL;
 	}
 
-	struct packet_header_s *p = calloc(1, sizeof(struct packet_header_s));
-	if (!p)
-		return -ENOMEM;
+	/* ADF (3) + DID + DBN/SDID + DC + payload + checksum, the whole packet must fit. */
+	unsigned int payloadLengthWords = sanitizeWord(*(arr + 5));
+	if ((6 + payloadLengthWords + 1) > len)
+		return -EINVAL;
 
-	memcpy(&p->raw[0], arr, len * sizeof(unsigned short));
-	p->rawLengthWords = len;
-	p->adf[0] = *(arr + 0);
-	p->adf[1] = *(arr + 1);
-	p->adf[2] = *(arr + 2);
-	p->did = sanitizeWord(*(arr + 3));
-	p->dbnsdid = sanitizeWord(*(arr + 4));
-	if (p->payloadLengthWords > (sizeof(p->payload) / sizeof(unsigned short)))
-		return -ENOMEM;
+	v->words = arr;
+	v->did = sanitizeWord(*(arr + 3));
+	v->dbnsdid = sanitizeWord(*(arr + 4));
+	v->payloadOffset = 6;
+	v->payloadLengthWords = payloadLengthWords;
+	v->checksum = *(arr + 6 + payloadLengthWords);
+	v->checksumValid = vanc_checksum_is_valid(arr + 3,
+		payloadLengthWords + 4 /* payload + header + len + crc */);
+	v->rawLengthWords = 6 + payloadLengthWords + 1;
+	const struct vanc_decoder_s *dec = vanc_decoder_lookup(getPrivate(ctx), v->did, v->dbnsdid);
+	v->type = dec ? dec->type : VANC_TYPE_UNDEFINED;
 
-	p->payloadLengthWords = sanitizeWord(*(arr + 5));
+	return KLAPI_OK;
+}
 
-	int i;
-	for (i = 0; i < p->payloadLengthWords; i++) {
-		p->payload[i] = *(arr + 6 + i);
-	}
-	p->checksum = *(arr + 6 + i);
-	p->checksumValid = vanc_checksum_is_valid(arr + 3,
-		p->payloadLengthWords + 4 /* payload + header + len + crc */);
+/* Copy a view into a caller allocated header, only the words the packet uses. */
+static void view_to_header(struct packet_header_s *p, const struct packet_view_s *v)
+{
+	p->type = v->type;
+	p->adf[0] = *(v->words + 0);
+	p->adf[1] = *(v->words + 1);
+	p->adf[2] = *(v->words + 2);
+	p->did = v->did;
+	p->dbnsdid = v->dbnsdid;
+	p->checksum = v->checksum;
+	p->checksumValid = v->checksumValid;
+	p->lineNr = v->lineNr;
+	p->horizontalOffset = v->horizontalOffset;
+
+	p->payloadLengthWords = v->payloadLengthWords;
+	memcpy(&p->payload[0], vanc_packet_view_payload(v), v->payloadLengthWords * sizeof(unsigned short));
+
+	p->rawLengthWords = v->rawLengthWords;
+	memcpy(&p->raw[0], v->words, v->rawLengthWords * sizeof(unsigned short));
+}
 
-	p->type = lookupTypeByDID(p->did, p->dbnsdid);
+void vanc_packet_header_copy(struct packet_header_s *dst, const struct packet_header_s *src)
+{
+	/* Everything ahead of the payload array, then the fields between payload and raw. */
+	memcpy(dst, src, offsetof(struct packet_header_s, payload));
+	memcpy(&dst->payload[0], &src->payload[0], src->payloadLengthWords * sizeof(unsigned short));
+	dst->payloadLengthWords = src->payloadLengthWords;
+	dst->checksumValid = src->checksumValid;
+	dst->lineNr = src->lineNr;
+	memcpy(&dst->raw[0], &src->raw[0], src->rawLengthWords * sizeof(unsigned short));
+	dst->rawLengthWords = src->rawLengthWords;
+	dst->horizontalOffset = src->horizontalOffset;
+}
 
-	*hdr = p;
-	return KLAPI_OK;
+void *vanc_packet_decoded_alloc(struct vanc_context_s *ctx, size_t size, const struct packet_header_s *hdr)
+{
+	uint8_t *p = vanc_malloc(ctx, size);
+	if (!p)
+		return NULL;
+
+	vanc_packet_header_copy((struct packet_header_s *)p, hdr);
+	memset(p + sizeof(struct packet_header_s), 0, size - sizeof(struct packet_header_s));
+
+	return p;
 }
 
 void vanc_dump_words_console(uint16_t *vanc, int maxlen, unsigned int linenr, int onlyvalid)
@@ -151,108 +238,275 @@ void vanc_dump_words_console(uint16_t *vanc, int maxlen, unsigned int linenr, in
 	if (onlyvalid && (*(vanc + 1) != 0x3ff) && (*(vanc + 2) != 0x3ff))
 		return;
 
-	fprintf(stderr, "LineNr: %03d ADF: [%03x][%03x][%03x] DID: [%03x] DBN/SDID: [%03x] DC: [%03x]\n",
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "LineNr: %03d ADF: [%03x][%03x][%03x] DID: [%03x] DBN/SDID: [%03x] DC: [%03x]\n",
 		linenr, *(vanc + 0), *(vanc + 1), *(vanc + 2), *(vanc + 3),
 		*(vanc + 4), *(vanc + 5));
 
-	fprintf(stderr, "           Desc: %s [SMPTE %s]\n",
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "           Desc: %s [SMPTE %s]\n",
 		klvanc_didLookupDescription(*(vanc + 3) & 0xff, *(vanc + 4) & 0xff),
 		klvanc_didLookupSpecification(*(vanc + 3) & 0xff, *(vanc + 4) & 0xff));
 
-	/* Spec says DC is a maximum number of 255 words */
-	int i, words = *(vanc + 5) & 0xff;
-	fprintf(stderr, "           Data: ");
-	for (i = 6; i < (6 + words); i++) {
-		fprintf(stderr, "[%03x] ", *(vanc + i));
-	}
-	fprintf(stderr, "\n             CS: [%03x]\n", *(vanc + i));
+	/* Spec says DC is a maximum number of 255 words, 6 characters each. */
+	char data[6 * 256];
+	int i, n = 0, words = *(vanc + 5) & 0xff;
+	data[0] = 0;
+	for (i = 6; i < (6 + words); i++)
+		n += snprintf(data + n, sizeof(data) - n, "[%03x] ", *(vanc + i));
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "           Data: %s\n             CS: [%03x]\n", data, *(vanc + i));
 }
 
 void klvanc_dump_packet_console(struct vanc_context_s *ctx, struct packet_header_s *hdr)
 {
-	printf("hdr->type   = %d\n", hdr->type);
-	printf(" ->adf      = 0x%04x/0x%04x/0x%04x\n", hdr->adf[0], hdr->adf[1], hdr->adf[2]);
-	printf(" ->did/sdid = 0x%02x / 0x%02x [%s %s] via SDI line %d\n",
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "hdr->type   = %d\n", hdr->type);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->adf      = 0x%04x/0x%04x/0x%04x\n", hdr->adf[0], hdr->adf[1], hdr->adf[2]);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->did/sdid = 0x%02x / 0x%02x [%s %s] via SDI line %d\n",
 		hdr->did,
 		hdr->dbnsdid,
 		klvanc_didLookupSpecification(hdr->did, hdr->dbnsdid),
 		klvanc_didLookupDescription(hdr->did, hdr->dbnsdid),
 		hdr->lineNr);
-	printf(" ->h_offset = %d\n", hdr->horizontalOffset);
-	printf(" ->checksum = 0x%04x (%s)\n", hdr->checksum, hdr->checksumValid ? "VALID" : "INVALID");
-	printf(" ->payloadLengthWords = %d\n", hdr->payloadLengthWords);
-	printf(" ->payload  = ");
-	for (int i = 0; i < hdr->payloadLengthWords; i++)
-		printf("%02x ", sanitizeWord(hdr->payload[i]));
-	printf("\n");
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->h_offset = %d\n", hdr->horizontalOffset);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->checksum = 0x%04x (%s)\n", hdr->checksum, hdr->checksumValid ? "VALID" : "INVALID");
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->payloadLengthWords = %d\n", hdr->payloadLengthWords);
+
+	char payload[3 * 256];
+	int n = 0;
+	payload[0] = 0;
+	for (int i = 0; i < hdr->payloadLengthWords && n < (int)sizeof(payload); i++)
+		n += snprintf(payload + n, sizeof(payload) - n, "%02x ", sanitizeWord(hdr->payload[i]));
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, " ->payload  = %s\n", payload);
 }
 
-int vanc_packet_parse(struct vanc_context_s *ctx, unsigned int lineNr, unsigned short *arr, unsigned int len)
+/* Count a validated packet, on the thread that delivers it. */
+static void stats_packet(struct vanc_context_private_s *priv, const struct packet_view_s *view)
+{
+	vanc_stat_add(priv->stats.packets, 1);
+	vanc_stat_add(priv->didCounts[(view->did << 8) | view->dbnsdid], 1);
+}
+
+/* Header build, cache, callback and decode for a single validated packet. */
+int vanc_packet_deliver(struct vanc_context_s *ctx, struct packet_view_s *view)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	stats_packet(priv, view);
+
+	if (priv->changeOnly && vanc_change_only_skip(priv, view)) {
+		vanc_stat_add(priv->stats.changeOnlySkipped, 1);
+		return KLAPI_OK;
+	}
+
+	/* Only valid for the duration of the callbacks, decoders take their own copy. */
+	struct packet_header_s *hdr = priv->deliverHdr;
+	view_to_header(hdr, view);
+	hdr->timecode = priv->timecode;
+
+	/* Dump the packet header and basic VANC types if required. */
+	if (ctx->verbose)
+		klvanc_dump_packet_console(ctx, hdr);
+
+	/* Update the internal VANC cache */
+	vanc_cache_update(ctx, hdr);
+
+	vanc_callback(ctx, all, hdr);
+
+	/* formally decode the entire packet, decoders fire their own callbacks, don't charge those to decode. */
+	const struct vanc_decoder_s *dec = vanc_decoder_lookup(priv, hdr->did, hdr->dbnsdid);
+	void *decodedPacket = NULL;
+	int ret = -EINVAL;
+	if (dec) {
+		uint64_t callbackNs = priv->stats.callbackNs;
+		uint64_t start = vanc_stats_clock(priv);
+		ret = dec->parse(ctx, hdr, &decodedPacket);
+		vanc_stat_add(priv->stats.decodeNs, vanc_stats_since(priv, start) - (priv->stats.callbackNs - callbackNs));
+		if (ret < 0)
+			vanc_stat_add(priv->stats.decodeErrors, 1);
+	} else
+		vanc_stat_add(priv->stats.undecoded, 1);
+
+	if (ret == KLAPI_OK) {
+		if (ctx->verbose == 2 && dec->dump && decodedPacket) {
+			ret = dec->dump(ctx, decodedPacket);
+		}
+	} else {
+		if (klrestricted_code_path_block_execute(&ctx->rcp_failedToDecode)) {
+			vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_DECODE, "Failed parsing by type\n");
+			klvanc_dump_packet_console(ctx, hdr);
+		}
+	}
+
+	if (decodedPacket && !vanc_frame_collect(ctx, dec, decodedPacket))
+		vanc_packet_decoded_free(ctx, dec, decodedPacket);
+
+	return KLAPI_OK;
+}
+
+static int deliver_packet(struct vanc_context_s *ctx, void *arg, struct packet_view_s *view)
+{
+	return vanc_packet_deliver(ctx, view);
+}
+
+static int deliver_view(struct vanc_context_s *ctx, void *arg, struct packet_view_s *view)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	stats_packet(priv, view);
+
+	if (priv->changeOnly && vanc_change_only_skip(priv, view)) {
+		vanc_stat_add(priv->stats.changeOnlySkipped, 1);
+		return KLAPI_OK;
+	}
+
+	vanc_callback(ctx, view, view);
+
+	return KLAPI_OK;
+}
+
+/* Find every valid packet in the line and hand each to deliver(), in horizontal order.
+ * Candidate ADFs come from the vectorized scanner in batches, once a packet has
+ * been accepted we resume scanning after its checksum word.
+ */
+#define SCAN_BATCH 64
+int vanc_packet_scan_line(struct vanc_context_s *ctx, unsigned int lineNr, unsigned short *arr, unsigned int len,
+	int (*deliver)(struct vanc_context_s *, void *, struct packet_view_s *), void *arg,
+	struct vanc_stats_s *stats)
 {
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	unsigned int offsets[SCAN_BATCH];
 	int attempts = 0;
+
+	/* A packet is at least 7 words, and isValidHeader() wants more than 7 remaining. */
+	if (len <= 7)
+		return 0;
+
+	if (!vanc_line_wanted(priv, lineNr))
+		return 0;
+
+	vanc_stat_add(stats->linesScanned, 1);
+
+	/* Time spent in deliver() is accounted for by deliver(), not the scan. */
+	uint64_t start = vanc_stats_clock(priv);
+	uint64_t deliverNs = 0;
+
+	unsigned int end = len - 7;
+	unsigned int i = 0;
+	while (i < end) {
+		int count = vanc_adf_scan(arr, i, end, offsets, SCAN_BATCH);
+		if (count == 0)
+			break;
+
+		unsigned int resume = offsets[count - 1] + 1;
+		for (int n = 0; n < count; n++) {
+			unsigned int offset = offsets[n];
+
+			/* Inside a packet we've already accepted. */
+			if (offset < i)
+				continue;
+
+			/* Not subscribed, skip before we spend anything validating or copying it.
+			 * The DID/SDID words are always readable, the scanner stops 7 words short.
+			 */
+			if (!vanc_did_wanted(priv, *(arr + offset + 3), *(arr + offset + 4)))
+				continue;
+
+			struct packet_view_s view;
+			if (parse_view(ctx, arr + offset, len - offset, &view) < 0) {
+				vanc_stat_add(stats->adfFalsePositives, 1);
+				continue;
+			}
+
+			/* Checksum and DID/SDID/DC parity, only fatal in strict mode. */
+			int parityValid = vanc_parity_is_valid(view.words + 3, 3);
+			if (!view.checksumValid)
+				vanc_stat_add(stats->checksumErrors, 1);
+			if (!parityValid)
+				vanc_stat_add(stats->parityErrors, 1);
+			if (priv->strict && (!view.checksumValid || !parityValid))
+				continue;
+
+			view.horizontalOffset = offset;
+			view.lineNr = lineNr;
+
+			/* The number of frames we attempted to parse */
+			attempts++;
+
+			uint64_t deliverStart = vanc_stats_clock(priv);
+			int ret = deliver(ctx, arg, &view);
+			deliverNs += vanc_stats_since(priv, deliverStart);
+			if (ret < 0)
+				return ret;
+
+			i = offset + view.rawLengthWords;
+		}
+
+		if (i < resume)
+			i = resume;
+	}
+
+	vanc_stat_add(stats->scanNs, vanc_stats_since(priv, start) - deliverNs);
+
+	return attempts;
+}
+
+int vanc_packet_parse(struct vanc_context_s *ctx, unsigned int lineNr, unsigned short *arr, unsigned int len)
+{
 	VALIDATE(ctx);
 	VALIDATE(arr);
 	VALIDATE(len);
 
 	if (len > 16384) {
 		/* Safety */
-		fprintf(stderr, "%s() length %d exceeds 16384, ignoring.\n", __func__, len);
+		vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_PARSE, "%s() length %d exceeds 16384, ignoring.\n", __func__, len);
 		return -EINVAL;
 	}
 
-	/* Scan the entire line for vanc frames */
-	unsigned int i = 0;
-	while (i < len - 7) {
-		/* Do a basic header parse */
-		struct packet_header_s *hdr;
-		int ret = parse(ctx, arr + i, len - i, &hdr);
-		if (ret < 0) {
-			i++;
-			continue;
-		}
-
-		hdr->horizontalOffset = i;
-		hdr->lineNr = lineNr;
-
-		/* Dump the packet header and basic VANC types if required. */
-		if (ctx->verbose)
-			klvanc_dump_packet_console(ctx, hdr);
-
-		/* The number of frames we attempted to parse */
-		attempts++;
+	return vanc_packet_scan_line(ctx, lineNr, arr, len, deliver_packet, NULL, &getPrivate(ctx)->stats);
+}
 
-		/* Update the internal VANC cache */
-		vanc_cache_update(ctx, hdr);
+int vanc_packet_parse_views(struct vanc_context_s *ctx, unsigned int lineNr, unsigned short *arr, unsigned int len)
+{
+	VALIDATE(ctx);
+	VALIDATE(arr);
+	VALIDATE(len);
 
-		if (ctx->callbacks && ctx->callbacks->all)
-			ctx->callbacks->all(ctx->callback_context, ctx, hdr);
+	if (len > 16384) {
+		/* Safety */
+		vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_PARSE, "%s() length %d exceeds 16384, ignoring.\n", __func__, len);
+		return -EINVAL;
+	}
 
-		/* formally decode the entire packet */
-		void *decodedPacket;
-		ret = parseByType(ctx, hdr, &decodedPacket);
-		if (ret == KLAPI_OK) {
-			if (ctx->verbose == 2) {
-				ret = dumpByType(ctx, decodedPacket);
-			}
-		} else {
- 			if (klrestricted_code_path_block_execute(&ctx->rcp_failedToDecode)) {
-				fprintf(stderr, "Failed parsing by type\n");
-				klvanc_dump_packet_console(ctx, hdr);
-			 }
-		}
+	return vanc_packet_scan_line(ctx, lineNr, arr, len, deliver_view, NULL, &getPrivate(ctx)->stats);
+}
 
-		if (decodedPacket)
-			free(decodedPacket);
+int vanc_encode_packet(uint8_t did, uint8_t sdid, const uint8_t *src, unsigned int srcByteCount,
+	uint16_t *words, unsigned int wordCount)
+{
+	if (!words || (!src && srcByteCount) || srcByteCount > 255)
+		return -EINVAL;
+	if (wordCount < srcByteCount + 7)
+		return -ENOSPC;
 
-		free(hdr);
+	uint16_t *v = words;
+	*(v++) = 0x000;
+	*(v++) = 0x3ff;
+	*(v++) = 0x3ff;
 
-		/* Minimum packet length is 7, so lets move things
-		 * on a little faster....
-		 */
-		i += 7;
+	/* DID through the last UDW get parity, the checksum is the 9 bit sum of them. */
+	uint16_t sum = 0;
+	uint16_t w;
+	w = vanc_parity_word(did); sum += w; *(v++) = w;
+	w = vanc_parity_word(sdid); sum += w; *(v++) = w;
+	w = vanc_parity_word(srcByteCount); sum += w; *(v++) = w;
+	for (unsigned int i = 0; i < srcByteCount; i++) {
+		w = vanc_parity_word(src[i]);
+		sum += w;
+		*(v++) = w;
 	}
 
-	return attempts;
+	sum &= 0x1ff;
+	*(v++) = sum | ((~sum & 0x100) << 1);
+
+	return v - words;
 }
 
 int vanc_sdi_create_payload(uint8_t sdid, uint8_t did,
@@ -264,52 +518,31 @@ int vanc_sdi_create_payload(uint8_t sdid, uint8_t did,
 		return -1;
 
 	int header_length = 6 + 1; /* Header 6 and checksum footer 1 */
-	uint16_t *arr = calloc(2,
-		srcByteCount
-		+ header_length
-		+ 6 /* Enough room for padding */);
-	uint16_t *v = arr;
-
-	*(v++) = 0x000;
-	*(v++) = 0x3ff;
-	*(v++) = 0x3ff;
-	*(v++) = did;
-	*(v++) = sdid;
-	*(v++) = srcByteCount;
-	for (int i = 0; i < srcByteCount; i++)
-		*(v++) = *(src + i);
-
-	/* Generate Parity
-	 * VANC header 0/3ff/3ff = 3
-	 * sdid/did/count = 3
-	 */
-	for (int i = 3; i < (srcByteCount + 3 + 3); i++) {
-		if (__builtin_parity(arr[i]))
-			arr[i] |= 0x100;
-		else
-			arr[i] |= 0x200;
-	}
+	unsigned int allocated = srcByteCount + header_length + 6 /* Enough room for padding */;
+	uint16_t *arr = calloc(2, allocated);
+	if (!arr)
+		return -1;
 
-	/* Calculate checksum */
-	uint16_t sum = 0;
-	int i;
-	for (i = 3; i < (srcByteCount + 3 + 3); i++) {
-		sum += arr[i];
-		sum &= 0x1ff;
+	int count = vanc_encode_packet(did, sdid, src, srcByteCount, arr, allocated);
+	if (count < 0) {
+		free(arr);
+		return -1;
 	}
-	*(v++) = sum | ((~sum & 0x100) << 1);
+	uint16_t *v = arr + count;
 
 	/* Padding - We need to align for correct conversion to V210, IE,
 	 * we need the output length to be a multiple of 6 words.
 	 * I know, the decklink module should really do this....
 	 * Its here for now.
 	 */
+	int i = srcByteCount + 3 + 3;
 	uint16_t x = ((header_length + srcByteCount + 5) / 6) * 6;
 	for (int j = 0; j < (x - i); j++)
 		*(v++) = 0x040;
  
-	/* Colorspace convert to V210 */
-	/* Let's handle this in the decklink output module */
+	/* Colorspace convert to V210 with klvanc_uyvy16_line_to_v210() or
+	 * klvanc_nv20_line_to_v210() once the line is composed.
+	 */
 
 	*dstWordCount = v - arr - 1;
 	*dst = arr;
@@ -329,3 +562,18 @@ void vanc_packet_free(struct packet_header_s *src)
 	free(src);
 }
 
+int vanc_packet_view_clone(struct packet_header_s **dst, const struct packet_view_s *src)
+{
+	VALIDATE(dst);
+	VALIDATE(src);
+
+	struct packet_header_s *p = calloc(1, sizeof(*p));
+	if (!p)
+		return -ENOMEM;
+
+	view_to_header(p, src);
+
+	*dst = p;
+	return KLAPI_OK;
+}
+
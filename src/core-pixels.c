@@ -28,6 +28,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXELS_X86 1
+#include <immintrin.h>
+#endif
+
 #define av_le2ne32(x) (x)
 
 #define READ_PIXELS(a, b, c)         \
@@ -38,11 +43,19 @@
         *c++ = (val >> 20) & 0x3ff;  \
     } while (0)
 
-void klvanc_v210_planar_unpack_c(const uint32_t * src, uint16_t * y, uint16_t * u, uint16_t * v, int width)
+/* v210 unpacking, one group of four words and six pixels at a time. The _c functions are
+ * the reference, the dispatched ones run the same group loop through SIMD kernels and
+ * finish any partial group with the scalar code.
+ */
+typedef void (*v210_unpack_planar_func)(const uint32_t *src, uint16_t *y, uint16_t *u, uint16_t *v, int groups);
+typedef void (*v210_unpack_nv20_func)(const uint32_t *src, uint16_t *y, uint16_t *uv, int groups);
+typedef void (*v210_unpack_uyvy_func)(const uint32_t *src, uint16_t *dst, int groups);
+
+static void unpack_planar_c(const uint32_t *src, uint16_t *y, uint16_t *u, uint16_t *v, int groups)
 {
 	uint32_t val;
 
-	for (int i = 0; i < width - 5; i += 6) {
+	for (int i = 0; i < groups; i++) {
 		READ_PIXELS(u, y, v);
 		READ_PIXELS(y, u, y);
 		READ_PIXELS(v, y, u);
@@ -50,28 +63,34 @@ void klvanc_v210_planar_unpack_c(const uint32_t * src, uint16_t * y, uint16_t *
 	}
 }
 
-/* Convert v210 to the native HD-SDI pixel format.
- * bmdFormat10BitYUV :‘v210’4:2:2Representation
- * Twelve 10-bit unsigned components are packed into four 32-bit little-endian words.
- * See BlackMagic SDK page 280 for a detailed description.
- */
-int klvanc_v210_line_to_nv20_c(const uint32_t * src, uint16_t * dst, int dstSizeBytes, int width)
+static void unpack_nv20_c(const uint32_t *src, uint16_t *dst, uint16_t *uv, int groups)
 {
-	if (!src || !dst || !width)
-		return -1;
-
-	if (dstSizeBytes < (width * 6))
-		return -1;
+	uint32_t val;
 
-	int w;
-	uint32_t val = 0;
-	uint16_t *uv = dst + width;
-	for (w = 0; w < (width - 5); w += 6) {
+	for (int i = 0; i < groups; i++) {
 		READ_PIXELS(uv, dst, uv);
 		READ_PIXELS(dst, uv, dst);
 		READ_PIXELS(uv, dst, uv);
 		READ_PIXELS(dst, uv, dst);
 	}
+}
+
+static void unpack_uyvy_c(const uint32_t *src, uint16_t *dst, int groups)
+{
+	uint32_t val;
+
+	for (int i = 0; i < groups; i++) {
+		READ_PIXELS(dst, dst, dst);
+		READ_PIXELS(dst, dst, dst);
+		READ_PIXELS(dst, dst, dst);
+		READ_PIXELS(dst, dst, dst);
+	}
+}
+
+/* The two or four pixels of a partial group, w is the first pixel not yet written. */
+static void unpack_nv20_tail(const uint32_t *src, uint16_t *dst, uint16_t *uv, int w, int width)
+{
+	uint32_t val = 0;
 
 	if (w < width - 1) {
 		READ_PIXELS(uv, dst, uv);
@@ -88,6 +107,30 @@ int klvanc_v210_line_to_nv20_c(const uint32_t * src, uint16_t * dst, int dstSize
 		*uv++ = val & 0x3ff;
 		*dst++ = (val >> 10) & 0x3ff;
 	}
+}
+
+void klvanc_v210_planar_unpack_c(const uint32_t * src, uint16_t * y, uint16_t * u, uint16_t * v, int width)
+{
+	if (width >= 6)
+		unpack_planar_c(src, y, u, v, width / 6);
+}
+
+/* Convert v210 to the native HD-SDI pixel format.
+ * bmdFormat10BitYUV :‘v210’4:2:2Representation
+ * Twelve 10-bit unsigned components are packed into four 32-bit little-endian words.
+ * See BlackMagic SDK page 280 for a detailed description.
+ */
+int klvanc_v210_line_to_nv20_c(const uint32_t * src, uint16_t * dst, int dstSizeBytes, int width)
+{
+	if (!src || !dst || !width)
+		return -1;
+
+	if (dstSizeBytes < (width * 6))
+		return -1;
+
+	int groups = width >= 6 ? width / 6 : 0;
+	unpack_nv20_c(src, dst, dst + width, groups);
+	unpack_nv20_tail(src + (groups * 4), dst + (groups * 6), dst + width + (groups * 6), groups * 6, width);
 
 	return 0;
 }
@@ -113,11 +156,759 @@ XXnn nnnn  nnnn bbbb  bbbb bbaa  aaaa aaaa
 */
 void klvanc_v210_line_to_uyvy_c(uint32_t * src, uint16_t * dst, int width)
 {
-	uint32_t val;
-	for (int i = 0; i < width; i += 6) {
-		READ_PIXELS(dst, dst, dst);
-		READ_PIXELS(dst, dst, dst);
-		READ_PIXELS(dst, dst, dst);
-		READ_PIXELS(dst, dst, dst);
+	if (width > 0)
+		unpack_uyvy_c(src, dst, (width + 5) / 6);
+}
+
+#ifdef PIXELS_X86
+/* Each kernel splits the words of a group into their first two samples, as 16 bit pairs
+ * in ab, and the third in the low half of c. Per format a pair of pshufb gathers then
+ * puts the samples in place, a 128 bit lane per group, and the lanes are stored with
+ * overlapping writes so nothing lands beyond the group.
+ */
+#define Z 0x80
+
+/* Samples 0-7 and 4-11 of the group, in wire order */
+static const uint8_t uyvy_ab0[16] = { 0, 1, 2, 3, Z, Z, 4, 5, 6, 7, Z, Z, 8, 9, 10, 11 };
+static const uint8_t uyvy_c0[16]  = { Z, Z, Z, Z, 0, 1, Z, Z, Z, Z, 4, 5, Z, Z, Z, Z };
+static const uint8_t uyvy_ab1[16] = { 6, 7, Z, Z, 8, 9, 10, 11, Z, Z, 12, 13, 14, 15, Z, Z };
+static const uint8_t uyvy_c1[16]  = { Z, Z, 4, 5, Z, Z, Z, Z, 8, 9, Z, Z, Z, Z, 12, 13 };
+
+/* Y0-Y5 */
+static const uint8_t luma_ab[16]  = { 2, 3, 4, 5, Z, Z, 10, 11, 12, 13, Z, Z, Z, Z, Z, Z };
+static const uint8_t luma_c[16]   = { Z, Z, Z, Z, 4, 5, Z, Z, Z, Z, 12, 13, Z, Z, Z, Z };
+
+/* Cb0 Cr0 Cb2 Cr2 Cb4 Cr4 */
+static const uint8_t chroma_ab[16] = { 0, 1, Z, Z, 6, 7, 8, 9, Z, Z, 14, 15, Z, Z, Z, Z };
+static const uint8_t chroma_c[16]  = { Z, Z, 0, 1, Z, Z, Z, Z, 8, 9, Z, Z, Z, Z, Z, Z };
+
+/* Cb0 Cb2 Cb4 in samples 0-2, Cr0 Cr2 Cr4 in 4-6 */
+static const uint8_t planar_ab[16] = { 0, 1, 6, 7, Z, Z, Z, Z, Z, Z, 8, 9, 14, 15, Z, Z };
+static const uint8_t planar_c[16]  = { Z, Z, Z, Z, 8, 9, Z, Z, 0, 1, Z, Z, Z, Z, Z, Z };
+
+#undef Z
+
+#define SHUF_LOAD128(m) _mm_loadu_si128((const __m128i *)(m))
+
+__attribute__((target("sse2")))
+static inline void store32(uint16_t *p, __m128i v)
+{
+	int32_t x = _mm_cvtsi128_si32(v);
+	memcpy(p, &x, sizeof(x));
+}
+
+__attribute__((target("sse2")))
+static inline void store_uyvy(uint16_t *dst, __m128i s0, __m128i s4)
+{
+	_mm_storeu_si128((__m128i *)(dst + 0), s0);
+	_mm_storeu_si128((__m128i *)(dst + 4), s4);
+}
+
+__attribute__((target("sse2")))
+static inline void store6(uint16_t *dst, __m128i s)
+{
+	_mm_storel_epi64((__m128i *)(dst + 0), s);
+	_mm_storel_epi64((__m128i *)(dst + 2), _mm_srli_si128(s, 4));
+}
+
+__attribute__((target("sse2")))
+static inline void store_planar_chroma(uint16_t *u, uint16_t *v, __m128i s)
+{
+	store32(u + 0, s);
+	store32(u + 1, _mm_srli_si128(s, 2));
+	store32(v + 0, _mm_srli_si128(s, 8));
+	store32(v + 1, _mm_srli_si128(s, 10));
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i gather_ssse3(__m128i ab, __m128i c, const uint8_t *mab, const uint8_t *mc)
+{
+	return _mm_or_si128(_mm_shuffle_epi8(ab, SHUF_LOAD128(mab)), _mm_shuffle_epi8(c, SHUF_LOAD128(mc)));
+}
+
+__attribute__((target("ssse3")))
+static inline void split_ssse3(const uint32_t *src, __m128i *ab, __m128i *c)
+{
+	const __m128i mask = _mm_set1_epi32(0x3ff);
+	__m128i v = _mm_loadu_si128((const __m128i *)src);
+
+	__m128i a = _mm_and_si128(v, mask);
+	__m128i b = _mm_and_si128(_mm_srli_epi32(v, 10), mask);
+	*ab = _mm_or_si128(a, _mm_slli_epi32(b, 16));
+	*c = _mm_and_si128(_mm_srli_epi32(v, 20), mask);
+}
+
+__attribute__((target("ssse3")))
+static void unpack_planar_ssse3(const uint32_t *src, uint16_t *y, uint16_t *u, uint16_t *v, int groups)
+{
+	__m128i ab, c;
+
+	for (int i = 0; i < groups; i++, src += 4, y += 6, u += 3, v += 3) {
+		split_ssse3(src, &ab, &c);
+		store6(y, gather_ssse3(ab, c, luma_ab, luma_c));
+		store_planar_chroma(u, v, gather_ssse3(ab, c, planar_ab, planar_c));
+	}
+}
+
+__attribute__((target("ssse3")))
+static void unpack_nv20_ssse3(const uint32_t *src, uint16_t *y, uint16_t *uv, int groups)
+{
+	__m128i ab, c;
+
+	for (int i = 0; i < groups; i++, src += 4, y += 6, uv += 6) {
+		split_ssse3(src, &ab, &c);
+		store6(y, gather_ssse3(ab, c, luma_ab, luma_c));
+		store6(uv, gather_ssse3(ab, c, chroma_ab, chroma_c));
+	}
+}
+
+__attribute__((target("ssse3")))
+static void unpack_uyvy_ssse3(const uint32_t *src, uint16_t *dst, int groups)
+{
+	__m128i ab, c;
+
+	for (int i = 0; i < groups; i++, src += 4, dst += 12) {
+		split_ssse3(src, &ab, &c);
+		store_uyvy(dst, gather_ssse3(ab, c, uyvy_ab0, uyvy_c0), gather_ssse3(ab, c, uyvy_ab1, uyvy_c1));
+	}
+}
+
+/* Two groups at a time. */
+__attribute__((target("avx2")))
+static inline __m256i gather_avx2(__m256i ab, __m256i c, const uint8_t *mab, const uint8_t *mc)
+{
+	return _mm256_or_si256(_mm256_shuffle_epi8(ab, _mm256_broadcastsi128_si256(SHUF_LOAD128(mab))),
+		_mm256_shuffle_epi8(c, _mm256_broadcastsi128_si256(SHUF_LOAD128(mc))));
+}
+
+__attribute__((target("avx2")))
+static inline void split_avx2(const uint32_t *src, __m256i *ab, __m256i *c)
+{
+	const __m256i mask = _mm256_set1_epi32(0x3ff);
+	__m256i v = _mm256_loadu_si256((const __m256i *)src);
+
+	__m256i a = _mm256_and_si256(v, mask);
+	__m256i b = _mm256_and_si256(_mm256_srli_epi32(v, 10), mask);
+	*ab = _mm256_or_si256(a, _mm256_slli_epi32(b, 16));
+	*c = _mm256_and_si256(_mm256_srli_epi32(v, 20), mask);
+}
+
+#define LANE256(x, n) ((n) ? _mm256_extracti128_si256((x), 1) : _mm256_castsi256_si128(x))
+
+__attribute__((target("avx2")))
+static void unpack_planar_avx2(const uint32_t *src, uint16_t *y, uint16_t *u, uint16_t *v, int groups)
+{
+	__m256i ab, c;
+	int i = 0;
+
+	for (; i + 2 <= groups; i += 2, src += 8, y += 12, u += 6, v += 6) {
+		split_avx2(src, &ab, &c);
+		__m256i l = gather_avx2(ab, c, luma_ab, luma_c);
+		__m256i p = gather_avx2(ab, c, planar_ab, planar_c);
+		store6(y + 0, LANE256(l, 0));
+		store6(y + 6, LANE256(l, 1));
+		store_planar_chroma(u + 0, v + 0, LANE256(p, 0));
+		store_planar_chroma(u + 3, v + 3, LANE256(p, 1));
+	}
+
+	if (i < groups)
+		unpack_planar_ssse3(src, y, u, v, groups - i);
+}
+
+__attribute__((target("avx2")))
+static void unpack_nv20_avx2(const uint32_t *src, uint16_t *y, uint16_t *uv, int groups)
+{
+	__m256i ab, c;
+	int i = 0;
+
+	for (; i + 2 <= groups; i += 2, src += 8, y += 12, uv += 12) {
+		split_avx2(src, &ab, &c);
+		__m256i l = gather_avx2(ab, c, luma_ab, luma_c);
+		__m256i ch = gather_avx2(ab, c, chroma_ab, chroma_c);
+		store6(y + 0, LANE256(l, 0));
+		store6(y + 6, LANE256(l, 1));
+		store6(uv + 0, LANE256(ch, 0));
+		store6(uv + 6, LANE256(ch, 1));
+	}
+
+	if (i < groups)
+		unpack_nv20_ssse3(src, y, uv, groups - i);
+}
+
+__attribute__((target("avx2")))
+static void unpack_uyvy_avx2(const uint32_t *src, uint16_t *dst, int groups)
+{
+	__m256i ab, c;
+	int i = 0;
+
+	for (; i + 2 <= groups; i += 2, src += 8, dst += 24) {
+		split_avx2(src, &ab, &c);
+		__m256i s0 = gather_avx2(ab, c, uyvy_ab0, uyvy_c0);
+		__m256i s4 = gather_avx2(ab, c, uyvy_ab1, uyvy_c1);
+		store_uyvy(dst + 0, LANE256(s0, 0), LANE256(s4, 0));
+		store_uyvy(dst + 12, LANE256(s0, 1), LANE256(s4, 1));
+	}
+
+	if (i < groups)
+		unpack_uyvy_ssse3(src, dst, groups - i);
+}
+
+/* Four groups at a time, pshufb on 512 bit registers needs AVX-512BW. */
+#define AVX512_TARGET __attribute__((target("avx512f,avx512bw")))
+
+AVX512_TARGET
+static inline __m512i gather_avx512(__m512i ab, __m512i c, const uint8_t *mab, const uint8_t *mc)
+{
+	return _mm512_or_si512(_mm512_shuffle_epi8(ab, _mm512_broadcast_i32x4(SHUF_LOAD128(mab))),
+		_mm512_shuffle_epi8(c, _mm512_broadcast_i32x4(SHUF_LOAD128(mc))));
+}
+
+AVX512_TARGET
+static inline void split_avx512(const uint32_t *src, __m512i *ab, __m512i *c)
+{
+	const __m512i mask = _mm512_set1_epi32(0x3ff);
+	__m512i v = _mm512_loadu_si512((const void *)src);
+
+	__m512i a = _mm512_and_si512(v, mask);
+	__m512i b = _mm512_and_si512(_mm512_srli_epi32(v, 10), mask);
+	*ab = _mm512_or_si512(a, _mm512_slli_epi32(b, 16));
+	*c = _mm512_and_si512(_mm512_srli_epi32(v, 20), mask);
+}
+
+#define LANE512(x, n) _mm512_extracti32x4_epi32((x), (n))
+
+AVX512_TARGET
+static void unpack_planar_avx512(const uint32_t *src, uint16_t *y, uint16_t *u, uint16_t *v, int groups)
+{
+	__m512i ab, c;
+	int i = 0;
+
+	for (; i + 4 <= groups; i += 4, src += 16, y += 24, u += 12, v += 12) {
+		split_avx512(src, &ab, &c);
+		__m512i l = gather_avx512(ab, c, luma_ab, luma_c);
+		__m512i p = gather_avx512(ab, c, planar_ab, planar_c);
+		store6(y + 0, LANE512(l, 0));
+		store6(y + 6, LANE512(l, 1));
+		store6(y + 12, LANE512(l, 2));
+		store6(y + 18, LANE512(l, 3));
+		store_planar_chroma(u + 0, v + 0, LANE512(p, 0));
+		store_planar_chroma(u + 3, v + 3, LANE512(p, 1));
+		store_planar_chroma(u + 6, v + 6, LANE512(p, 2));
+		store_planar_chroma(u + 9, v + 9, LANE512(p, 3));
+	}
+
+	if (i < groups)
+		unpack_planar_avx2(src, y, u, v, groups - i);
+}
+
+AVX512_TARGET
+static void unpack_nv20_avx512(const uint32_t *src, uint16_t *y, uint16_t *uv, int groups)
+{
+	__m512i ab, c;
+	int i = 0;
+
+	for (; i + 4 <= groups; i += 4, src += 16, y += 24, uv += 24) {
+		split_avx512(src, &ab, &c);
+		__m512i l = gather_avx512(ab, c, luma_ab, luma_c);
+		__m512i ch = gather_avx512(ab, c, chroma_ab, chroma_c);
+		store6(y + 0, LANE512(l, 0));
+		store6(y + 6, LANE512(l, 1));
+		store6(y + 12, LANE512(l, 2));
+		store6(y + 18, LANE512(l, 3));
+		store6(uv + 0, LANE512(ch, 0));
+		store6(uv + 6, LANE512(ch, 1));
+		store6(uv + 12, LANE512(ch, 2));
+		store6(uv + 18, LANE512(ch, 3));
 	}
+
+	if (i < groups)
+		unpack_nv20_avx2(src, y, uv, groups - i);
+}
+
+AVX512_TARGET
+static void unpack_uyvy_avx512(const uint32_t *src, uint16_t *dst, int groups)
+{
+	__m512i ab, c;
+	int i = 0;
+
+	for (; i + 4 <= groups; i += 4, src += 16, dst += 48) {
+		split_avx512(src, &ab, &c);
+		__m512i s0 = gather_avx512(ab, c, uyvy_ab0, uyvy_c0);
+		__m512i s4 = gather_avx512(ab, c, uyvy_ab1, uyvy_c1);
+		store_uyvy(dst + 0, LANE512(s0, 0), LANE512(s4, 0));
+		store_uyvy(dst + 12, LANE512(s0, 1), LANE512(s4, 1));
+		store_uyvy(dst + 24, LANE512(s0, 2), LANE512(s4, 2));
+		store_uyvy(dst + 36, LANE512(s0, 3), LANE512(s4, 3));
+	}
+
+	if (i < groups)
+		unpack_uyvy_avx2(src, dst, groups - i);
+}
+#endif
+
+/* v210 packing. In UYVY order the twelve samples of a group are already in wire order,
+ * each 32 bit word takes three consecutive samples: s0 | s1 << 10 | s2 << 20.
+ * The SIMD versions work on whole groups, the scalar code finishes the tail.
+ */
+#define V210_BLACK_Y 0x040
+#define V210_BLACK_C 0x200
+
+typedef void (*v210_pack_uyvy_func)(const uint16_t *src, uint32_t *dst, int groups);
+typedef void (*v210_pack_nv20_func)(const uint16_t *y, const uint16_t *uv, uint32_t *dst, int groups);
+
+static inline void pack_group(const uint16_t *s, uint32_t *dst)
+{
+	for (int i = 0; i < 4; i++, s += 3)
+		*dst++ = av_le2ne32((s[0] & 0x3ff) | (s[1] & 0x3ff) << 10 | (uint32_t)(s[2] & 0x3ff) << 20);
+}
+
+void vanc_v210_pack_group(const uint16_t *samples, uint32_t *dst)
+{
+	pack_group(samples, dst);
+}
+
+static void pack_uyvy_c(const uint16_t *src, uint32_t *dst, int groups)
+{
+	for (int i = 0; i < groups; i++, src += 12, dst += 4)
+		pack_group(src, dst);
+}
+
+static void pack_nv20_c(const uint16_t *y, const uint16_t *uv, uint32_t *dst, int groups)
+{
+	uint16_t s[12];
+
+	for (int i = 0; i < groups; i++, y += 6, uv += 6, dst += 4) {
+		for (int j = 0; j < 6; j++) {
+			s[(j * 2) + 0] = uv[j];
+			s[(j * 2) + 1] = y[j];
+		}
+		pack_group(s, dst);
+	}
+}
+
+/* The last, partial, group of a line. pixels is 1 - 5. */
+static void pack_uyvy_tail(const uint16_t *src, uint32_t *dst, int pixels)
+{
+	uint16_t s[12];
+
+	for (int j = 0; j < 6; j++) {
+		s[(j * 2) + 0] = j < pixels ? src[(j * 2) + 0] : V210_BLACK_C;
+		s[(j * 2) + 1] = j < pixels ? src[(j * 2) + 1] : V210_BLACK_Y;
+	}
+	pack_group(s, dst);
+}
+
+static void pack_nv20_tail(const uint16_t *y, const uint16_t *uv, uint32_t *dst, int pixels)
+{
+	uint16_t s[12];
+
+	for (int j = 0; j < 6; j++) {
+		s[(j * 2) + 0] = j < pixels ? uv[j] : V210_BLACK_C;
+		s[(j * 2) + 1] = j < pixels ? y[j] : V210_BLACK_Y;
+	}
+	pack_group(s, dst);
+}
+
+#ifdef PIXELS_X86
+/* lo holds samples 0-7 of a group and hi samples 4-11. Gather the first two samples of
+ * each word into 16 bit pairs, pmaddwd folds them into s0 + (s1 << 10), the third is
+ * gathered into its own 32 bit lane and shifted up.
+ */
+#define PACK_SHUFFLES(set) \
+	const __m##set pairs_lo = SHUF_CONST(0, 1, 2, 3, 6, 7, 8, 9, 12, 13, 14, 15, -1, -1, -1, -1); \
+	const __m##set pairs_hi = SHUF_CONST(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 10, 11, 12, 13); \
+	const __m##set third_lo = SHUF_CONST(4, 5, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1); \
+	const __m##set third_hi = SHUF_CONST(-1, -1, -1, -1, -1, -1, -1, -1, 8, 9, -1, -1, 14, 15, -1, -1);
+
+__attribute__((target("ssse3")))
+static inline __m128i pack_group_ssse3(__m128i lo, __m128i hi)
+{
+#define SHUF_CONST(...) _mm_setr_epi8(__VA_ARGS__)
+	PACK_SHUFFLES(128i)
+#undef SHUF_CONST
+	const __m128i mask = _mm_set1_epi16(0x3ff);
+	const __m128i mul = _mm_set1_epi32(1 << 26 | 1);	/* 16 bit pairs of 1 and 1024 */
+
+	lo = _mm_and_si128(lo, mask);
+	hi = _mm_and_si128(hi, mask);
+
+	__m128i pairs = _mm_or_si128(_mm_shuffle_epi8(lo, pairs_lo), _mm_shuffle_epi8(hi, pairs_hi));
+	__m128i third = _mm_or_si128(_mm_shuffle_epi8(lo, third_lo), _mm_shuffle_epi8(hi, third_hi));
+
+	return _mm_or_si128(_mm_madd_epi16(pairs, mul), _mm_slli_epi32(third, 20));
+}
+
+__attribute__((target("ssse3")))
+static void pack_uyvy_ssse3(const uint16_t *src, uint32_t *dst, int groups)
+{
+	for (int i = 0; i < groups; i++, src += 12, dst += 4) {
+		__m128i lo = _mm_loadu_si128((const __m128i *)(src + 0));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(src + 4));
+		_mm_storeu_si128((__m128i *)dst, pack_group_ssse3(lo, hi));
+	}
+}
+
+__attribute__((target("ssse3")))
+static void pack_nv20_ssse3(const uint16_t *y, const uint16_t *uv, uint32_t *dst, int groups)
+{
+	for (int i = 0; i < groups; i++, y += 6, uv += 6, dst += 4) {
+		__m128i lo = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(uv + 0)), _mm_loadl_epi64((const __m128i *)(y + 0)));
+		__m128i hi = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(uv + 2)), _mm_loadl_epi64((const __m128i *)(y + 2)));
+		_mm_storeu_si128((__m128i *)dst, pack_group_ssse3(lo, hi));
+	}
+}
+
+/* Two groups at a time, one per 128 bit lane. */
+__attribute__((target("avx2")))
+static inline __m256i pack_group_avx2(__m256i lo, __m256i hi)
+{
+#define SHUF_CONST(...) _mm256_broadcastsi128_si256(_mm_setr_epi8(__VA_ARGS__))
+	PACK_SHUFFLES(256i)
+#undef SHUF_CONST
+	const __m256i mask = _mm256_set1_epi16(0x3ff);
+	const __m256i mul = _mm256_set1_epi32(1 << 26 | 1);
+
+	lo = _mm256_and_si256(lo, mask);
+	hi = _mm256_and_si256(hi, mask);
+
+	__m256i pairs = _mm256_or_si256(_mm256_shuffle_epi8(lo, pairs_lo), _mm256_shuffle_epi8(hi, pairs_hi));
+	__m256i third = _mm256_or_si256(_mm256_shuffle_epi8(lo, third_lo), _mm256_shuffle_epi8(hi, third_hi));
+
+	return _mm256_or_si256(_mm256_madd_epi16(pairs, mul), _mm256_slli_epi32(third, 20));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load_lanes(const uint16_t *a, const uint16_t *b)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)a)),
+		_mm_loadu_si128((const __m128i *)b), 1);
+}
+
+__attribute__((target("avx2")))
+static void pack_uyvy_avx2(const uint16_t *src, uint32_t *dst, int groups)
+{
+	int i = 0;
+	for (; i + 2 <= groups; i += 2, src += 24, dst += 8) {
+		__m256i lo = load_lanes(src + 0, src + 12);
+		__m256i hi = load_lanes(src + 4, src + 16);
+		_mm256_storeu_si256((__m256i *)dst, pack_group_avx2(lo, hi));
+	}
+
+	if (i < groups)
+		pack_uyvy_ssse3(src, dst, groups - i);
+}
+
+__attribute__((target("avx2")))
+static void pack_nv20_avx2(const uint16_t *y, const uint16_t *uv, uint32_t *dst, int groups)
+{
+	/* The loads run two samples into the following group, so leave the last for SSSE3. */
+	int i = 0;
+	for (; i + 3 <= groups; i += 2, y += 12, uv += 12, dst += 8) {
+		/* Interleave samples 0-7 and 4-11 of both groups in one go. */
+		__m256i c = load_lanes(uv + 0, uv + 6);
+		__m256i l = load_lanes(y + 0, y + 6);
+		__m256i lo = _mm256_unpacklo_epi16(c, l);
+		__m256i hi = _mm256_unpacklo_epi16(_mm256_srli_si256(c, 4), _mm256_srli_si256(l, 4));
+		_mm256_storeu_si256((__m256i *)dst, pack_group_avx2(lo, hi));
+	}
+
+	if (i < groups)
+		pack_nv20_ssse3(y, uv, dst, groups - i);
+}
+#endif
+
+/* Empty line detection. An ADF needs two samples of 0x3fc or above, values legal video
+ * never uses, so the words of a line without ANC have none. The kernels look for the
+ * first word holding such a sample, straight from the packed v210, only then do we work
+ * out where a candidate ADF might start.
+ */
+typedef int (*v210_find_func)(const uint32_t *src, int words);
+
+static inline int word_has_ones(uint32_t w)
+{
+	return ((w & 0x3fc) == 0x3fc) || ((w & (0x3fc << 10)) == (0x3fc << 10)) || ((w & (0x3fc << 20)) == (0x3fc << 20));
+}
+
+static int find_ones_c(const uint32_t *src, int words)
+{
+	for (int i = 0; i < words; i++) {
+		if (word_has_ones(av_le2ne32(src[i])))
+			return i;
+	}
+
+	return -1;
+}
+
+#ifdef PIXELS_X86
+__attribute__((target("sse2")))
+static int find_ones_sse2(const uint32_t *src, int words)
+{
+	const __m128i ma = _mm_set1_epi32(0x3fc);
+	const __m128i mb = _mm_set1_epi32(0x3fc << 10);
+	const __m128i mc = _mm_set1_epi32(0x3fc << 20);
+	int i = 0;
+
+	for (; i + 4 <= words; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i m = _mm_cmpeq_epi32(_mm_and_si128(v, ma), ma);
+		m = _mm_or_si128(m, _mm_cmpeq_epi32(_mm_and_si128(v, mb), mb));
+		m = _mm_or_si128(m, _mm_cmpeq_epi32(_mm_and_si128(v, mc), mc));
+
+		int bits = _mm_movemask_ps(_mm_castsi128_ps(m));
+		if (bits)
+			return i + __builtin_ctz(bits);
+	}
+
+	int ret = find_ones_c(src + i, words - i);
+	return ret < 0 ? ret : i + ret;
+}
+
+__attribute__((target("avx2")))
+static int find_ones_avx2(const uint32_t *src, int words)
+{
+	const __m256i ma = _mm256_set1_epi32(0x3fc);
+	const __m256i mb = _mm256_set1_epi32(0x3fc << 10);
+	const __m256i mc = _mm256_set1_epi32(0x3fc << 20);
+	int i = 0;
+
+	for (; i + 8 <= words; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(v, ma), ma);
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi32(_mm256_and_si256(v, mb), mb));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi32(_mm256_and_si256(v, mc), mc));
+
+		int bits = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+		if (bits)
+			return i + __builtin_ctz(bits);
+	}
+
+	int ret = find_ones_sse2(src + i, words - i);
+	return ret < 0 ? ret : i + ret;
+}
+
+AVX512_TARGET
+static int find_ones_avx512(const uint32_t *src, int words)
+{
+	const __m512i ma = _mm512_set1_epi32(0x3fc);
+	const __m512i mb = _mm512_set1_epi32(0x3fc << 10);
+	const __m512i mc = _mm512_set1_epi32(0x3fc << 20);
+	int i = 0;
+
+	for (; i + 16 <= words; i += 16) {
+		__m512i v = _mm512_loadu_si512((const void *)(src + i));
+		__mmask16 bits = _mm512_cmpeq_epi32_mask(_mm512_and_si512(v, ma), ma) |
+			_mm512_cmpeq_epi32_mask(_mm512_and_si512(v, mb), mb) |
+			_mm512_cmpeq_epi32_mask(_mm512_and_si512(v, mc), mc);
+		if (bits)
+			return i + __builtin_ctz(bits);
+	}
+
+	int ret = find_ones_avx2(src + i, words - i);
+	return ret < 0 ? ret : i + ret;
+}
+#endif
+
+/* Sample k of the nv20 layout, luma 0 - width-1 then chroma, read from the packed words. */
+static inline unsigned int nv20_sample(const uint32_t *src, int width, int k)
+{
+	static const uint8_t lumaWord[6] = { 0, 1, 1, 2, 3, 3 };
+	static const uint8_t lumaShift[6] = { 10, 0, 20, 10, 0, 20 };
+	static const uint8_t chromaWord[6] = { 0, 0, 1, 2, 2, 3 };
+	static const uint8_t chromaShift[6] = { 0, 20, 10, 0, 20, 10 };
+
+	const uint8_t *word = lumaWord, *shift = lumaShift;
+	if (k >= width) {
+		k -= width;
+		word = chromaWord;
+		shift = chromaShift;
+	}
+
+	uint32_t val = av_le2ne32(src[((k / 6) * 4) + word[k % 6]]);
+	return (val >> shift[k % 6]) & 0x3ff;
+}
+
+static int find_adf(v210_find_func find, const uint32_t *src, int width)
+{
+	if (!src || width < 6)
+		return -1;
+
+	width = (width / 6) * 6;
+
+	int hit = find(src, (width / 6) * 4);
+	if (hit < 0)
+		return -1;
+
+	/* Nothing before the group ahead of the hit can start an ADF. Scanning the luma
+	 * through into the chroma keeps this a superset of what vanc_packet_parse() sees.
+	 */
+	int first = ((hit / 4) - 1) * 6;
+	if (first < 0)
+		first = 0;
+
+	for (int stream = 0; stream < 2; stream++) {
+		int end = stream ? (width * 2) - 2 : width;
+		for (int k = first + (stream * width); k < end; k++) {
+			if ((nv20_sample(src, width, k) & 0x3fc) == 0 &&
+			    (nv20_sample(src, width, k + 1) & 0x3fc) == 0x3fc &&
+			    (nv20_sample(src, width, k + 2) & 0x3fc) == 0x3fc)
+				return k;
+		}
+	}
+
+	return -1;
+}
+
+int klvanc_v210_line_find_adf_c(const uint32_t * src, int width)
+{
+	return find_adf(find_ones_c, src, width);
+}
+
+static v210_unpack_planar_func unpack_planar = unpack_planar_c;
+static v210_unpack_nv20_func unpack_nv20 = unpack_nv20_c;
+static v210_unpack_uyvy_func unpack_uyvy = unpack_uyvy_c;
+static v210_pack_uyvy_func pack_uyvy = pack_uyvy_c;
+static v210_pack_nv20_func pack_nv20 = pack_nv20_c;
+static v210_find_func find_ones = find_ones_c;
+static const char *pixels_isa = "c";
+static pthread_once_t pixels_once = PTHREAD_ONCE_INIT;
+
+static void pixels_select(void)
+{
+#ifdef PIXELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512bw")) {
+		unpack_planar = unpack_planar_avx512;
+		unpack_nv20 = unpack_nv20_avx512;
+		unpack_uyvy = unpack_uyvy_avx512;
+		pack_uyvy = pack_uyvy_avx2;
+		pack_nv20 = pack_nv20_avx2;
+		find_ones = find_ones_avx512;
+		pixels_isa = "avx512";
+	} else if (__builtin_cpu_supports("avx2")) {
+		unpack_planar = unpack_planar_avx2;
+		unpack_nv20 = unpack_nv20_avx2;
+		unpack_uyvy = unpack_uyvy_avx2;
+		pack_uyvy = pack_uyvy_avx2;
+		pack_nv20 = pack_nv20_avx2;
+		find_ones = find_ones_avx2;
+		pixels_isa = "avx2";
+	} else if (__builtin_cpu_supports("ssse3")) {
+		unpack_planar = unpack_planar_ssse3;
+		unpack_nv20 = unpack_nv20_ssse3;
+		unpack_uyvy = unpack_uyvy_ssse3;
+		pack_uyvy = pack_uyvy_ssse3;
+		pack_nv20 = pack_nv20_ssse3;
+		find_ones = find_ones_sse2;
+		pixels_isa = "ssse3";
+	}
+#endif
+}
+
+void vanc_pixels_init(void)
+{
+	pthread_once(&pixels_once, pixels_select);
+}
+
+const char *klvanc_pixels_isa(void)
+{
+	vanc_pixels_init();
+
+	return pixels_isa;
+}
+
+void klvanc_v210_planar_unpack(const uint32_t * src, uint16_t * y, uint16_t * u, uint16_t * v, int width)
+{
+	vanc_pixels_init();
+
+	if (width >= 6)
+		unpack_planar(src, y, u, v, width / 6);
+}
+
+int klvanc_v210_line_to_nv20(const uint32_t * src, uint16_t * dst, int dstSizeBytes, int width)
+{
+	if (!src || !dst || !width)
+		return -1;
+
+	if (dstSizeBytes < (width * 6))
+		return -1;
+
+	vanc_pixels_init();
+
+	int groups = width >= 6 ? width / 6 : 0;
+	unpack_nv20(src, dst, dst + width, groups);
+	unpack_nv20_tail(src + (groups * 4), dst + (groups * 6), dst + width + (groups * 6), groups * 6, width);
+
+	return 0;
+}
+
+void klvanc_v210_line_to_uyvy(const uint32_t * src, uint16_t * dst, int width)
+{
+	vanc_pixels_init();
+
+	if (width > 0)
+		unpack_uyvy(src, dst, (width + 5) / 6);
+}
+
+int klvanc_v210_line_find_adf(const uint32_t * src, int width)
+{
+	vanc_pixels_init();
+
+	return find_adf(find_ones, src, width);
+}
+
+static int uyvy16_to_v210(v210_pack_uyvy_func pack, const uint16_t *src, uint32_t *dst, int dstSizeBytes, int width)
+{
+	if (!src || !dst || width <= 0)
+		return -1;
+
+	if (dstSizeBytes < KLVANC_V210_LINE_BYTES(width))
+		return -1;
+
+	int groups = width / 6;
+	pack(src, dst, groups);
+	if (width % 6)
+		pack_uyvy_tail(src + (groups * 12), dst + (groups * 4), width % 6);
+
+	return 0;
+}
+
+static int nv20_to_v210(v210_pack_nv20_func pack, const uint16_t *src, uint32_t *dst, int dstSizeBytes, int width)
+{
+	if (!src || !dst || width <= 0)
+		return -1;
+
+	if (dstSizeBytes < KLVANC_V210_LINE_BYTES(width))
+		return -1;
+
+	const uint16_t *uv = src + width;
+	int groups = width / 6;
+	pack(src, uv, dst, groups);
+	if (width % 6)
+		pack_nv20_tail(src + (groups * 6), uv + (groups * 6), dst + (groups * 4), width % 6);
+
+	return 0;
+}
+
+int klvanc_uyvy16_line_to_v210_c(const uint16_t * src, uint32_t * dst, int dstSizeBytes, int width)
+{
+	return uyvy16_to_v210(pack_uyvy_c, src, dst, dstSizeBytes, width);
+}
+
+int klvanc_nv20_line_to_v210_c(const uint16_t * src, uint32_t * dst, int dstSizeBytes, int width)
+{
+	return nv20_to_v210(pack_nv20_c, src, dst, dstSizeBytes, width);
+}
+
+int klvanc_uyvy16_line_to_v210(const uint16_t * src, uint32_t * dst, int dstSizeBytes, int width)
+{
+	vanc_pixels_init();
+
+	return uyvy16_to_v210(pack_uyvy, src, dst, dstSizeBytes, width);
+}
+
+int klvanc_nv20_line_to_v210(const uint16_t * src, uint32_t * dst, int dstSizeBytes, int width)
+{
+	vanc_pixels_init();
+
+	return nv20_to_v210(pack_nv20, src, dst, dstSizeBytes, width);
 }
@@ -29,6 +29,7 @@
 
 /* We'll have a mutex and a list of items */
 #include <pthread.h>
+#include <time.h>
 #include "xorg-list.h"
 
 #define getPrivate(ctx) ((struct vanc_context_private_s *)ctx->priv)
@@ -36,9 +37,280 @@
 
 #define KLAPI_OK 0
 
+struct vanc_arena_s;
+struct vanc_workers_s;
+struct vanc_eia_608_decoder_s;
+struct vanc_change_only_s;
+
+/* A packet decoder, built in (see core-packets.c) or registered with vanc_register_decoder(). */
+struct vanc_decoder_s
+{
+	unsigned short did, sdid;
+	enum packet_type_e type;
+	const char *spec;
+	const char *description;
+	int (*parse)(struct vanc_context_s *, struct packet_header_s *, void **);
+	int (*dump)(struct vanc_context_s *, void *);
+	void (*free)(struct vanc_context_s *, void *);	/* NULL - the decoded packet is a single allocation */
+};
+
+#define MAX_DECODERS 255
+
+/* Decoded packets of one type, retained for the frame_end callback. */
+struct vanc_frame_collect_s
+{
+	void **packets;
+	const struct vanc_decoder_s **decoders;	/* The decoder that produced each packet, for release. */
+	unsigned int count;
+	unsigned int allocated;
+};
+
+/* A SCTE-104 message being reassembled from multiple packets, see core-packet-scte_104.c */
+#define SCTE_104_REASSEMBLY_SLOTS 4
+#define SCTE_104_REASSEMBLY_TIMEOUT_MS 500
+
+struct vanc_scte_104_reassembly_s
+{
+	int active;
+	unsigned short did, sdid;
+	unsigned short lineNr;		/* Of the first packet */
+	uint64_t startMs;
+	unsigned int len;
+	unsigned char buf[SCTE_104_MESSAGE_MAX];
+};
+
+/* A CDP stream, one per DID/SDID and line, see parse_EIA_708B(). A frame rarely carries
+ * more than one or two, so a handful of slots searched linearly is plenty.
+ */
+#define CDP_STREAMS_MAX 8
+
+struct vanc_cdp_stream_s
+{
+	uint32_t key;			/* (did << 24) | (sdid << 16) | lineNr */
+	unsigned short sequence;
+};
+
+/* Library private state, hung off vanc_context_s->priv */
+struct vanc_context_private_s
+{
+	/* Optional per-frame allocator for decoded packets, see vanc_context_enable_arena(). */
+	struct vanc_arena_s *arena;
+
+	/* Set while vanc_frame_parse() is running. */
+	struct vanc_frame_s *frame;
+	uint64_t frameCount;
+	struct vanc_frame_collect_s collect[VANC_TYPE_MAX];
+
+	/* The header handed to the all callback and the decoders, reused for every packet. */
+	struct packet_header_s *deliverHdr;
+
+	/* Scratch for unpacking v210 frame lines, when not using workers. */
+	unsigned short *unpacked;
+	unsigned int unpackedAllocated;
+
+	/* Optional line parsing thread pool, see vanc_context_enable_workers(). */
+	struct vanc_workers_s *workers;
+
+	/* Optional DID/SDID subscription bitmap, 64K bits indexed by (did << 8) | sdid.
+	 * NULL means every packet is wanted. See vanc_context_subscribe().
+	 */
+	uint64_t *subscriptions;
+	unsigned int lineFirst, lineLast;	/* Both 0 - all lines */
+
+	/* Drop packets with checksum or parity errors, see vanc_context_set_strict(). */
+	int strict;
+
+	/* Optional change only delivery, see vanc_context_set_change_only(). */
+	struct vanc_change_only_s *changeOnly;
+
+	/* Optional CEA-608 caption decoder, see vanc_context_enable_eia_608_decoder(). */
+	struct vanc_eia_608_decoder_s *eia608;
+
+	/* SCTE-104 reassembly, fixed slots allocated with the context. */
+	struct vanc_scte_104_reassembly_s scte104[SCTE_104_REASSEMBLY_SLOTS];
+	unsigned int scte104TimeoutMs;
+
+	/* Timecode of the current frame, stamped into each packet header. See core-packet-smpte_12_2.c */
+	struct vanc_timecode_s timecode;
+
+	/* The last CDP sequence counter seen per stream, for continuity checks in parse_EIA_708B(). */
+	struct vanc_cdp_stream_s cdpStreams[CDP_STREAMS_MAX];
+	unsigned int cdpStreamCount;
+	unsigned int cdpStreamNext;		/* Slot to recycle once all are in use */
+
+	/* Decoder dispatch. decoderIndex is 64K entries indexed by (did << 8) | sdid,
+	 * holding 0 (no decoder) or a decoders[] index + 1.
+	 */
+	uint8_t *decoderIndex;
+	struct vanc_decoder_s decoders[MAX_DECODERS];
+	unsigned int decoderCount;
+
+	/* Parser counters, see vanc_context_get_stats(). didCounts is 64K entries, allocated
+	 * with the context.
+	 */
+	struct vanc_stats_s stats;
+	uint64_t *didCounts;
+	int statsTiming;
+};
+
+static inline const struct vanc_decoder_s *vanc_decoder_lookup(struct vanc_context_private_s *priv,
+	unsigned short did, unsigned short sdid)
+{
+	uint8_t idx = priv->decoderIndex[((did & 0xff) << 8) | (sdid & 0xff)];
+	return idx ? &priv->decoders[idx - 1] : NULL;
+}
+
+static inline int vanc_line_wanted(struct vanc_context_private_s *priv, unsigned int lineNr)
+{
+	if (priv->lineLast == 0)
+		return 1;
+	return (lineNr >= priv->lineFirst) && (lineNr <= priv->lineLast);
+}
+
+static inline int vanc_did_wanted(struct vanc_context_private_s *priv, unsigned short did, unsigned short sdid)
+{
+	if (!priv->subscriptions)
+		return 1;
+	unsigned int idx = ((did & 0xff) << 8) | (sdid & 0xff);
+	return (priv->subscriptions[idx >> 6] >> (idx & 63)) & 1;
+}
+
+/* Counters only ever change on the thread driving the parser, but vanc_context_get_stats()
+ * may read them from any other. A relaxed store is still a plain add, the reader just never
+ * sees half a value.
+ */
+#define vanc_stat_add(counter, n) __atomic_store_n(&(counter), (counter) + (n), __ATOMIC_RELAXED)
+
+/* A monotonic timestamp in ns, or 0 when stats timing is disabled. */
+static inline uint64_t vanc_stats_clock(struct vanc_context_private_s *priv)
+{
+	if (!priv->statsTiming)
+		return 0;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/* Nanoseconds since a vanc_stats_clock() timestamp, 0 if timing was disabled when it was taken. */
+static inline uint64_t vanc_stats_since(struct vanc_context_private_s *priv, uint64_t start)
+{
+	if (!start)
+		return 0;
+	return vanc_stats_clock(priv) - start;
+}
+
+/* Fire an application callback, if registered, charging its time to the callback counter. */
+#define vanc_callback(ctx, name, ...) \
+	do { \
+		if ((ctx)->callbacks && (ctx)->callbacks->name) { \
+			struct vanc_context_private_s *__priv = getPrivate(ctx); \
+			uint64_t __start = vanc_stats_clock(__priv); \
+			(ctx)->callbacks->name((ctx)->callback_context, (ctx), __VA_ARGS__); \
+			vanc_stat_add(__priv->stats.callbackNs, vanc_stats_since(__priv, __start)); \
+		} \
+	} while (0)
+
+/* Bounds checked big endian byte writer. Writes past the end are dropped and flagged
+ * in overflow, so callers can write a whole structure then check once.
+ */
+struct vanc_byte_writer_s
+{
+	uint8_t *buf;
+	unsigned int size;
+	unsigned int pos;
+	int overflow;
+};
+
+static inline void vanc_put8(struct vanc_byte_writer_s *w, uint8_t v)
+{
+	if (w->pos >= w->size) {
+		w->overflow = 1;
+		return;
+	}
+	w->buf[w->pos++] = v;
+}
+
+static inline void vanc_put16(struct vanc_byte_writer_s *w, uint16_t v)
+{
+	vanc_put8(w, v >> 8);
+	vanc_put8(w, v);
+}
+
+static inline void vanc_put32(struct vanc_byte_writer_s *w, uint32_t v)
+{
+	vanc_put16(w, v >> 16);
+	vanc_put16(w, v);
+}
+
+static inline void vanc_put_bytes(struct vanc_byte_writer_s *w, const uint8_t *p, unsigned int len)
+{
+	for (unsigned int i = 0; i < len; i++)
+		vanc_put8(w, p[i]);
+}
+
 #define VALIDATE(ctx) \
  if (!ctx) return -EINVAL;
 
+/* core-arena.c
+ * All decoders allocate their packet structs through these. When the context has an arena
+ * the memory comes from it and vanc_free() is a no-op, otherwise they map to calloc/free.
+ */
+void *vanc_calloc(struct vanc_context_s *ctx, size_t nmemb, size_t size);
+void *vanc_malloc(struct vanc_context_s *ctx, size_t size);
+void  vanc_free(struct vanc_context_s *ctx, void *p);
+void  vanc_arena_free(struct vanc_context_s *ctx);
+
+/* core-scan.c
+ * Collect offsets in [start, end) that look like an ADF, up to maxOffsets of them.
+ * The caller must guarantee arr[end + 1] is readable. Returns the number of offsets found.
+ */
+int vanc_adf_scan(const unsigned short *arr, unsigned int start, unsigned int end,
+	unsigned int *offsets, unsigned int maxOffsets);
+
+/* core-pixels.c
+ * Pack one v210 group, twelve samples in UYVY order, into four words at dst.
+ */
+void vanc_v210_pack_group(const uint16_t *samples, uint32_t *dst);
+
+/* Pick the SIMD pixel kernels for this CPU, once. Called at context creation. */
+void vanc_pixels_init(void);
+
+/* core-frame.c
+ * Called by the parser once a packet has been decoded. Returns 1 if the packet has been
+ * retained for the frame_end callback (and will be released by the frame code), else 0.
+ */
+int  vanc_frame_collect(struct vanc_context_s *ctx, const struct vanc_decoder_s *dec, void *decodedPacket);
+void vanc_frame_free(struct vanc_context_s *ctx);
+
+/* Produce 10bit words for a frame line, unpacking v210 into *buf (grown as needed) if required. */
+int  vanc_frame_line_words(const struct vanc_frame_line_s *line, unsigned short **buf, unsigned int *allocated,
+	unsigned short **words, unsigned int *wordCount);
+
+/* core-workers.c */
+int  vanc_workers_frame_parse(struct vanc_context_s *ctx, struct vanc_frame_s *frame);
+void vanc_workers_free(struct vanc_context_s *ctx);
+
+/* core-packets.c
+ * Build the per context decoder dispatch table, and tear it down.
+ */
+int  vanc_decoders_alloc(struct vanc_context_s *ctx);
+void vanc_decoders_free(struct vanc_context_s *ctx);
+
+/* Release a packet returned by a decoders parse(). */
+void vanc_packet_decoded_free(struct vanc_context_s *ctx, const struct vanc_decoder_s *dec, void *p);
+
+/* Locate and validate every packet in a line, handing each view to deliver(). Thread safe,
+ * provided deliver() is and each thread passes its own stats, only the line and scan
+ * counters are touched. Returns the number of packets found.
+ */
+int  vanc_packet_scan_line(struct vanc_context_s *ctx, unsigned int lineNr, unsigned short *arr, unsigned int len,
+	int (*deliver)(struct vanc_context_s *, void *, struct packet_view_s *), void *arg,
+	struct vanc_stats_s *stats);
+
+/* Build a header for a validated view, update the cache, decode and fire the callbacks. */
+int  vanc_packet_deliver(struct vanc_context_s *ctx, struct packet_view_s *view);
+
 /* core-packet-payload_information.c */
 int dump_PAYLOAD_INFORMATION(struct vanc_context_s *ctx, void *p);
 int parse_PAYLOAD_INFORMATION(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp);
@@ -51,9 +323,20 @@ int parse_EIA_708B(struct vanc_context_s *ctx, struct packet_header_s *hdr, void
 int dump_EIA_608(struct vanc_context_s *ctx, void *p);
 int parse_EIA_608(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp);
 
-/* core-packet-eia_608.c */
+/* core-change.c */
+int vanc_change_only_skip(struct vanc_context_private_s *priv, const struct packet_view_s *view);
+void vanc_change_only_free(struct vanc_context_s *ctx);
+
+/* core-eia_608-decoder.c */
+void vanc_eia_608_decode(struct vanc_context_s *ctx, int field, unsigned char b1, unsigned char b2, int fromCdp);
+
+/* core-packet-scte_104.c */
 int dump_SCTE_104(struct vanc_context_s *ctx, void *p);
 int parse_SCTE_104(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp);
+void free_SCTE_104(struct vanc_context_s *ctx, void *p);
+
+/* core-packet-smpte_12_2.c */
+int parse_SMPTE_12_2(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp);
 
 /* core-packet-kl_u64le_counter.c */
 int dump_KL_U64LE_COUNTER(struct vanc_context_s *ctx, void *p);
@@ -61,6 +344,16 @@ int parse_KL_U64LE_COUNTER(struct vanc_context_s *ctx, struct packet_header_s *h
 
 void klvanc_dump_packet_console(struct vanc_context_s *ctx, struct packet_header_s *hdr);
 
+/* Decoders embed a copy of the header in their packet structs. Copy only the words the
+ * packet actually uses, the payload and raw words past their lengths are left alone.
+ */
+void vanc_packet_header_copy(struct packet_header_s *dst, const struct packet_header_s *src);
+
+/* Allocate a decoded packet struct of size bytes, which must start with its packet_header_s,
+ * and copy hdr into it. Everything but the unused payload and raw words is zeroed.
+ */
+void *vanc_packet_decoded_alloc(struct vanc_context_s *ctx, size_t size, const struct packet_header_s *hdr);
+
 /* We don't expect anything outside of the VANC framework to need toascii
  * call these, so we'll keep them private / internal calls.
  */
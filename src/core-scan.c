@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Locate candidate Ancillary Data Flags (000 3FF 3FF) in a line of words.
+ * Most VANC lines are entirely blanking, so rather than attempting a header parse
+ * at every word we compare 8 (SSE2) or 16 (AVX2) positions at a time, and only hand
+ * back the offsets that look like an ADF: (word0 & ~3) == 0, (word1 & 0x3fc) == 0x3fc
+ * and (word2 & 0x3fc) == 0x3fc. That's a slight superset of the isValidHeader() test,
+ * candidates still go through a full header/length validation by the caller.
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+typedef int (*scan_func)(const unsigned short *arr, unsigned int start, unsigned int end,
+	unsigned int *offsets, unsigned int maxOffsets);
+
+static inline int isCandidate(const unsigned short *arr)
+{
+	return ((*(arr + 0) & 0xfffc) == 0) &&
+		((*(arr + 1) & 0x3fc) == 0x3fc) &&
+		((*(arr + 2) & 0x3fc) == 0x3fc);
+}
+
+static int scan_c(const unsigned short *arr, unsigned int start, unsigned int end,
+	unsigned int *offsets, unsigned int maxOffsets)
+{
+	unsigned int count = 0;
+
+	for (unsigned int i = start; i < end && count < maxOffsets; i++) {
+		if (isCandidate(arr + i))
+			offsets[count++] = i;
+	}
+
+	return count;
+}
+
+#ifdef SCAN_X86
+__attribute__((target("sse2")))
+static int scan_sse2(const unsigned short *arr, unsigned int start, unsigned int end,
+	unsigned int *offsets, unsigned int maxOffsets)
+{
+	const __m128i adf0 = _mm_set1_epi16((short)0xfffc);
+	const __m128i adf1 = _mm_set1_epi16(0x3fc);
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int count = 0;
+	unsigned int i = start;
+
+	for (; i + 8 <= end; i += 8) {
+		__m128i w0 = _mm_loadu_si128((const __m128i *)(arr + i + 0));
+		__m128i w1 = _mm_loadu_si128((const __m128i *)(arr + i + 1));
+		__m128i w2 = _mm_loadu_si128((const __m128i *)(arr + i + 2));
+
+		__m128i m = _mm_cmpeq_epi16(_mm_and_si128(w0, adf0), zero);
+		m = _mm_and_si128(m, _mm_cmpeq_epi16(_mm_and_si128(w1, adf1), adf1));
+		m = _mm_and_si128(m, _mm_cmpeq_epi16(_mm_and_si128(w2, adf1), adf1));
+
+		/* Two mask bits per 16bit lane, keep one. */
+		unsigned int bits = _mm_movemask_epi8(m) & 0x5555;
+		while (bits) {
+			if (count == maxOffsets)
+				return count;
+			offsets[count++] = i + (__builtin_ctz(bits) >> 1);
+			bits &= bits - 1;
+		}
+	}
+
+	if (count < maxOffsets)
+		count += scan_c(arr, i, end, offsets + count, maxOffsets - count);
+
+	return count;
+}
+
+__attribute__((target("avx2")))
+static int scan_avx2(const unsigned short *arr, unsigned int start, unsigned int end,
+	unsigned int *offsets, unsigned int maxOffsets)
+{
+	const __m256i adf0 = _mm256_set1_epi16((short)0xfffc);
+	const __m256i adf1 = _mm256_set1_epi16(0x3fc);
+	const __m256i zero = _mm256_setzero_si256();
+	unsigned int count = 0;
+	unsigned int i = start;
+
+	for (; i + 16 <= end; i += 16) {
+		__m256i w0 = _mm256_loadu_si256((const __m256i *)(arr + i + 0));
+		__m256i w1 = _mm256_loadu_si256((const __m256i *)(arr + i + 1));
+		__m256i w2 = _mm256_loadu_si256((const __m256i *)(arr + i + 2));
+
+		__m256i m = _mm256_cmpeq_epi16(_mm256_and_si256(w0, adf0), zero);
+		m = _mm256_and_si256(m, _mm256_cmpeq_epi16(_mm256_and_si256(w1, adf1), adf1));
+		m = _mm256_and_si256(m, _mm256_cmpeq_epi16(_mm256_and_si256(w2, adf1), adf1));
+
+		unsigned int bits = (unsigned int)_mm256_movemask_epi8(m) & 0x55555555;
+		while (bits) {
+			if (count == maxOffsets)
+				return count;
+			offsets[count++] = i + (__builtin_ctz(bits) >> 1);
+			bits &= bits - 1;
+		}
+	}
+
+	if (count < maxOffsets)
+		count += scan_sse2(arr, i, end, offsets + count, maxOffsets - count);
+
+	return count;
+}
+#endif
+
+static scan_func scanner = scan_c;
+static pthread_once_t scanner_once = PTHREAD_ONCE_INIT;
+
+static void scanner_select(void)
+{
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		scanner = scan_avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		scanner = scan_sse2;
+#endif
+}
+
+int vanc_adf_scan(const unsigned short *arr, unsigned int start, unsigned int end,
+	unsigned int *offsets, unsigned int maxOffsets)
+{
+	if (start >= end || maxOffsets == 0)
+		return 0;
+
+	pthread_once(&scanner_once, scanner_select);
+
+	return scanner(arr, start, end, offsets, maxOffsets);
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* SCTE-104 to SCTE-35 translation, per SCTE 104 section 9 and SCTE 35 section 9.
+ * The section is written straight into the caller's buffer, nothing is allocated.
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* SCTE 35 table 7 */
+#define SPLICE_NULL			0x00
+#define SPLICE_INSERT			0x05
+#define TIME_SIGNAL			0x06
+
+/* SCTE 35 table 16 */
+#define AVAIL_DESCRIPTOR		0x00
+#define DTMF_DESCRIPTOR			0x01
+#define SEGMENTATION_DESCRIPTOR		0x02
+
+#define CUEI_IDENTIFIER			0x43554549
+#define PTS_MASK			0x1ffffffffULL
+
+static uint32_t crcTable[256];
+static pthread_once_t crcTableOnce = PTHREAD_ONCE_INIT;
+
+/* CRC-32/MPEG-2, ISO 13818-1 annex A. */
+static void crcTableCreate(void)
+{
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t c = i << 24;
+		for (int j = 0; j < 8; j++)
+			c = (c & 0x80000000) ? (c << 1) ^ 0x04c11db7 : (c << 1);
+		crcTable[i] = c;
+	}
+}
+
+static uint32_t crc32_mpeg2(const uint8_t *buf, unsigned int len)
+{
+	uint32_t crc = 0xffffffff;
+
+	pthread_once(&crcTableOnce, crcTableCreate);
+	for (unsigned int i = 0; i < len; i++)
+		crc = (crc << 8) ^ crcTable[((crc >> 24) ^ buf[i]) & 0xff];
+
+	return crc;
+}
+
+/* A flag, six reserved bits and a 33 bit value. The layout of splice_time() and break_duration(). */
+static void putFlagged33(struct vanc_byte_writer_s *w, int flag, uint64_t v)
+{
+	vanc_put8(w, (flag ? 0x80 : 0x00) | 0x7e | ((v >> 32) & 0x01));
+	vanc_put32(w, v & 0xffffffff);
+}
+
+/* splice_time(), SCTE 35 table 14. Without a PTS the time isn't specified. */
+static void putSpliceTime(struct vanc_byte_writer_s *w, int64_t pts, unsigned int preRollMs)
+{
+	if (pts == VANC_NOPTS_VALUE)
+		vanc_put8(w, 0x7f);
+	else
+		putFlagged33(w, 1, ((uint64_t)pts + (uint64_t)preRollMs * 90) & PTS_MASK);
+}
+
+/* splice_insert(), SCTE 35 table 10, from SCTE 104 splice_request_data. */
+static int putSpliceInsert(struct vanc_byte_writer_s *w, const struct splice_request_data *d, int64_t pts)
+{
+	int outOfNetwork, immediate;
+
+	switch (d->splice_insert_type) {
+	case SPLICESTART_NORMAL:    outOfNetwork = 1; immediate = 0; break;
+	case SPLICESTART_IMMEDIATE: outOfNetwork = 1; immediate = 1; break;
+	case SPLICEEND_NORMAL:      outOfNetwork = 0; immediate = 0; break;
+	case SPLICEEND_IMMEDIATE:   outOfNetwork = 0; immediate = 1; break;
+	case SPLICE_CANCEL:
+		vanc_put32(w, d->splice_event_id);
+		vanc_put8(w, 0xff);		/* splice_event_cancel_indicator */
+		return KLAPI_OK;
+	default:
+		return -EINVAL;
+	}
+
+	/* A scheduled splice needs a PTS to schedule against, without one splice now. */
+	if (pts == VANC_NOPTS_VALUE)
+		immediate = 1;
+
+	int duration = outOfNetwork && d->brk_duration;
+
+	vanc_put32(w, d->splice_event_id);
+	vanc_put8(w, 0x7f);
+	vanc_put8(w, outOfNetwork << 7 | 1 << 6 /* program_splice_flag */ | duration << 5 | immediate << 4 | 0x0f);
+	if (!immediate)
+		putSpliceTime(w, pts, d->pre_roll_time);
+	if (duration)
+		putFlagged33(w, d->auto_return_flag, (uint64_t)d->brk_duration * 9000);
+	vanc_put16(w, d->unique_program_id);
+	vanc_put8(w, d->avail_num);
+	vanc_put8(w, d->avails_expected);
+
+	return KLAPI_OK;
+}
+
+static void putAvailDescriptors(struct vanc_byte_writer_s *w, const struct scte104_avail_descriptor_request_data *d)
+{
+	for (int i = 0; i < d->num_provider_avails; i++) {
+		const unsigned char *id = d->provider_avail_ids + (i * 4);
+		vanc_put8(w, AVAIL_DESCRIPTOR);
+		vanc_put8(w, 8);
+		vanc_put32(w, CUEI_IDENTIFIER);
+		vanc_put_bytes(w, id, 4);
+	}
+}
+
+static int putDTMFDescriptor(struct vanc_byte_writer_s *w, const struct scte104_dtmf_descriptor_request_data *d)
+{
+	/* dtmf_count is three bits. */
+	if (d->dtmf_length > 7)
+		return -EINVAL;
+
+	vanc_put8(w, DTMF_DESCRIPTOR);
+	vanc_put8(w, 6 + d->dtmf_length);
+	vanc_put32(w, CUEI_IDENTIFIER);
+	vanc_put8(w, d->pre_roll_time);
+	vanc_put8(w, d->dtmf_length << 5 | 0x1f);
+	vanc_put_bytes(w, (const uint8_t *)d->dtmf_char, d->dtmf_length);
+
+	return KLAPI_OK;
+}
+
+/* segmentation_descriptor(), SCTE 35 table 19. Always program level, SCTE 104 has no
+ * component form. duration_extension_frames would need the frame rate, it's dropped.
+ */
+static int putSegmentationDescriptor(struct vanc_byte_writer_s *w, const struct scte104_segmentation_descriptor_request_data *d)
+{
+	int cancel = d->segmentation_event_cancel_indicator ? 1 : 0;
+	int duration = d->duration ? 1 : 0;
+	unsigned int len = 9;
+
+	if (!cancel)
+		len += 1 + (duration ? 5 : 0) + 2 + d->segmentation_upid_length + 3;
+	if (len > 255)
+		return -EINVAL;
+
+	vanc_put8(w, SEGMENTATION_DESCRIPTOR);
+	vanc_put8(w, len);
+	vanc_put32(w, CUEI_IDENTIFIER);
+	vanc_put32(w, d->segmentation_event_id);
+	vanc_put8(w, cancel << 7 | 0x7f);
+	if (cancel)
+		return KLAPI_OK;
+
+	uint8_t flags = 1 << 7 /* program_segmentation_flag */ | duration << 6;
+	if (d->delivery_not_restricted_flag)
+		flags |= 1 << 5 | 0x1f;
+	else
+		flags |= (d->web_delivery_allowed_flag ? 1 : 0) << 4 |
+			(d->no_regional_blackout_flag ? 1 : 0) << 3 |
+			(d->archive_allowed_flag ? 1 : 0) << 2 |
+			(d->device_restrictions & 0x03);
+	vanc_put8(w, flags);
+
+	if (duration) {
+		uint64_t ticks = (uint64_t)d->duration * 90000;
+		vanc_put8(w, ticks >> 32);
+		vanc_put32(w, ticks & 0xffffffff);
+	}
+
+	vanc_put8(w, d->segmentation_upid_type);
+	vanc_put8(w, d->segmentation_upid_length);
+	vanc_put_bytes(w, d->segmentation_upid, d->segmentation_upid_length);
+	vanc_put8(w, d->segmentation_type_id);
+	vanc_put8(w, d->segment_num);
+	vanc_put8(w, d->segments_expected);
+
+	return KLAPI_OK;
+}
+
+static int isCommandOp(unsigned short opID)
+{
+	return opID == MO_SPLICE_REQUEST_DATA || opID == MO_SPLICE_NULL_REQUEST_DATA ||
+		opID == MO_TIME_SIGNAL_REQUEST_DATA;
+}
+
+/* The splice command for a multiple_operation_message, exactly one op provides it. */
+static int putMOMCommand(struct vanc_byte_writer_s *w, struct multiple_operation_message *mom, int64_t pts,
+	uint8_t *type)
+{
+	struct multiple_operation_message_operation *cmd = NULL;
+
+	for (int i = 0; i < mom->num_ops; i++) {
+		if (!isCommandOp(mom->ops[i].opID))
+			continue;
+		if (cmd)
+			return -EINVAL;
+		cmd = &mom->ops[i];
+	}
+	if (!cmd)
+		return -ENOTSUP;
+
+	int ret = scte_104_decode_mom_op(cmd);
+	if (ret < 0)
+		return ret;
+
+	switch (cmd->opID) {
+	case MO_SPLICE_REQUEST_DATA:
+		*type = SPLICE_INSERT;
+		return putSpliceInsert(w, &cmd->sr_data, pts);
+	case MO_TIME_SIGNAL_REQUEST_DATA:
+		*type = TIME_SIGNAL;
+		putSpliceTime(w, pts, cmd->timesignal_data.pre_roll_time);
+		return KLAPI_OK;
+	default:
+		*type = SPLICE_NULL;
+		return KLAPI_OK;
+	}
+}
+
+static int putMOMDescriptors(struct vanc_byte_writer_s *w, struct multiple_operation_message *mom)
+{
+	for (int i = 0; i < mom->num_ops; i++) {
+		struct multiple_operation_message_operation *o = &mom->ops[i];
+
+		switch (o->opID) {
+		case MO_INSERT_DESCRIPTOR_REQUEST_DATA:
+		case MO_INSERT_DTMF_REQUEST_DATA:
+		case MO_INSERT_AVAIL_DESCRIPTOR_REQUEST_DATA:
+		case MO_INSERT_SEGMENTATION_REQUEST_DATA:
+			break;
+		default:
+			/* Commands, or operations with no SCTE-35 representation. */
+			continue;
+		}
+
+		int ret = scte_104_decode_mom_op(o);
+		if (ret < 0)
+			return ret;
+
+		switch (o->opID) {
+		case MO_INSERT_DESCRIPTOR_REQUEST_DATA:
+			vanc_put_bytes(w, o->descriptor_data.descriptor_bytes, o->descriptor_data.descriptor_bytes_length);
+			break;
+		case MO_INSERT_DTMF_REQUEST_DATA:
+			ret = putDTMFDescriptor(w, &o->dtmf_data);
+			break;
+		case MO_INSERT_AVAIL_DESCRIPTOR_REQUEST_DATA:
+			putAvailDescriptors(w, &o->avail_descriptor_data);
+			break;
+		case MO_INSERT_SEGMENTATION_REQUEST_DATA:
+			ret = putSegmentationDescriptor(w, &o->segmentation_data);
+			break;
+		}
+		if (ret < 0)
+			return ret;
+	}
+
+	return KLAPI_OK;
+}
+
+int scte_104_to_scte_35(struct packet_scte_104_s *pkt, int64_t pts, uint8_t *buf, unsigned int bufSize,
+	unsigned int *byteCount)
+{
+	VALIDATE(pkt);
+	VALIDATE(buf);
+	VALIDATE(byteCount);
+
+	if (pkt->so_msg.opID != SO_INIT_REQUEST_DATA && pkt->so_msg.opID != 0xFFFF)
+		return -ENOTSUP;
+
+	if (bufSize > SCTE_35_SECTION_MAX)
+		bufSize = SCTE_35_SECTION_MAX;
+
+	struct vanc_byte_writer_s w = { buf, bufSize, 0, 0 };
+
+	/* splice_info_section(), SCTE 35 table 5 */
+	vanc_put8(&w, 0xfc);				/* table_id */
+	vanc_put16(&w, 0x3000);			/* sap_type 3, section_length follows */
+	vanc_put8(&w, 0);				/* protocol_version */
+	vanc_put8(&w, 0);				/* Not encrypted, pts_adjustment bit 32 */
+	vanc_put32(&w, 0);				/* pts_adjustment */
+	vanc_put8(&w, 0xff);				/* cw_index */
+	vanc_put8(&w, 0xff);				/* tier, splice_command_length follows */
+	vanc_put16(&w, 0xf000);
+	unsigned int cmdTypePos = w.pos;
+	vanc_put8(&w, 0);
+
+	unsigned int cmdPos = w.pos;
+	uint8_t cmdType;
+	int ret;
+	if (pkt->so_msg.opID == SO_INIT_REQUEST_DATA) {
+		cmdType = SPLICE_INSERT;
+		ret = putSpliceInsert(&w, &pkt->sr_data, pts);
+	} else
+		ret = putMOMCommand(&w, &pkt->mo_msg, pts, &cmdType);
+	if (ret < 0)
+		return ret;
+	unsigned int cmdLen = w.pos - cmdPos;
+
+	unsigned int loopPos = w.pos;
+	vanc_put16(&w, 0);
+	if (pkt->so_msg.opID != SO_INIT_REQUEST_DATA) {
+		ret = putMOMDescriptors(&w, &pkt->mo_msg);
+		if (ret < 0)
+			return ret;
+	}
+	unsigned int loopLen = w.pos - loopPos - 2;
+
+	/* Room for the CRC, then patch the lengths. */
+	vanc_put32(&w, 0);
+	if (w.overflow)
+		return -ENOSPC;
+
+	unsigned int sectionLen = w.pos - 3;
+	buf[1] = 0x30 | ((sectionLen >> 8) & 0x0f);
+	buf[2] = sectionLen & 0xff;
+	buf[cmdTypePos - 2] = 0xf0 | ((cmdLen >> 8) & 0x0f);
+	buf[cmdTypePos - 1] = cmdLen & 0xff;
+	buf[cmdTypePos] = cmdType;
+	buf[loopPos] = loopLen >> 8;
+	buf[loopPos + 1] = loopLen & 0xff;
+
+	uint32_t crc = crc32_mpeg2(buf, w.pos - 4);
+	buf[w.pos - 4] = crc >> 24;
+	buf[w.pos - 3] = crc >> 16;
+	buf[w.pos - 2] = crc >> 8;
+	buf[w.pos - 1] = crc;
+
+	*byteCount = w.pos;
+
+	return KLAPI_OK;
+}
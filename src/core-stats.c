@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+/* The parsing thread may be updating the counters as we read them, see vanc_stat_add(). */
+#define SNAPSHOT(field) stats->field = __atomic_load_n(&priv->stats.field, __ATOMIC_RELAXED)
+
+int vanc_context_get_stats(struct vanc_context_s *ctx, struct vanc_stats_s *stats)
+{
+	VALIDATE(ctx);
+	VALIDATE(stats);
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	SNAPSHOT(linesScanned);
+	SNAPSHOT(adfFalsePositives);
+	SNAPSHOT(packets);
+	SNAPSHOT(checksumErrors);
+	SNAPSHOT(parityErrors);
+	SNAPSHOT(decodeErrors);
+	SNAPSHOT(undecoded);
+	SNAPSHOT(changeOnlySkipped);
+	SNAPSHOT(scte104Fragments);
+	SNAPSHOT(scte104Reassembled);
+	SNAPSHOT(scte104Orphaned);
+	SNAPSHOT(unpackNs);
+	SNAPSHOT(scanNs);
+	SNAPSHOT(decodeNs);
+	SNAPSHOT(callbackNs);
+
+	if (stats->didCounts) {
+		for (unsigned int i = 0; i < VANC_STATS_DID_COUNTS; i++)
+			stats->didCounts[i] = __atomic_load_n(&priv->didCounts[i], __ATOMIC_RELAXED);
+	}
+
+	return KLAPI_OK;
+}
+
+int vanc_context_reset_stats(struct vanc_context_s *ctx)
+{
+	VALIDATE(ctx);
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	memset(&priv->stats, 0, sizeof(priv->stats));
+	memset(priv->didCounts, 0, VANC_STATS_DID_COUNTS * sizeof(uint64_t));
+
+	return KLAPI_OK;
+}
+
+int vanc_context_enable_stats_timing(struct vanc_context_s *ctx, int enable)
+{
+	VALIDATE(ctx);
+
+	getPrivate(ctx)->statsTiming = enable ? 1 : 0;
+
+	return KLAPI_OK;
+}
+
+int vanc_context_dump_stats(struct vanc_context_s *ctx)
+{
+	struct vanc_stats_s s;
+
+	/* Without the per DID/SDID counts, if we can't find room for them. */
+	s.didCounts = malloc(VANC_STATS_DID_COUNTS * sizeof(uint64_t));
+
+	int ret = vanc_context_get_stats(ctx, &s);
+	if (ret < 0) {
+		free(s.didCounts);
+		return ret;
+	}
+
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "VANC parser statistics\n");
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  linesScanned      = %" PRIu64 "\n", s.linesScanned);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  adfFalsePositives = %" PRIu64 "\n", s.adfFalsePositives);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  packets           = %" PRIu64 "\n", s.packets);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  checksumErrors    = %" PRIu64 "\n", s.checksumErrors);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  parityErrors      = %" PRIu64 "\n", s.parityErrors);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  decodeErrors      = %" PRIu64 "\n", s.decodeErrors);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  undecoded         = %" PRIu64 "\n", s.undecoded);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  changeOnlySkipped = %" PRIu64 "\n", s.changeOnlySkipped);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  scte104Fragments  = %" PRIu64 "\n", s.scte104Fragments);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  scte104Reassembled= %" PRIu64 "\n", s.scte104Reassembled);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  scte104Orphaned   = %" PRIu64 "\n", s.scte104Orphaned);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  unpackNs          = %" PRIu64 "\n", s.unpackNs);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  scanNs            = %" PRIu64 "\n", s.scanNs);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  decodeNs          = %" PRIu64 "\n", s.decodeNs);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  callbackNs        = %" PRIu64 "\n", s.callbackNs);
+
+	if (!s.didCounts)
+		return KLAPI_OK;
+
+	for (unsigned int i = 0; i < VANC_STATS_DID_COUNTS; i++) {
+		if (s.didCounts[i] == 0)
+			continue;
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  DID 0x%02x SDID 0x%02x = %" PRIu64 " (%s)\n", i >> 8, i & 0xff, s.didCounts[i],
+			klvanc_didLookupDescription(i >> 8, i & 0xff));
+	}
+	free(s.didCounts);
+
+	return KLAPI_OK;
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* A pool of threads that unpack and scan the lines of a frame in parallel.
+ *
+ * The expensive, stateless part of parsing (v210 unpack, ADF search, header and
+ * checksum validation) runs on the workers, each producing a list of packet views
+ * for the line it claimed. The decoders keep state and fire user callbacks
+ * themselves, so decode and delivery stay on the thread that called
+ * vanc_frame_parse(). That thread dispatches lines strictly in order, as soon as
+ * each one completes, and helps with unclaimed lines while it would otherwise wait.
+ */
+
+#include <libklvanc/vanc.h>
+
+#include "core-private.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_WORKERS 64
+
+struct vanc_worker_line_s
+{
+	struct vanc_frame_line_s *line;
+
+	/* Unpacked v210, owned by this slot and reused from frame to frame. */
+	unsigned short *unpacked;
+	unsigned int unpackedAllocated;
+
+	/* Validated packets, pointing into the callers words or into unpacked. */
+	struct packet_view_s *views;
+	unsigned int viewCount;
+	unsigned int viewAllocated;
+
+	/* Line and scan counters for this slot, folded into the context by the dispatcher. */
+	struct vanc_stats_s stats;
+
+	int result;
+	int done;
+};
+
+struct vanc_workers_s
+{
+	struct vanc_context_s *ctx;
+
+	pthread_t threads[MAX_WORKERS];
+	unsigned int threadCount;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work;		/* Signalled when a new frame is available to workers. */
+	pthread_cond_t done;		/* Signalled when any line completes. */
+	int shutdown;
+
+	/* Protected by mutex */
+	struct vanc_worker_line_s *lines;
+	unsigned int lineCount;
+	unsigned int linesAllocated;
+	unsigned int next;		/* Next unclaimed line. */
+};
+
+static int collect_view(struct vanc_context_s *ctx, void *arg, struct packet_view_s *view)
+{
+	struct vanc_worker_line_s *l = arg;
+
+	if (l->viewCount == l->viewAllocated) {
+		unsigned int allocated = l->viewAllocated ? l->viewAllocated * 2 : 8;
+		struct packet_view_s *views = realloc(l->views, allocated * sizeof(*views));
+		if (!views)
+			return -ENOMEM;
+		l->views = views;
+		l->viewAllocated = allocated;
+	}
+
+	l->views[l->viewCount++] = *view;
+
+	return KLAPI_OK;
+}
+
+/* Runs without the pool mutex held, touches nothing but its own line slot. */
+static void process_line(struct vanc_workers_s *w, struct vanc_worker_line_s *l)
+{
+	unsigned short *words;
+	unsigned int wordCount;
+
+	l->viewCount = 0;
+	l->result = KLAPI_OK;
+
+	/* Outside the line range, don't bother unpacking. */
+	if (!vanc_line_wanted(getPrivate(w->ctx), l->line->lineNr))
+		return;
+
+	struct vanc_context_private_s *priv = getPrivate(w->ctx);
+	uint64_t start = vanc_stats_clock(priv);
+	l->result = vanc_frame_line_words(l->line, &l->unpacked, &l->unpackedAllocated, &words, &wordCount);
+	l->stats.unpackNs += vanc_stats_since(priv, start);
+	if (l->result < 0 || !words || !wordCount)
+		return;
+
+	if (wordCount > 16384) {
+		/* Safety, same limit as vanc_packet_parse() */
+		l->result = -EINVAL;
+		return;
+	}
+
+	l->result = vanc_packet_scan_line(w->ctx, l->line->lineNr, words, wordCount, collect_view, l, &l->stats);
+}
+
+/* Called and returns with the mutex held. */
+static int claim_and_process(struct vanc_workers_s *w)
+{
+	if (w->next >= w->lineCount)
+		return 0;
+
+	struct vanc_worker_line_s *l = &w->lines[w->next++];
+
+	pthread_mutex_unlock(&w->mutex);
+	process_line(w, l);
+	pthread_mutex_lock(&w->mutex);
+
+	l->done = 1;
+	pthread_cond_broadcast(&w->done);
+
+	return 1;
+}
+
+static void *worker_thread(void *p)
+{
+	struct vanc_workers_s *w = p;
+
+	pthread_mutex_lock(&w->mutex);
+	while (!w->shutdown) {
+		if (!claim_and_process(w))
+			pthread_cond_wait(&w->work, &w->mutex);
+	}
+	pthread_mutex_unlock(&w->mutex);
+
+	return NULL;
+}
+
+static void workers_stop(struct vanc_workers_s *w)
+{
+	pthread_mutex_lock(&w->mutex);
+	w->shutdown = 1;
+	pthread_cond_broadcast(&w->work);
+	pthread_mutex_unlock(&w->mutex);
+
+	for (unsigned int i = 0; i < w->threadCount; i++)
+		pthread_join(w->threads[i], NULL);
+
+	for (unsigned int i = 0; i < w->linesAllocated; i++) {
+		free(w->lines[i].unpacked);
+		free(w->lines[i].views);
+	}
+	free(w->lines);
+
+	pthread_cond_destroy(&w->done);
+	pthread_cond_destroy(&w->work);
+	pthread_mutex_destroy(&w->mutex);
+	free(w);
+}
+
+void vanc_workers_free(struct vanc_context_s *ctx)
+{
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	if (priv->workers) {
+		workers_stop(priv->workers);
+		priv->workers = NULL;
+	}
+}
+
+int vanc_context_enable_workers(struct vanc_context_s *ctx, unsigned int threadCount)
+{
+	VALIDATE(ctx);
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+
+	/* Not while a frame is in flight. */
+	if (priv->frame)
+		return -EBUSY;
+
+	vanc_workers_free(ctx);
+	if (threadCount == 0)
+		return KLAPI_OK;
+
+	if (threadCount > MAX_WORKERS)
+		threadCount = MAX_WORKERS;
+
+	struct vanc_workers_s *w = calloc(1, sizeof(*w));
+	if (!w)
+		return -ENOMEM;
+
+	w->ctx = ctx;
+	pthread_mutex_init(&w->mutex, NULL);
+	pthread_cond_init(&w->work, NULL);
+	pthread_cond_init(&w->done, NULL);
+
+	for (unsigned int i = 0; i < threadCount; i++) {
+		if (pthread_create(&w->threads[i], NULL, worker_thread, w) != 0) {
+			workers_stop(w);
+			return -ENOMEM;
+		}
+		w->threadCount++;
+	}
+
+	priv->workers = w;
+
+	return KLAPI_OK;
+}
+
+int vanc_workers_frame_parse(struct vanc_context_s *ctx, struct vanc_frame_s *frame)
+{
+	struct vanc_workers_s *w = getPrivate(ctx)->workers;
+	struct vanc_stats_s *stats = &getPrivate(ctx)->stats;
+	int packetCount = 0;
+	int ret = KLAPI_OK;
+
+	pthread_mutex_lock(&w->mutex);
+
+	/* Every line of the previous frame has completed, nobody is touching the slots. */
+	if (frame->lineCount > w->linesAllocated) {
+		struct vanc_worker_line_s *lines = realloc(w->lines, frame->lineCount * sizeof(*lines));
+		if (!lines) {
+			pthread_mutex_unlock(&w->mutex);
+			return -ENOMEM;
+		}
+		memset(lines + w->linesAllocated, 0, (frame->lineCount - w->linesAllocated) * sizeof(*lines));
+		w->lines = lines;
+		w->linesAllocated = frame->lineCount;
+	}
+
+	for (unsigned int i = 0; i < frame->lineCount; i++) {
+		w->lines[i].line = &frame->lines[i];
+		w->lines[i].done = 0;
+		memset(&w->lines[i].stats, 0, sizeof(w->lines[i].stats));
+	}
+	w->lineCount = frame->lineCount;
+	w->next = 0;
+	pthread_cond_broadcast(&w->work);
+
+	/* Dispatch in line order. */
+	for (unsigned int i = 0; i < frame->lineCount; i++) {
+		struct vanc_worker_line_s *l = &w->lines[i];
+
+		while (!l->done) {
+			if (!claim_and_process(w))
+				pthread_cond_wait(&w->done, &w->mutex);
+		}
+
+		vanc_stat_add(stats->linesScanned, l->stats.linesScanned);
+		vanc_stat_add(stats->adfFalsePositives, l->stats.adfFalsePositives);
+		vanc_stat_add(stats->unpackNs, l->stats.unpackNs);
+		vanc_stat_add(stats->scanNs, l->stats.scanNs);
+		vanc_stat_add(stats->checksumErrors, l->stats.checksumErrors);
+		vanc_stat_add(stats->parityErrors, l->stats.parityErrors);
+
+		/* Once errored, keep waiting for the remaining lines but stop delivering. */
+		if (ret < 0)
+			continue;
+		if (l->result < 0) {
+			ret = l->result;
+			continue;
+		}
+
+		pthread_mutex_unlock(&w->mutex);
+		for (unsigned int n = 0; n < l->viewCount; n++) {
+			ret = vanc_packet_deliver(ctx, &l->views[n]);
+			if (ret < 0)
+				break;
+			packetCount++;
+		}
+		pthread_mutex_lock(&w->mutex);
+	}
+
+	w->lineCount = 0;
+	w->next = 0;
+	pthread_mutex_unlock(&w->mutex);
+
+	if (ret < 0)
+		return ret;
+
+	return packetCount;
+}
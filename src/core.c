@@ -31,7 +31,7 @@ int vanc_context_dump(struct vanc_context_s *ctx)
 {
 	VALIDATE(ctx);
 
-	printf("ctx %p\n", (void *)ctx);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "ctx %p\n", (void *)ctx);
 
 	return KLAPI_OK;
 }
@@ -44,6 +44,26 @@ int vanc_context_create(struct vanc_context_s **ctx)
 	if (!p)
 		return -ENOMEM;
 
+	p->priv = calloc(1, sizeof(struct vanc_context_private_s));
+	if (!p->priv) {
+		free(p);
+		return -ENOMEM;
+	}
+
+	getPrivate(p)->deliverHdr = calloc(1, sizeof(struct packet_header_s));
+	getPrivate(p)->didCounts = calloc(VANC_STATS_DID_COUNTS, sizeof(uint64_t));
+	if (!getPrivate(p)->deliverHdr || !getPrivate(p)->didCounts || vanc_decoders_alloc(p) < 0) {
+		free(getPrivate(p)->didCounts);
+		free(getPrivate(p)->deliverHdr);
+		free(p->priv);
+		free(p);
+		return -ENOMEM;
+	}
+
+	getPrivate(p)->scte104TimeoutMs = SCTE_104_REASSEMBLY_TIMEOUT_MS;
+
+	vanc_pixels_init();
+
 	/* If we fail to parse a vanc message, don't report more than one of those per second. */
 	klrestricted_code_path_block_initialize(&p->rcp_failedToDecode, 1, 1, 1000);
 
@@ -57,7 +77,17 @@ int vanc_context_destroy(struct vanc_context_s *ctx)
 {
 	VALIDATE(ctx);
 
+	vanc_workers_free(ctx);
 	vanc_cache_free(ctx);
+	vanc_frame_free(ctx);
+	vanc_arena_free(ctx);
+	vanc_context_enable_eia_608_decoder(ctx, 0);
+	vanc_change_only_free(ctx);
+	vanc_decoders_free(ctx);
+	free(getPrivate(ctx)->subscriptions);
+	free(getPrivate(ctx)->didCounts);
+	free(getPrivate(ctx)->deliverHdr);
+	free(ctx->priv);
 
 	memset(ctx, 0, sizeof(*ctx));
 	free(ctx);
@@ -68,10 +98,74 @@ int vanc_context_destroy(struct vanc_context_s *ctx)
 int vanc_context_enable_cache(struct vanc_context_s *ctx)
 {
 	if (vanc_cache_alloc(ctx) < 0) {
-		fprintf(stderr, "Unable to allocate vanc cache, enough free ram? Will continue.\n");
+		vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_CORE, "Unable to allocate vanc cache, enough free ram? Will continue.\n");
 		return -1;
 	}
 
 	return 0;
 }
 
+
+int vanc_context_subscribe(struct vanc_context_s *ctx, uint8_t did, uint8_t sdid)
+{
+	VALIDATE(ctx);
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	if (!priv->subscriptions) {
+		priv->subscriptions = calloc(65536 / 64, sizeof(uint64_t));
+		if (!priv->subscriptions)
+			return -ENOMEM;
+	}
+
+	unsigned int idx = (did << 8) | sdid;
+	priv->subscriptions[idx >> 6] |= (1ULL << (idx & 63));
+
+	return KLAPI_OK;
+}
+
+int vanc_context_unsubscribe(struct vanc_context_s *ctx, uint8_t did, uint8_t sdid)
+{
+	VALIDATE(ctx);
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	if (!priv->subscriptions)
+		return -EINVAL;
+
+	unsigned int idx = (did << 8) | sdid;
+	priv->subscriptions[idx >> 6] &= ~(1ULL << (idx & 63));
+
+	return KLAPI_OK;
+}
+
+void vanc_context_subscribe_all(struct vanc_context_s *ctx)
+{
+	if (!ctx)
+		return;
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	free(priv->subscriptions);
+	priv->subscriptions = NULL;
+}
+
+int vanc_context_set_line_range(struct vanc_context_s *ctx, unsigned int firstLine, unsigned int lastLine)
+{
+	VALIDATE(ctx);
+
+	if (lastLine && lastLine < firstLine)
+		return -EINVAL;
+
+	struct vanc_context_private_s *priv = getPrivate(ctx);
+	priv->lineFirst = firstLine;
+	priv->lineLast = lastLine;
+
+	return KLAPI_OK;
+}
+
+int vanc_context_set_strict(struct vanc_context_s *ctx, int enable)
+{
+	VALIDATE(ctx);
+
+	getPrivate(ctx)->strict = enable ? 1 : 0;
+
+	return KLAPI_OK;
+}
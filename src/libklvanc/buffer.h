@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016-2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file	buffer.h
+ * @author	Steven Toth <stoth@kernellabs.com>
+ * @copyright	Copyright (c) 2016-2017 Kernel Labs Inc. All Rights Reserved.
+ * @brief	A thread safe pool of recyclable buffers, for 10bit word lines, v210 lines\n
+ *		and other per line scratch memory. Requests are rounded up to a power of two\n
+ *		size class (256 bytes to 64KB), released buffers go back on their class free\n
+ *		list and are handed out again, so steady state operation doesn't touch the heap.\n
+ *		Requests larger than the largest class are served directly from the heap.
+ */
+
+#ifndef _VANC_BUFFER_H
+#define _VANC_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/errno.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VANC_BUFFER_CLASSES 9
+
+/**
+ * @brief	An opaque pool of buffers, see vanc_buffer_pool_create().
+ */
+struct vanc_buffer_pool_s;
+
+/**
+ * @brief	A buffer handed out by vanc_buffer_alloc().
+ */
+struct buffer_s
+{
+	uint8_t		*ptr;		/**< At least the requested number of bytes, 16 byte aligned. */
+	size_t		size;		/**< Capacity in bytes. */
+	size_t		used;		/**< Caller maintained. Reset to 0 on allocation. */
+	unsigned int	nr;		/**< Caller maintained, a line number for example. */
+};
+
+/**
+ * @brief	Pool statistics, see vanc_buffer_pool_get_stats().
+ */
+struct vanc_buffer_pool_stats_s
+{
+	struct {
+		size_t		size;		/**< Capacity of buffers in this class. */
+		uint64_t	requests;	/**< Allocations served by this class. */
+		uint64_t	recycled;	/**< ... of which came from the free list. */
+		unsigned int	allocated;	/**< Buffers that currently exist, in use or free. */
+		unsigned int	inUse;
+		unsigned int	highWater;	/**< Largest inUse value seen. */
+	} classes[VANC_BUFFER_CLASSES];
+	uint64_t	oversizeRequests;	/**< Allocations too large for any class. */
+};
+
+/**
+ * @brief	Create a private pool. Most callers can pass NULL to the other functions\n
+ *		instead, to use the library wide default pool.
+ * @param[out]	struct vanc_buffer_pool_s **pool - Pool.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_buffer_pool_create(struct vanc_buffer_pool_s **pool);
+
+/**
+ * @brief	Destroy a pool created with vanc_buffer_pool_create(), releasing all of its memory.\n
+ *		Any buffers still in use become invalid.
+ * @param[in]	struct vanc_buffer_pool_s *pool - Pool.
+ */
+void vanc_buffer_pool_destroy(struct vanc_buffer_pool_s *pool);
+
+/**
+ * @brief	Take a buffer of at least sizeBytes from a pool. The contents are undefined,\n
+ *		see vanc_buffer_reset().
+ * @param[in]	struct vanc_buffer_pool_s *pool - Pool, or NULL for the default pool.
+ * @param[out]	struct buffer_s **pp - Buffer.
+ * @param[in]	size_t sizeBytes - Minimum capacity required.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_buffer_alloc(struct vanc_buffer_pool_s *pool, struct buffer_s **pp, size_t sizeBytes);
+
+/**
+ * @brief	Return a buffer to the pool it came from.
+ * @param[in]	struct buffer_s *buf - Buffer.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_buffer_free(struct buffer_s *buf);
+
+/**
+ * @brief	Zero the entire capacity of a buffer and set used back to 0.
+ * @param[in]	struct buffer_s *buf - Buffer.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_buffer_reset(struct buffer_s *buf);
+
+/**
+ * @brief	Take a snapshot of pool usage.
+ * @param[in]	struct vanc_buffer_pool_s *pool - Pool, or NULL for the default pool.
+ * @param[out]	struct vanc_buffer_pool_stats_s *stats - Caller allocated.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_buffer_pool_get_stats(struct vanc_buffer_pool_s *pool, struct vanc_buffer_pool_stats_s *stats);
+
+/**
+ * @brief	Print pool usage to the console.
+ * @param[in]	struct vanc_buffer_pool_s *pool - Pool, or NULL for the default pool.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_buffer_pool_dump(struct vanc_buffer_pool_s *pool);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* _VANC_BUFFER_H */
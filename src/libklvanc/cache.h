@@ -45,7 +45,8 @@ struct vanc_cache_s
 {
 	uint32_t       did, sdid;
 	const char    *desc, *spec;
-	struct timeval lastUpdated;
+	struct timeval lastUpdated;	/* Wall clock */
+	uint64_t       lastUpdatedMs;	/* lastUpdated, in milliseconds */
 	int            hasCursor;
 	int            expandUI;
 	uint32_t       activeCount;
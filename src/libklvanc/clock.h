@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file	clock.h
+ * @author	Steven Toth <stoth@kernellabs.com>
+ * @copyright	Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved.
+ * @brief	Library time source. Anything in the library that measures intervals, restricted\n
+ *		code paths, log rate limiting and timeouts, asks vanc_clock_now_ns(). Cache\n
+ *		timestamps are wall clock and don't.\n
+ *		By default that's a coarse monotonic clock, a vDSO read costing a few nanoseconds\n
+ *		with a resolution of a few milliseconds. Applications processing recorded material\n
+ *		can install a stream clock instead, so rate limits follow media time.
+ */
+
+#ifndef _VANC_CLOCK_H
+#define _VANC_CLOCK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief	Application time source, must return monotonically increasing nanoseconds.\n
+ *		Called from any thread that parses or logs.
+ */
+typedef uint64_t (*vanc_clock_callback)(void *userContext);
+
+/**
+ * @brief	Replace the library time source. The configuration is process wide.
+ * @param[in]	vanc_clock_callback cb - Time source, or NULL to restore the monotonic clock.
+ * @param[in]	void *userContext - Passed to cb.
+ */
+void vanc_clock_set_source(vanc_clock_callback cb, void *userContext);
+
+/**
+ * @brief	Current time from the library time source, in nanoseconds.
+ */
+uint64_t vanc_clock_now_ns(void);
+
+/**
+ * @brief	Current time from the library time source, in milliseconds.
+ */
+static __inline__ uint64_t vanc_clock_now_ms(void)
+{
+	return vanc_clock_now_ns() / 1000000;
+}
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* _VANC_CLOCK_H */
@@ -28,11 +28,18 @@
  *          User allocates a small context, context contains max latency.__msfr_align
  *          Users asks whether its permitted to execute the code block, function determines answer.
  *          First occurence is always allowed to execute.
+ *          Each block is a token bucket driven by the library time source (see clock.h),
+ *          a coarse monotonic clock by default, so a check costs a few nanoseconds.
+ *          The header stands alone, without libklvanc linked blocks use the coarse clock.
+ *          Blocks aren't thread safe, give each thread its own or serialize access.
  *
  * USAGE during initialization, allow messages only every 1000ms
  * struct klrestricted_code_path_block_s global_mypathXYZ;
  * klrestricted_code_path_block_initialize(&global_mypathXYZ, <uniqueid>, 1, 1000);
  *
+ * or, allow bursts of up to 20 messages, 5 per second sustained
+ * klrestricted_code_path_block_initialize_rate(&global_mypathXYZ, <uniqueid>, 1, 5, 20);
+ *
  * USAGE during runtime:
  * if (klrestricted_code_path_block_execute(&global_mypathXYZ))
  * {
@@ -45,24 +52,35 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <sys/time.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-struct klrestricted_code_path_block_s
-{
-	int enableChecking;
-	int id;
-	uint64_t minimumIntervalMs;
+/* A weak reference to the library clock, so applications using only this header don't
+ * need libklvanc to link. Only this alias is weak, declaring vanc_clock_now_ns() itself
+ * weak would weaken every call to it in the including file, and a static link would then
+ * leave the clock out.
+ */
+static uint64_t klrcp_clock_now_ns(void) __attribute__((weakref("vanc_clock_now_ns")));
 
-	struct timeval lastExecuteTime;
-	uint64_t countBlockEntered;
-	uint64_t countBlockAvoided;
-};
+static __inline__ uint64_t klrcp_now_ns(void)
+{
+	if (klrcp_clock_now_ns)
+		return klrcp_clock_now_ns();
+
+	struct timespec ts;
+#ifdef CLOCK_MONOTONIC_COARSE
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+	return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
 
-__inline__ int klrcp_timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y)
+static __inline__ int klrcp_timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y)
 {
      /* Perform the carry for the later subtraction by updating y. */
      if (x->tv_usec < y->tv_usec)
@@ -86,36 +104,83 @@ __inline__ int klrcp_timeval_subtract(struct timeval *result, struct timeval *x,
      return x->tv_sec < y->tv_sec;
 }
 
-__inline uint64_t klrcp_timediff_to_msecs(struct timeval *tv)
+static __inline__ uint64_t klrcp_timediff_to_msecs(struct timeval *tv)
 {
         return (tv->tv_sec * 1000) + (tv->tv_usec / 1000);
 }
 
-__inline__ void klrestricted_code_path_block_initialize(struct klrestricted_code_path_block_s *blk, int id,
+struct klrestricted_code_path_block_s
+{
+	int enableChecking;
+	int id;
+	uint64_t minimumIntervalMs;
+
+	/* Token bucket, credit is measured in nanoseconds. It accrues with time up to
+	 * capacityNs and each execution spends intervalNs.
+	 */
+	uint64_t intervalNs;
+	uint64_t capacityNs;
+	uint64_t creditNs;
+	uint64_t lastNs;
+
+	uint64_t countBlockEntered;
+	uint64_t countBlockAvoided;
+};
+
+/**
+ * @brief	Allow up to burst executions back to back, refilling at perSecond executions per second.\n
+ *		A perSecond of 0 disables checking.
+ */
+static __inline__ void klrestricted_code_path_block_initialize_rate(struct klrestricted_code_path_block_s *blk, int id,
+	int enableChecking, unsigned int perSecond, unsigned int burst)
+{
+	memset(blk, 0, sizeof(*blk));
+	blk->id = id;
+	blk->enableChecking = perSecond ? enableChecking : 0;
+	if (perSecond == 0)
+		return;
+	if (burst == 0)
+		burst = 1;
+
+	blk->intervalNs = 1000000000ULL / perSecond;
+	blk->minimumIntervalMs = blk->intervalNs / 1000000;
+	blk->capacityNs = blk->intervalNs * burst;
+	blk->creditNs = blk->capacityNs;
+};
+
+static __inline__ void klrestricted_code_path_block_initialize(struct klrestricted_code_path_block_s *blk, int id,
 	int enableChecking, uint64_t minimumIntervalMs)
 {
 	memset(blk, 0, sizeof(*blk));
 	blk->id = id;
 	blk->enableChecking = enableChecking;
 	blk->minimumIntervalMs = minimumIntervalMs;
+	blk->intervalNs = minimumIntervalMs * 1000000;
+	blk->capacityNs = blk->intervalNs;
+	blk->creditNs = blk->capacityNs;
 };
 
-__inline__ int klrestricted_code_path_block_execute(struct klrestricted_code_path_block_s *blk)
+static __inline__ int klrestricted_code_path_block_execute(struct klrestricted_code_path_block_s *blk)
 {
 	if (blk->enableChecking == 0) {
 		blk->countBlockEntered++;
 		return 1;
 	}
 
-	struct timeval now, diff;
-	gettimeofday(&now, 0);
-	klrcp_timeval_subtract(&diff, &now, &blk->lastExecuteTime);
-	if (klrcp_timediff_to_msecs(&diff) < blk->minimumIntervalMs) {
+	uint64_t now = klrcp_now_ns();
+	if (blk->lastNs && now > blk->lastNs) {
+		blk->creditNs += now - blk->lastNs;
+		if (blk->creditNs > blk->capacityNs)
+			blk->creditNs = blk->capacityNs;
+	}
+	blk->lastNs = now;
+
+	if (blk->creditNs < blk->intervalNs) {
 		blk->countBlockAvoided++;
 		return 0;
 	}
 
-	blk->lastExecuteTime = now;
+	blk->creditNs -= blk->intervalNs;
 	blk->countBlockEntered++;
 	return 1;
 }
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file	log.h
+ * @author	Steven Toth <stoth@kernellabs.com>
+ * @copyright	Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved.
+ * @brief	Library diagnostics. Every message the library produces, errors as well as the\n
+ *		console dumps requested via verbose or the *_dump() functions, is passed through\n
+ *		vanc_log() with a severity and a category.\n
+ *		By default messages are written synchronously, errors and warnings to stderr and\n
+ *		everything else to stdout. An application can install its own sink, rate limit\n
+ *		noisy categories, and move all output off the calling thread with\n
+ *		vanc_log_enable_async(), in which case the parser never blocks on I/O.\n
+ *		The configuration is process wide, set it up before parsing starts.
+ */
+
+#ifndef _VANC_LOG_H
+#define _VANC_LOG_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/errno.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief	Longest message, including the terminator. Longer messages are truncated.
+ */
+#define VANC_LOG_MSG_MAX 1024
+
+enum vanc_log_level_e
+{
+	VANC_LOG_ERR = 0,
+	VANC_LOG_WARN,
+	VANC_LOG_INFO,
+	VANC_LOG_DEBUG,
+};
+
+enum vanc_log_category_e
+{
+	VANC_LOG_CAT_CORE = 0,		/**< Context management, allocation failures. */
+	VANC_LOG_CAT_PARSE,		/**< Line scanning and header validation. */
+	VANC_LOG_CAT_DECODE,		/**< Type specific decoders. */
+	VANC_LOG_CAT_GENERATE,		/**< VANC line and payload creation. */
+	VANC_LOG_CAT_SMPTE2038,		/**< SMPTE 2038 parsing and packetizing. */
+	VANC_LOG_CAT_DUMP,		/**< Console dumps, verbose output and the *_dump() functions. */
+	VANC_LOG_CAT_MAX,
+};
+
+/**
+ * @brief	Application log sink. msg is printf style text, usually newline terminated.\n
+ *		Console dumps may arrive as several messages per line of output.
+ */
+typedef void (*vanc_log_callback)(void *userContext, enum vanc_log_level_e level,
+	enum vanc_log_category_e category, const char *msg);
+
+/**
+ * @brief	Log a message. Messages above the current level, or over their category rate\n
+ *		limit, are discarded before being formatted.
+ * @param[in]	enum vanc_log_level_e level - Severity.
+ * @param[in]	enum vanc_log_category_e category - Category.
+ * @param[in]	const char *fmt - printf style format.
+ */
+void vanc_log(enum vanc_log_level_e level, enum vanc_log_category_e category, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief	Return non-zero if a message at this level and category would currently be\n
+ *		logged. Useful to avoid building expensive messages that would be discarded.
+ * @param[in]	enum vanc_log_level_e level - Severity.
+ * @param[in]	enum vanc_log_category_e category - Category.
+ */
+int vanc_log_enabled(enum vanc_log_level_e level, enum vanc_log_category_e category);
+
+/**
+ * @brief	Replace the default stdout/stderr sink. In async mode the callback runs on the\n
+ *		drain thread, otherwise on the thread that logged the message.
+ * @param[in]	vanc_log_callback cb - Sink, or NULL to restore the default.
+ * @param[in]	void *userContext - Passed to cb.
+ */
+void vanc_log_set_callback(vanc_log_callback cb, void *userContext);
+
+/**
+ * @brief	Discard messages less severe than level. The default is VANC_LOG_INFO.
+ * @param[in]	enum vanc_log_level_e level - Most verbose level to keep.
+ */
+void vanc_log_set_level(enum vanc_log_level_e level);
+
+/**
+ * @brief	Allow at most maxPerSecond messages per second from a category, with bursts of\n
+ *		up to maxPerSecond. The rest are dropped, and counted in a summary message sent\n
+ *		with the next message the limit allows.
+ * @param[in]	enum vanc_log_category_e category - Category.
+ * @param[in]	unsigned int maxPerSecond - Limit, 0 for unlimited (the default).
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_log_set_rate_limit(enum vanc_log_category_e category, unsigned int maxPerSecond);
+
+/**
+ * @brief	Queue messages on a lock free ring buffer, drained to the sink by a background\n
+ *		thread. Logging never blocks, when the ring is full messages are dropped and counted.
+ * @param[in]	unsigned int ringEntries - Ring size in messages, rounded up to a power of two. 0 for a default.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_log_enable_async(unsigned int ringEntries);
+
+/**
+ * @brief	Flush the ring buffer, stop the drain thread and return to synchronous logging.\n
+ *		No other thread may be logging while this runs.
+ */
+void vanc_log_disable_async(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* _VANC_LOG_H */
@@ -64,3 +64,87 @@ void klvanc_v210_downscale_line_c(uint16_t * src, uint8_t * dst, int lines);
  * @param[in]	int width - Brief description goes here.
  */
 void klvanc_v210_line_to_uyvy_c(uint32_t * src, uint16_t * dst, int width);
+
+/**
+ * @brief	klvanc_v210_planar_unpack_c() using the fastest kernels the CPU supports,\n
+ *		SSSE3, AVX2 or AVX-512, picked once at runtime. The output is bit exact.
+ */
+void klvanc_v210_planar_unpack(const uint32_t * src, uint16_t * y, uint16_t * u, uint16_t * v, int width);
+
+/**
+ * @brief	klvanc_v210_line_to_nv20_c() using the fastest kernels the CPU supports,\n
+ *		SSSE3, AVX2 or AVX-512, picked once at runtime. The output is bit exact.
+ */
+int klvanc_v210_line_to_nv20(const uint32_t * src, uint16_t * dst, int dstSizeBytes, int width);
+
+/**
+ * @brief	klvanc_v210_line_to_uyvy_c() using the fastest kernels the CPU supports,\n
+ *		SSSE3, AVX2 or AVX-512, picked once at runtime. The output is bit exact.
+ */
+void klvanc_v210_line_to_uyvy(const uint32_t * src, uint16_t * dst, int width);
+
+/**
+ * @brief	Look for an ADF (000 3FF 3FF) in the luma or chroma of a packed v210 line, without\n
+ *		unpacking it. Lines that return -1 carry no ANC, there's no need to unpack and\n
+ *		parse them. The check is the parser's own candidate test, so a line it finds\n
+ *		packets in is never reported empty. SIMD kernels are picked at runtime.
+ * @param[in]	const uint32_t * src - The v210 line.
+ * @param[in]	int width - Line width in pixels, rounded down to whole groups of six as\n
+ *		the callers of klvanc_v210_line_to_nv20() do.
+ * @result 	>= 0 - Offset of the first candidate in the klvanc_v210_line_to_nv20() output,\n
+ *		luma first then chroma.
+ * @result 	-1 - No ADF on the line
+ */
+int klvanc_v210_line_find_adf(const uint32_t * src, int width);
+
+/**
+ * @brief	Scalar klvanc_v210_line_find_adf(), regardless of the CPU.
+ */
+int klvanc_v210_line_find_adf_c(const uint32_t * src, int width);
+
+/**
+ * @brief	Instruction set the dispatched v210 functions were selected for.
+ * @return	"avx512", "avx2", "ssse3" or "c"
+ */
+const char *klvanc_pixels_isa(void);
+
+/**
+ * @brief	Bytes of v210 written for a line of width pixels, six pixels to each 16 byte group.
+ */
+#define KLVANC_V210_LINE_BYTES(width) ((((width) + 5) / 6) * 16)
+
+/**
+ * @brief	Pack a line of NV20 samples into v210, the inverse of klvanc_v210_line_to_nv20_c().\n
+ *		The scalar, SSSE3 or AVX2 implementation is picked at runtime.\n
+ *		A width that isn't a multiple of six is padded out to the group with black.
+ * @param[in]	const uint16_t * src - width luma samples followed by width interleaved Cb/Cr samples.
+ * @param[out]	uint32_t * dst - The v210 row, for example the VANC line of a frame.
+ * @param[in]	int dstSizeBytes - Size of dst, at least KLVANC_V210_LINE_BYTES(width).
+ * @param[in]	int width - Line width in pixels.
+ * @result 	0 - Success
+ * @result 	< 0 - Error
+ */
+int klvanc_nv20_line_to_v210(const uint16_t * src, uint32_t * dst, int dstSizeBytes, int width);
+
+/**
+ * @brief	Pack a line of UYVY samples, 10 bits in 16, into v210.\n
+ *		The scalar, SSSE3 or AVX2 implementation is picked at runtime.\n
+ *		A width that isn't a multiple of six is padded out to the group with black.
+ * @param[in]	const uint16_t * src - width * 2 samples, Cb Y Cr Y ...
+ * @param[out]	uint32_t * dst - The v210 row, for example the VANC line of a frame.
+ * @param[in]	int dstSizeBytes - Size of dst, at least KLVANC_V210_LINE_BYTES(width).
+ * @param[in]	int width - Line width in pixels.
+ * @result 	0 - Success
+ * @result 	< 0 - Error
+ */
+int klvanc_uyvy16_line_to_v210(const uint16_t * src, uint32_t * dst, int dstSizeBytes, int width);
+
+/**
+ * @brief	Scalar klvanc_nv20_line_to_v210(), regardless of the CPU.
+ */
+int klvanc_nv20_line_to_v210_c(const uint16_t * src, uint32_t * dst, int dstSizeBytes, int width);
+
+/**
+ * @brief	Scalar klvanc_uyvy16_line_to_v210(), regardless of the CPU.
+ */
+int klvanc_uyvy16_line_to_v210_c(const uint16_t * src, uint32_t * dst, int dstSizeBytes, int width);
@@ -31,6 +31,7 @@
 
 #include <libklvanc/klbitstream_readwriter.h>
 #include <libklvanc/vanc-packets.h>
+#include <libklvanc/buffer.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -180,6 +181,19 @@ int smpte2038_packetizer_end(struct smpte2038_packetizer_s *ctx, uint64_t pts);
  */
 int smpte2038_convert_line_to_words(struct smpte2038_anc_data_line_s *l, uint16_t **words, uint16_t *wordCount);
 
+/**
+ * @brief	As smpte2038_convert_line_to_words(), but the words are placed in a buffer taken\n
+ *              from the default buffer pool, avoiding a heap allocation per line.\n
+ *              On success, caller MUST return the buffer with vanc_buffer_free().
+ * @param[in]	struct smpte2038_anc_data_line_s *line - A line of decomposed vanc, received from the SMPTE2038 parser.
+ * @param[out]	struct buffer_s **buf - Buffer holding the words. used is set to the length in bytes,\n
+ *              nr to the line number.
+ * @return        0 - Success
+ * @return      < 0 - Error
+ * @return      -ENOMEM - Not enough memory to satisfy request
+ */
+int smpte2038_convert_line_to_buffer(struct smpte2038_anc_data_line_s *l, struct buffer_s **buf);
+
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file	stats.h
+ * @author	Steven Toth <stoth@kernellabs.com>
+ * @copyright	Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved.
+ * @brief	Parser counters. Every context keeps a set of plain (non atomic) counters that\n
+ *		the parser updates as it goes, cheap enough to leave on permanently. Snapshots\n
+ *		can be taken from any thread, each counter is read whole but they aren't read\n
+ *		together, so a snapshot taken mid line may be a packet or two out between fields.
+ */
+
+#ifndef _VANC_STATS_H
+#define _VANC_STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/errno.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Entries in vanc_stats_s didCounts, one per DID/SDID pair. */
+#define VANC_STATS_DID_COUNTS 65536
+
+/**
+ * @brief	A snapshot of the context counters, see vanc_context_get_stats().
+ */
+struct vanc_stats_s
+{
+	uint64_t	linesScanned;		/**< Lines searched for packets. */
+	uint64_t	adfFalsePositives;	/**< ADF candidates that didn't hold a valid packet header. */
+	uint64_t	packets;		/**< Packets with a valid header, delivered for decode. */
+	uint64_t	checksumErrors;		/**< Packets with a bad checksum word. */
+	uint64_t	parityErrors;		/**< Packets with a parity error in the DID, SDID or DC word. */
+	uint64_t	decodeErrors;		/**< Packets the type specific decoder rejected. */
+	uint64_t	undecoded;		/**< Packets with no decoder for their DID/SDID. */
+	uint64_t	changeOnlySkipped;	/**< Repeats dropped by vanc_context_set_change_only(). */
+
+	uint64_t	scte104Fragments;	/**< SCTE-104 packets carrying part of a multi packet message. */
+	uint64_t	scte104Reassembled;	/**< Multi packet SCTE-104 messages completed. */
+	uint64_t	scte104Orphaned;	/**< Partial SCTE-104 messages discarded, timed out, interrupted or oversize. */
+
+	/* Only accumulated while vanc_context_enable_stats_timing() is on. */
+	uint64_t	unpackNs;		/**< Converting v210 to 10bit words, in vanc_frame_parse(). */
+	uint64_t	scanNs;			/**< Searching lines and validating headers. */
+	uint64_t	decodeNs;		/**< Type specific decoders, excluding their callbacks. */
+	uint64_t	callbackNs;		/**< Inside application callbacks. */
+
+	/**
+	 * Packets per DID/SDID, indexed by (did << 8) | sdid. Optional and caller allocated,
+	 * VANC_STATS_DID_COUNTS entries. When not NULL vanc_context_get_stats() copies the
+	 * counts into it, NULL skips the 512KB copy.
+	 */
+	uint64_t	*didCounts;
+};
+
+/**
+ * @brief	Take a snapshot of the parser counters, safe to call from any thread.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in,out]	struct vanc_stats_s *stats - Caller allocated. Set didCounts to caller\n
+ *		storage for the per DID/SDID counts, or NULL if they aren't wanted.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_get_stats(struct vanc_context_s *ctx, struct vanc_stats_s *stats);
+
+/**
+ * @brief	Zero every parser counter, including the per DID/SDID counts. Call it from the\n
+ *		thread that drives the parser, between calls to the parse functions.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_reset_stats(struct vanc_context_s *ctx);
+
+/**
+ * @brief	Enable or disable the *Ns timing counters. Timing costs a monotonic clock read\n
+ *		either side of each stage, so it's off by default.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	int enable - 1 to enable, 0 to disable.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_enable_stats_timing(struct vanc_context_s *ctx, int enable);
+
+/**
+ * @brief	Print the parser counters, and every DID/SDID seen, to the console.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_dump_stats(struct vanc_context_s *ctx);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* _VANC_STATS_H */
@@ -42,3 +42,28 @@ uint16_t vanc_checksum_calculate(uint16_t *words, int wordCount);
  */
 int vanc_checksum_is_valid(uint16_t *words, int wordCount);
 
+
+/**
+ * @brief	Verify the parity bits of an array of words. Bit 8 of each word must be the even\n
+ *		parity of bits 0-7, and bit 9 its inverse, as required for the DID, SDID/DBN,\n
+ *		DC and user data words of a packet.
+ * @param[in]	const uint16_t *words - Array of 10bit words.
+ * @param[in]	int wordCount - Number of words in array.
+ * @return	1 - Every word has correct parity
+ * @return	0 - At least one parity error
+ */
+int vanc_parity_is_valid(const uint16_t *words, int wordCount);
+
+/**
+ * @brief	Replace bits 8 and 9 of every word with the parity of bits 0-7, in place.
+ * @param[in]	uint16_t *words - Array of words, only bits 0-7 are significant on input.
+ * @param[in]	int wordCount - Number of words in array.
+ */
+void vanc_parity_generate(uint16_t *words, int wordCount);
+
+/**
+ * @brief	Return an 8bit value as a 10bit word, with parity bits 8 and 9 applied.
+ * @param[in]	uint8_t value - Value.
+ * @return	10bit word
+ */
+uint16_t vanc_parity_word(uint8_t value);
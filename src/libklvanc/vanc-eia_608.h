@@ -23,7 +23,7 @@
  * @file	vanc-eia_608.h
  * @author	Steven Toth <stoth@kernellabs.com>
  * @copyright	Copyright (c) 2016 Kernel Labs Inc. All Rights Reserved.
- * @brief	TODO - Brief description goes here.
+ * @brief	CEA-608 captions, SMPTE 334-1 EIA-608 packets and a caption decoder.
  */
 
 #ifndef _VANC_EIA_608_H
@@ -50,8 +50,108 @@ struct packet_eia_608_s
 	int cc_type;
 	unsigned char cc_data_1;
 	unsigned char cc_data_2;
+
+	/* SMPTE 334-1 view of the first word */
+	int field;			/* 1 or 2 */
+	int line_offset;
+};
+
+#define EIA_608_ROWS 15
+#define EIA_608_COLUMNS 32
+#define EIA_608_CHANNELS 4		/* CC1 - CC4 */
+
+/* eia_608_screen_s attr bits */
+#define EIA_608_ATTR_COLOR_MASK	0x07	/* enum eia_608_color_e */
+#define EIA_608_ATTR_ITALICS	0x08
+#define EIA_608_ATTR_UNDERLINE	0x10
+
+enum eia_608_color_e
+{
+	EIA_608_COLOR_WHITE = 0,
+	EIA_608_COLOR_GREEN,
+	EIA_608_COLOR_BLUE,
+	EIA_608_COLOR_CYAN,
+	EIA_608_COLOR_RED,
+	EIA_608_COLOR_YELLOW,
+	EIA_608_COLOR_MAGENTA,
+};
+
+enum eia_608_mode_e
+{
+	EIA_608_MODE_NONE = 0,
+	EIA_608_MODE_POPON,
+	EIA_608_MODE_ROLLUP,
+	EIA_608_MODE_PAINTON,
+	EIA_608_MODE_TEXT,
 };
 
+/**
+ * @brief	A caption screen. Cells hold Unicode code points, 0 for an empty (transparent) cell.
+ */
+struct eia_608_screen_s
+{
+	uint16_t ch[EIA_608_ROWS][EIA_608_COLUMNS];
+	uint8_t attr[EIA_608_ROWS][EIA_608_COLUMNS];
+};
+
+enum eia_608_event_type_e
+{
+	EIA_608_EVENT_SCREEN = 0,	/* The displayed text of a channel changed */
+	EIA_608_EVENT_XDS,		/* An XDS byte pair from field 2, passed through undecoded */
+};
+
+/**
+ * @brief	Delivered to the eia_608_event callback by the caption decoder, see\n
+ *		vanc_context_enable_eia_608_decoder(). Valid for the duration of the callback.
+ */
+struct eia_608_event_s
+{
+	enum eia_608_event_type_e type;
+
+	/* EIA_608_EVENT_SCREEN */
+	int channel;				/* 1 - 4, CC1 - CC4 */
+	enum eia_608_mode_e mode;
+	const struct eia_608_screen_s *screen;	/* Displayed memory */
+	uint16_t rowsChanged;			/* Bit n set - row n changed */
+
+	/* EIA_608_EVENT_XDS */
+	unsigned char xds[2];			/* Parity stripped */
+};
+
+/**
+ * @brief	Run a CEA-608 caption decoder on the context. 608 byte pairs from EIA-608\n
+ *		packets, or from the cc_data of CEA-708 CDPs when present, drive a decoder per\n
+ *		channel (pop-on, roll-up and paint-on) that maintains displayed and non-displayed\n
+ *		memory incrementally. The eia_608_event callback fires only when the displayed\n
+ *		text of a channel actually changes, and for XDS data.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	int enable - 1 to enable, 0 to disable and discard the decoder state.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_enable_eia_608_decoder(struct vanc_context_s *ctx, int enable);
+
+/**
+ * @brief	Return the displayed memory of a caption channel.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	int channel - 1 - 4, CC1 - CC4.
+ * @return	Success - The screen, owned by the decoder and updated in place as captions arrive.
+ * @return	Error - NULL, the decoder isn't enabled or the channel is invalid.
+ */
+const struct eia_608_screen_s *vanc_eia_608_get_screen(struct vanc_context_s *ctx, int channel);
+
+/**
+ * @brief	Convert a row of a caption screen to UTF-8. Empty cells become spaces, trailing\n
+ *		empty cells are dropped.
+ * @param[in]	const struct eia_608_screen_s *screen - Screen.
+ * @param[in]	int row - 0 - 14.
+ * @param[out]	char *buf - Destination, always null terminated.
+ * @param[in]	size_t len - Size of buf, (EIA_608_COLUMNS * 3) + 1 always suffices.
+ * @return	>= 0 - Number of bytes written, excluding the terminator.
+ * @return	< 0 - Error
+ */
+int eia_608_screen_row_to_utf8(const struct eia_608_screen_s *screen, int row, char *buf, size_t len);
+
 /**
  * @brief	TODO - Brief description goes here.
  * @param[in]	struct vanc_context_s *ctx, void *p - Brief description goes here.
@@ -60,6 +160,17 @@ struct packet_eia_608_s
  */
 int dump_EIA_608(struct vanc_context_s *ctx, void *p);
 
+/**
+ * @brief	Encode a SMPTE 334-1 EIA-608 packet (DID 0x61 SDID 0x02) into 10 bit words.\n
+ *		Nothing is allocated, the words land in the caller's buffer ready to insert.
+ * @param[in]	const struct packet_eia_608_s *pkt - field, line_offset and cc_data_1/2 are used.
+ * @param[out]	uint16_t *words - Destination.
+ * @param[in]	unsigned int wordCount - Size of words.
+ * @return	> 0 - Number of words written
+ * @return	< 0 - Error
+ */
+int vanc_encode_eia_608(const struct packet_eia_608_s *pkt, uint16_t *words, unsigned int wordCount);
+
 #ifdef __cplusplus
 };
 #endif  
@@ -23,7 +23,7 @@
  * @file	vanc-eia_708b.h
  * @author	Steven Toth <stoth@kernellabs.com>
  * @copyright	Copyright (c) 2016 Kernel Labs Inc. All Rights Reserved.
- * @brief	TODO - Brief description goes here.
+ * @brief	SMPTE 334-2 Caption Distribution Packets, carrying CEA-708 and CEA-608 cc_data.
  */
 
 #ifndef _VANC_EIA_708B_H
@@ -35,15 +35,86 @@
 extern "C" {
 #endif  
 
+#define EIA_708B_CDP_IDENTIFIER 0x9669
+#define EIA_708B_CC_DATA_MAX 31		/* cc_count is a 5 bit field */
+#define EIA_708B_SVC_INFO_MAX 15	/* svc_count is a 4 bit field */
+
 /**
- * @brief	TODO - Brief description goes here.
+ * @brief	One cc_data() triplet from the ccdata_section.\n
+ *		cc_type 0/1 - 608 field 1/2, 2 - DTVCC packet data, 3 - DTVCC packet start.
+ */
+struct eia_708b_cc_data_s
+{
+	unsigned char cc_valid;
+	unsigned char cc_type;
+	unsigned char cc_data[2];
+};
+
+/**
+ * @brief	One caption service from the ccsvcinfo_section.
+ */
+struct eia_708b_svc_s
+{
+	unsigned char caption_service_number;
+	char language[4];			/* ISO 639.2, null terminated */
+	unsigned char svc_data_byte[6];		/* The raw caption_service_descriptor */
+};
+
+/**
+ * @brief	A decoded SMPTE 334-2 Caption Distribution Packet. Everything is held inline,\n
+ *		the decoder makes no allocation beyond this struct.
  */
 struct packet_eia_708b_s
 {
 	struct packet_header_s hdr;
 	int nr;
+
+	/* cdp_header() */
+	unsigned short cdp_identifier;
+	unsigned char cdp_length;
+	unsigned char cdp_frame_rate;
+	unsigned char time_code_present;
+	unsigned char ccdata_present;
+	unsigned char svcinfo_present;
+	unsigned char svc_info_start;
+	unsigned char svc_info_change;
+	unsigned char svc_info_complete;
+	unsigned char caption_service_active;
+	unsigned short cdp_hdr_sequence_cntr;
+
+	/* time_code_section(), when time_code_present */
+	unsigned char tc_hours;
+	unsigned char tc_minutes;
+	unsigned char tc_seconds;
+	unsigned char tc_frames;
+	unsigned char tc_field_flag;
+	unsigned char tc_drop_frame;
+
+	/* ccdata_section(), when ccdata_present */
+	unsigned char cc_count;
+	struct eia_708b_cc_data_s cc_data[EIA_708B_CC_DATA_MAX];
+
+	/* ccsvcinfo_section(), when svcinfo_present */
+	unsigned char svc_count;
+	struct eia_708b_svc_s svc[EIA_708B_SVC_INFO_MAX];
+
+	/* cdp_footer() */
+	unsigned short cdp_footer_sequence_cntr;
+	unsigned char packet_checksum;
+
+	/* Validation */
+	int checksum_valid;		/* All cdp_length bytes sum to zero */
+	int sequence_valid;		/* Header and footer sequence counters match */
+	int sequence_discontinuity;	/* Not one after the previous CDP of its stream, per DID/SDID and line */
 };
 
+/**
+ * @brief	Convert a cdp_frame_rate code into a printable string.
+ * @param[in]	unsigned char cdp_frame_rate - Code from the cdp_header.
+ * @return	Success - User facing printable string.
+ */
+const char *eia_708b_frame_rate_to_string(unsigned char cdp_frame_rate);
+
 /**
  * @brief	TODO - Brief description goes here.
  * @param[in]	struct vanc_context_s *ctx, void *p - Brief description goes here.
@@ -52,6 +123,19 @@ struct packet_eia_708b_s
  */
 int dump_EIA_708B(struct vanc_context_s *ctx, void *p);
 
+/**
+ * @brief	Encode a Caption Distribution Packet (DID 0x61 SDID 0x01) into 10 bit words.\n
+ *		The sections present follow the *_present flags, cdp_length, the footer sequence\n
+ *		counter (a copy of cdp_hdr_sequence_cntr) and the checksum are computed.\n
+ *		Nothing is allocated, the words land in the caller's buffer ready to insert.
+ * @param[in]	const struct packet_eia_708b_s *pkt - Packet to encode.
+ * @param[out]	uint16_t *words - Destination.
+ * @param[in]	unsigned int wordCount - Size of words.
+ * @return	> 0 - Number of words written
+ * @return	< 0 - Error
+ */
+int vanc_encode_eia_708b(const struct packet_eia_708b_s *pkt, uint16_t *words, unsigned int wordCount);
+
 #ifdef __cplusplus
 };
 #endif  
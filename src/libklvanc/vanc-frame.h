@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file	vanc-frame.h
+ * @author	Steven Toth <stoth@kernellabs.com>
+ * @copyright	Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved.
+ * @brief	Parse all of the VANC lines belonging to a single video frame in one call.\n
+ *		The library brackets the frame with frame_begin / frame_end callbacks, and\n
+ *		can hand the frame_end callback every decoded packet in the frame, grouped\n
+ *		by type, so downstream consumers can act once per frame rather than per line.
+ */
+
+#ifndef _VANC_FRAME_H
+#define _VANC_FRAME_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/errno.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief	Use for vanc_frame_s pts / streamTime when the value isn't known.
+ */
+#define VANC_NOPTS_VALUE ((int64_t)0x8000000000000000ULL)
+
+/**
+ * @brief	A single line of VANC. Either 10bit words, as handed to vanc_packet_parse(),\n
+ *		or a packed v210 line that the library unpacks (see klvanc_v210_line_to_nv20_c()).
+ */
+struct vanc_frame_line_s
+{
+	unsigned int	lineNr;
+	unsigned short	*words;			/**< 10bit words, or NULL if v210 is supplied instead. */
+	unsigned int	wordCount;
+	const uint32_t	*v210;			/**< Packed v210, only used when words is NULL. */
+	unsigned int	v210Width;		/**< Width of the v210 line, in pixels. */
+};
+
+/**
+ * @brief	Decoded packets of a single type, in the order they were found in the frame.\n
+ *		Each entry points to the type specific struct, for example a struct packet_eia_708b_s.
+ */
+struct vanc_frame_packets_s
+{
+	void		**packets;
+	unsigned int	count;
+};
+
+/**
+ * @brief	Describes one frame of VANC. The caller fills in the line array and timing,\n
+ *		the library fills in everything else.
+ */
+struct vanc_frame_s
+{
+	/* Caller supplied */
+	struct vanc_frame_line_s *lines;
+	unsigned int	lineCount;
+	int64_t		pts;			/**< Or VANC_NOPTS_VALUE. */
+	int64_t		streamTime;		/**< Or VANC_NOPTS_VALUE. */
+
+	/* Library supplied */
+	uint64_t	frameNr;		/**< Frames processed by this context, starting at 0. */
+	unsigned int	packetCount;		/**< Valid packets found, across all lines. */
+	struct vanc_timecode_s timecode;	/**< From the frame's ATC packets, set before frame_end. */
+
+	/**
+	 * Valid during the frame_end callback only, and only populated when a frame_end
+	 * callback has been registered. Indexed by enum packet_type_e.
+	 */
+	struct vanc_frame_packets_s types[VANC_TYPE_MAX];
+};
+
+/**
+ * @brief	Parse every line in frame, in array order. The frame_begin callback fires before\n
+ *		the first line is parsed, then the usual per packet callbacks, then frame_end.\n
+ *		If a frame_end callback is registered, the decoded packets are also retained and\n
+ *		made available in frame->types[] during frame_end. They are released when\n
+ *		frame_end returns, or when the context arena is next reset if an arena is in use.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	struct vanc_frame_s *frame - Lines and timing for one frame.
+ * @return      >= 0 - Number of packets found in the frame
+ * @return      < 0 - Error
+ */
+int vanc_frame_parse(struct vanc_context_s *ctx, struct vanc_frame_s *frame);
+
+/**
+ * @brief	Have vanc_frame_parse() unpack and scan the lines of each frame in parallel,\n
+ *		using a pool of threadCount worker threads. The calling thread acts as the\n
+ *		dispatcher, as each line completes (in line order) it decodes its packets\n
+ *		and fires the callbacks, so callbacks are always delivered sequentially,\n
+ *		from the thread that called vanc_frame_parse(), in line then horizontal\n
+ *		offset order. Only applies to vanc_frame_parse(), vanc_packet_parse() is unaffected.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	unsigned int threadCount - Number of worker threads, 0 to stop the pool.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_enable_workers(struct vanc_context_s *ctx, unsigned int threadCount);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* _VANC_FRAME_H */
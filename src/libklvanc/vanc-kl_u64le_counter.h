@@ -52,6 +52,17 @@ struct packet_kl_u64le_counter_s
  */
 int dump_KL_U64LE_COUNTER(struct vanc_context_s *ctx, void *p);
 
+/**
+ * @brief	Encode a counter packet (DID 0x40 SDID 0xfe) into 10 bit words.\n
+ *		Nothing is allocated, the words land in the caller's buffer ready to insert.
+ * @param[in]	const struct packet_kl_u64le_counter_s *pkt - counter is used.
+ * @param[out]	uint16_t *words - Destination.
+ * @param[in]	unsigned int wordCount - Size of words.
+ * @return	> 0 - Number of words written
+ * @return	< 0 - Error
+ */
+int vanc_encode_kl_u64le_counter(const struct packet_kl_u64le_counter_s *pkt, uint16_t *words, unsigned int wordCount);
+
 #ifdef __cplusplus
 };
 #endif  
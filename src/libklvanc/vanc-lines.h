@@ -52,6 +52,7 @@ struct vanc_entry_s
         int h_offset;
         uint16_t *payload;
         int pixel_width;
+        struct buffer_s *buf;	/* Library private, the pool buffer holding this entry and its payload. */
 };
 
 /**
@@ -133,6 +134,137 @@ int vanc_line_insert(struct vanc_line_set_s *vanc_lines, uint16_t *pixels,
  */
 int generate_vanc_line(struct vanc_line_s *line, uint16_t **out_buf, int *out_len, int line_pixel_width);
 
+/**
+ * @brief	A frame composer. The allocation free alternative to vanc_line_set_s: per line\n
+ *		slots are indexed directly by line number and packets are appended to a single\n
+ *		word arena sized at creation. Insert the packets for a frame, emit each line into\n
+ *		a caller buffer, then vanc_composer_reset() for the next frame. Nothing is\n
+ *		allocated after vanc_composer_alloc().
+ */
+struct vanc_composer_s;
+
+/**
+ * @brief	Create a composer.
+ * @param[out]	struct vanc_composer_s **composer - The new composer.
+ * @param[in]	int max_line_number - Largest line number that will be used, 1125 covers every SDI format.
+ * @param[in]	int max_packets - Number of packets a frame may hold.
+ * @param[in]	int arena_words - Total words the packets of a frame may occupy.
+ * @return      0 - Success
+ * @return      -ENOMEM - Insufficient memory
+ * @return      -EINVAL - Bad arguments
+ */
+int vanc_composer_alloc(struct vanc_composer_s **composer, int max_line_number, int max_packets, int arena_words);
+
+/**
+ * @brief	Free a composer and everything it holds.
+ * @param[in]	struct vanc_composer_s *composer - Composer, may be NULL.
+ */
+void vanc_composer_free(struct vanc_composer_s *composer);
+
+/**
+ * @brief	Discard every packet, ready for the next frame. Costs one step per line used.
+ * @param[in]	struct vanc_composer_s *composer - Composer.
+ */
+void vanc_composer_reset(struct vanc_composer_s *composer);
+
+/**
+ * @brief	Copy a VANC packet into the composer, the same contract as vanc_line_insert().
+ *
+ * @param[in]	struct vanc_composer_s *composer - Composer.
+ * @param[in]	const uint16_t *pixels - The packet, 10-bit values in 16-bit fields.
+ * @param[in]	int pixel_width - width of [pixels], measured in number of samples
+ * @param[in]	int line_number - 1 to max_line_number.
+ * @param[in]	int horizontal_offset - Preferred offset, used to order the packets of a line.
+ *
+ * @return      0 - Success
+ * @return      -ENOSPC - The frame already holds max_packets packets or arena_words words
+ * @return      -EINVAL - Bad arguments
+ */
+int vanc_composer_insert(struct vanc_composer_s *composer, const uint16_t *pixels,
+	int pixel_width, int line_number, int horizontal_offset);
+
+/**
+ * @brief	Walk the lines holding packets, in ascending order.
+ * @param[in]	struct vanc_composer_s *composer - Composer.
+ * @param[in]	int line_number - Previous line returned, 0 to start.
+ * @return      > 0 - The next line holding packets
+ * @return      -1 - No more lines
+ */
+int vanc_composer_next_line(struct vanc_composer_s *composer, int line_number);
+
+/**
+ * @brief	Emit a line, with the rules of generate_vanc_line(): packets are ordered by\n
+ *		horizontal offset and placed back to back from the start of the line, packets\n
+ *		with illegal words or that would overflow the line are skipped.
+ *
+ * @param[in]	struct vanc_composer_s *composer - Composer.
+ * @param[in]	int line_number - Line to emit.
+ * @param[out]	uint16_t *out_buf - Caller buffer, line_pixel_width samples.
+ * @param[out]	int *out_len - Samples written, 0 for a line without packets.
+ * @param[in]	int line_pixel_width - Size of the line, measured in number of samples.
+ * @return      0 - Success
+ * @return      -EINVAL - Bad arguments
+ */
+int vanc_composer_generate_line(struct vanc_composer_s *composer, int line_number,
+	uint16_t *out_buf, int *out_len, int line_pixel_width);
+
+/**
+ * @brief	Which SDI samples carry the VANC words of a line.
+ */
+enum vanc_placement_e
+{
+	VANC_PLACEMENT_LUMA = 0,	/* HD, the Y samples, chroma is left blank */
+	VANC_PLACEMENT_CHROMA,		/* HD, the Cb/Cr samples, luma is left blank */
+	VANC_PLACEMENT_INTERLEAVED,	/* SD, every sample in Cb Y Cr Y order */
+};
+
+#define VANC_DISPLAY_MODE_MAX_RANGES 2
+
+/**
+ * @brief	The parts of a display mode the compositor needs.
+ */
+struct vanc_display_mode_s
+{
+	int width;			/* Pixels per line */
+	enum vanc_placement_e placement;
+
+	/* Inclusive line number ranges carrying VANC, typically one per field */
+	int num_ranges;
+	struct {
+		int first;
+		int last;
+	} ranges[VANC_DISPLAY_MODE_MAX_RANGES];
+};
+
+/**
+ * @brief	Supplies the v210 row for a line, for example from the output frame's ancillary buffer.
+ * @param[in]	void *userContext - As passed to vanc_composer_write_v210().
+ * @param[in]	int line_number - Line being written.
+ * @param[out]	uint32_t **dst - The row, NULL to leave this line alone.
+ * @param[out]	int *dstSizeBytes - Size of the row, at least KLVANC_V210_LINE_BYTES(width), see pixels.h.
+ * @return	0 - Success
+ * @return	< 0 - Stop, vanc_composer_write_v210() returns this value
+ */
+typedef int (*vanc_v210_line_func)(void *userContext, int line_number, uint32_t **dst, int *dstSizeBytes);
+
+/**
+ * @brief	Write every VANC line of a frame as v210, in one pass and without intermediate\n
+ *		buffers. Each line in the mode's ranges is written: its packets are placed with\n
+ *		the rules of generate_vanc_line() and packed straight into the row, the rest of\n
+ *		the row, and lines without packets, are written as blanking.\n
+ *		Packets on lines outside the ranges are ignored.
+ *
+ * @param[in]	struct vanc_composer_s *composer - Composer holding the frame's packets.
+ * @param[in]	const struct vanc_display_mode_s *mode - Display mode.
+ * @param[in]	vanc_v210_line_func get_line - Supplies the destination row of each line.
+ * @param[in]	void *userContext - Passed to get_line.
+ * @return      >= 0 - Number of lines written
+ * @return      -EINVAL - Bad arguments, or a row that is too small
+ * @return      < 0 - An error from get_line
+ */
+int vanc_composer_write_v210(struct vanc_composer_s *composer, const struct vanc_display_mode_s *mode,
+	vanc_v210_line_func get_line, void *userContext);
+
 #ifdef __cplusplus
 };
 #endif  
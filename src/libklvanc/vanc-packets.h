@@ -47,6 +47,32 @@ enum packet_type_e
 	VANC_TYPE_EIA_608,
 	VANC_TYPE_SCTE_104,
 	VANC_TYPE_KL_UINT64_COUNTER,
+	VANC_TYPE_SMPTE_12_2,
+	VANC_TYPE_USER,		/* Decoded by a decoder registered with vanc_register_decoder(). */
+	VANC_TYPE_MAX,	/* Number of types, must be last. */
+};
+
+/* The data count is eight bits, no packet carries more user data words than this. */
+#define VANC_PAYLOAD_WORDS_MAX 255
+
+/* Largest packet, ADF through checksum. Also the most vanc_encode_packet() and the
+ * vanc_encode_*() helpers produce, in words.
+ */
+#define VANC_PACKET_WORDS_MAX (VANC_PAYLOAD_WORDS_MAX + 7)
+
+/**
+ * @brief	A time address, decoded from a SMPTE 12M-2 ancillary time code packet.\n
+ *		Plain integers, cheap to copy and compare, format them only when needed.
+ */
+struct vanc_timecode_s
+{
+	unsigned char		valid;			/**< 0 - No usable timecode, ignore the rest. */
+	unsigned char		source;			/**< DBB1 of the ATC packet, SMPTE_12_2_DBB1_*. */
+	unsigned char		hours;
+	unsigned char		minutes;
+	unsigned char		seconds;
+	unsigned char		frames;
+	unsigned char		dropFrame;
 };
 
 /**
@@ -59,15 +85,52 @@ struct packet_header_s
 	unsigned short		did;
 	unsigned short		dbnsdid;
 	unsigned short		checksum;
-	unsigned short		payload[16384];
+
+	/**
+	 * Timecode of the frame the packet was found in. vanc_frame_parse() starts each
+	 * frame without one, so in the per packet callbacks, packets ahead of the frame's
+	 * ATC packet (normally on line 9 or 10) don't have it yet. By frame_end every packet
+	 * in frame->types[] carries the frame's timecode, except VANC_TYPE_USER packets,
+	 * whose layout the library doesn't know. Outside vanc_frame_parse() it's the last
+	 * ATC timecode seen.
+	 */
+	struct vanc_timecode_s	timecode;
+
+	unsigned short		payload[VANC_PAYLOAD_WORDS_MAX];
 	unsigned short		payloadLengthWords;
 	unsigned int 		checksumValid;
 	unsigned int		lineNr; 		/**< The vanc in this header came from line.... */
-	unsigned short		raw[16384];
+	unsigned short		raw[VANC_PACKET_WORDS_MAX];	/**< The entire packet, ADF through checksum. */
 	unsigned int 		rawLengthWords;
 	unsigned short		horizontalOffset;	/**< Horizontal word where the ADF was detected. */
 };
 
+/**
+ * @brief	A zero-copy description of a VANC packet, as found in the callers line buffer.\n
+ *		No words are copied, the view carries offsets and lengths into the original\n
+ *		array of words. A view is only valid for the duration of the callback it was\n
+ *		delivered to, use vanc_packet_view_clone() if the packet needs to be retained.
+ */
+struct packet_view_s
+{
+	enum packet_type_e	type;
+	const unsigned short	*words;			/**< First ADF word, inside the callers line buffer. */
+	unsigned short		did;
+	unsigned short		dbnsdid;
+	unsigned short		checksum;
+	unsigned short		payloadOffset;		/**< Offset of the first user data word, relative to words. */
+	unsigned short		payloadLengthWords;
+	unsigned int 		checksumValid;
+	unsigned int		lineNr; 		/**< The vanc in this view came from line.... */
+	unsigned int 		rawLengthWords;		/**< ADF through checksum, inclusive. */
+	unsigned short		horizontalOffset;	/**< Horizontal word where the ADF was detected. */
+};
+
+/**
+ * @brief	Helper Macro. Return a pointer to the first user data word of a packet view.
+ */
+#define vanc_packet_view_payload(v) ((v)->words + (v)->payloadOffset)
+
 /**
  * @brief SMPTE 291-1-2011 Section 6.3
  * "An ancillary data packet with a DID word value equal to 80h may be deleted by any equipment
@@ -98,6 +98,17 @@ const char *aspectRatio_to_string(enum payload_aspect_ratio_e ar);
  */
 int dump_PAYLOAD_INFORMATION(struct vanc_context_s *ctx, void *p);
 
+/**
+ * @brief	Encode an AFD and bar data packet (DID 0x41 SDID 0x05) into 10 bit words.\n
+ *		Nothing is allocated, the words land in the caller's buffer ready to insert.
+ * @param[in]	const struct packet_payload_information_s *pkt - afd, aspectRatio and bar data are used.
+ * @param[out]	uint16_t *words - Destination.
+ * @param[in]	unsigned int wordCount - Size of words.
+ * @return	> 0 - Number of words written
+ * @return	< 0 - Error
+ */
+int vanc_encode_payload_information(const struct packet_payload_information_s *pkt, uint16_t *words, unsigned int wordCount);
+
 #ifdef __cplusplus
 };
 #endif  
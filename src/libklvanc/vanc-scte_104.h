@@ -45,6 +45,22 @@ extern "C" {
  */
 #define MO_INIT_REQUEST_DATA     0x101
 
+/* multiple_operation_message opIDs, SCTE 104 table 8-2 */
+#define MO_SPLICE_REQUEST_DATA                      0x101
+#define MO_SPLICE_NULL_REQUEST_DATA                 0x102
+#define MO_START_SCHEDULE_DOWNLOAD_REQUEST_DATA     0x103
+#define MO_TIME_SIGNAL_REQUEST_DATA                 0x104
+#define MO_TRANSMIT_SCHEDULE_REQUEST_DATA           0x105
+#define MO_COMPONENT_MODE_DPI_REQUEST_DATA          0x106
+#define MO_ENCRYPTED_DPI_REQUEST_DATA               0x107
+#define MO_INSERT_DESCRIPTOR_REQUEST_DATA           0x108
+#define MO_INSERT_DTMF_REQUEST_DATA                 0x109
+#define MO_INSERT_AVAIL_DESCRIPTOR_REQUEST_DATA     0x10a
+#define MO_INSERT_SEGMENTATION_REQUEST_DATA         0x10b
+#define MO_PROPRIETARY_COMMAND_REQUEST_DATA         0x10c
+#define MO_SCHEDULE_COMPONENT_MODE_REQUEST_DATA     0x10d
+#define MO_SCHEDULE_DEFINITION_REQUEST_DATA         0x10e
+
 /**
  * @brief       TODO - Brief description goes here.
  */
@@ -132,10 +148,112 @@ struct multiple_operation_message_timestamp
 	};
 };
 
+/* Typed MOM operations, see scte_104_decode_mom_op(). Variable length fields point
+ * into the message payload of the owning packet_scte_104_s.
+ */
+
+/* SCTE 104 table 9-13 */
+struct scte104_time_signal_request_data
+{
+	unsigned short pre_roll_time;		/* In milliseconds */
+};
+
+/* SCTE 104 table 9-19 */
+struct scte104_encrypted_dpi_request_data
+{
+	unsigned char encryption_algorithm;
+	unsigned char cw_index;
+};
+
+/* SCTE 104 table 9-20 */
+struct scte104_insert_descriptor_request_data
+{
+	unsigned char descriptor_count;
+	unsigned short descriptor_bytes_length;
+	const unsigned char *descriptor_bytes;	/* Complete splice descriptors, tag and length included */
+};
+
+/* SCTE 104 table 9-21 */
+struct scte104_dtmf_descriptor_request_data
+{
+	unsigned char pre_roll_time;		/* In 1/10's of a second */
+	unsigned char dtmf_length;
+	char dtmf_char[8];			/* Not null terminated */
+};
+
+/* SCTE 104 table 9-22 */
+struct scte104_avail_descriptor_request_data
+{
+	unsigned char num_provider_avails;
+	const unsigned char *provider_avail_ids;	/* num_provider_avails 32 bit big endian ids */
+};
+
+/* SCTE 104 table 9-23 */
+struct scte104_segmentation_descriptor_request_data
+{
+	unsigned int segmentation_event_id;
+	unsigned char segmentation_event_cancel_indicator;
+	unsigned short duration;		/* In seconds */
+	unsigned char segmentation_upid_type;
+	unsigned char segmentation_upid_length;
+	const unsigned char *segmentation_upid;
+	unsigned char segmentation_type_id;
+	unsigned char segment_num;
+	unsigned char segments_expected;
+
+	/* Later revisions of the spec append these. When absent delivery_not_restricted_flag
+	 * is 1 and the rest are 0.
+	 */
+	unsigned char duration_extension_frames;
+	unsigned char delivery_not_restricted_flag;
+	unsigned char web_delivery_allowed_flag;
+	unsigned char no_regional_blackout_flag;
+	unsigned char archive_allowed_flag;
+	unsigned char device_restrictions;
+};
+
+/* SCTE 104 table 9-24 */
+struct scte104_proprietary_command_request_data
+{
+	unsigned int proprietary_id;
+	unsigned char proprietary_command;
+	unsigned short proprietary_data_length;
+	const unsigned char *proprietary_data;
+};
+
+/**
+ * @brief       TODO - Brief description goes here.
+ */
+struct splice_request_data
+{
+	/* SCTE 104 Table 8-5 */
+	unsigned int splice_insert_type;
+	unsigned int splice_event_id;
+	unsigned short unique_program_id;
+	unsigned short pre_roll_time;	/* In milliseconds */
+	unsigned short brk_duration;	/* In 1/10's of a second */
+	unsigned char avail_num;
+	unsigned char avails_expected;
+	unsigned char auto_return_flag;
+};
+
 struct multiple_operation_message_operation {
 	unsigned short opID;
 	unsigned short data_length;
-	unsigned char *data;
+	unsigned char *data;		/* Points into the message payload of the owning packet */
+
+	/* Typed form of data, filled on first use by scte_104_decode_mom_op(). */
+	int decodeState;		/* 0 - Not yet decoded, 1 - Decoded, < 0 - Error */
+	union {
+		struct splice_request_data sr_data;
+		struct scte104_time_signal_request_data timesignal_data;
+		struct scte104_encrypted_dpi_request_data encrypted_dpi_data;
+		struct scte104_insert_descriptor_request_data descriptor_data;
+		struct scte104_dtmf_descriptor_request_data dtmf_data;
+		struct scte104_avail_descriptor_request_data avail_descriptor_data;
+		struct scte104_segmentation_descriptor_request_data segmentation_data;
+		struct scte104_proprietary_command_request_data proprietary_data;
+	};
 };
 
 /**
@@ -158,20 +276,9 @@ struct multiple_operation_message
 };
 
 /**
- * @brief       TODO - Brief description goes here.
+ * @brief	Largest SCTE-104 message the library will reassemble from multiple packets.
  */
-struct splice_request_data
-{
-	/* SCTE 104 Table 8-5 */
-	unsigned int splice_insert_type;
-	unsigned int splice_event_id;
-	unsigned short unique_program_id;
-	unsigned short pre_roll_time;	/* In 1/10's of a second */
-	unsigned short brk_duration;	/* In 1/10's of a second */
-	unsigned char avail_num;
-	unsigned char avails_expected;
-	unsigned char auto_return_flag;
-};
+#define SCTE_104_MESSAGE_MAX 2048
 
 /**
  * @brief       TODO - Brief description goes here.
@@ -187,7 +294,8 @@ struct packet_scte_104_s
 	int following_pkt;
 	int duplicate_msg;
 
-	unsigned char payload[256];
+	/* The complete message, reassembled when it spanned multiple packets. */
+	unsigned char payload[SCTE_104_MESSAGE_MAX];
 	unsigned int payloadLengthBytes;
 
 	struct single_operation_message so_msg;
@@ -203,6 +311,84 @@ struct packet_scte_104_s
  */
 int dump_SCTE_104(struct vanc_context_s *ctx, void *p);
 
+/**
+ * @brief	Decode a multiple_operation_message operation into its typed form, the matching\n
+ *		member of the operation's union. Operations are left as raw bytes until asked for,\n
+ *		the first call decodes, later calls return the cached result.\n
+ *		Typed forms exist for splice_request_data, time_signal, encrypted_DPI,\n
+ *		insert_descriptor, insert_DTMF, insert_avail, insert_segmentation and\n
+ *		proprietary_command. splice_null and start_schedule_download carry no data.
+ * @param[in]	struct multiple_operation_message_operation *op - Operation from mo_msg.ops[].
+ * @return      0 - Success, the typed form is valid (or the operation has no data)
+ * @return      -ENOTSUP - No typed form for this opID, use data and data_length
+ * @return      < 0 - The operation is truncated or malformed
+ */
+int scte_104_decode_mom_op(struct multiple_operation_message_operation *op);
+
+/**
+ * @brief	Messages larger than a single packet arrive as a series of packets, with the\n
+ *		continued_pkt and following_pkt flags set. The context stitches them back\n
+ *		together, across lines and fields, and decodes the message when the final\n
+ *		packet arrives. A partial message still incomplete after timeoutMs (library\n
+ *		clock, see clock.h) is discarded and counted in vanc_stats_s scte104Orphaned.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	unsigned int timeoutMs - Reassembly timeout, the default is 500ms.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_set_scte_104_timeout(struct vanc_context_s *ctx, unsigned int timeoutMs);
+
+/**
+ * @brief	Encode a SCTE-104 message as SMPTE 2010 packets (DID 0x41 SDID 0x07) into 10 bit words.\n
+ *		so_msg.opID selects the message type, as it does for dump_SCTE_104().\n
+ *		SO_INIT_REQUEST_DATA writes a single operation message carrying sr_data,\n
+ *		0xffff a multiple operation message with mo_msg.num_ops operations. An operation\n
+ *		with data set is copied as is, otherwise its typed form is serialized, so a message\n
+ *		from the scte_104 callback round trips unchanged. messageSize is computed.\n
+ *		A message longer than one packet is split, the packets are written back to back\n
+ *		with the continued_pkt and following_pkt flags set, ready to insert in order.\n
+ *		Nothing is allocated, the words land in the caller's buffer.
+ * @param[in]	const struct packet_scte_104_s *pkt - Message to encode.
+ * @param[out]	uint16_t *words - Destination.
+ * @param[in]	unsigned int wordCount - Size of words, VANC_PACKET_WORDS_MAX per packet is always enough.
+ * @return	> 0 - Number of words written
+ * @return	-ENOSPC - words is too small
+ * @return	-ENOTSUP - Unsupported message type, or an operation with neither data nor a typed form
+ * @return	< 0 - Error
+ */
+int vanc_encode_scte_104(const struct packet_scte_104_s *pkt, uint16_t *words, unsigned int wordCount);
+
+/**
+ * @brief	Largest SCTE-35 splice_info_section, table_id through CRC_32 inclusive.
+ */
+#define SCTE_35_SECTION_MAX 4096
+
+/**
+ * @brief	Translate a decoded SCTE-104 message into a SCTE-35 splice_info_section, ready to\n
+ *		carry in a transport stream. The section is written into buf, CRC_32 included,\n
+ *		nothing is allocated so it's safe to call from the scte_104 callback.\n
+ *		splice_request_data becomes a splice_insert, time_signal_request_data a\n
+ *		time_signal and splice_null_request_data a splice_null. The insert_descriptor,\n
+ *		insert_DTMF, insert_avail and insert_segmentation operations of a multiple\n
+ *		operation message become the section's splice descriptors, other operations\n
+ *		are ignored. Splice times are pts plus the message's pre_roll_time, pts_adjustment\n
+ *		is 0. Without a pts a splice_insert is sent as splice_immediate and a time_signal\n
+ *		without a specified time.\n
+ *		When multiplexing the section, prepend a zero pointer_field, the transport\n
+ *		packetizer doesn't add one.
+ * @param[in]	struct packet_scte_104_s *pkt - Message, as passed to the scte_104 callback.
+ * @param[in]	int64_t pts - 90KHz presentation time of the frame carrying the message, or VANC_NOPTS_VALUE.
+ * @param[out]	uint8_t *buf - Caller allocated, SCTE_35_SECTION_MAX bytes is always enough.
+ * @param[in]	unsigned int bufSize - Size of buf in bytes.
+ * @param[out]	unsigned int *byteCount - Length of the section written to buf.
+ * @return      0 - Success
+ * @return      -ENOTSUP - The message doesn't carry a splice command, nothing to send
+ * @return      -ENOSPC - buf is too small
+ * @return      < 0 - The message is malformed
+ */
+int scte_104_to_scte_35(struct packet_scte_104_s *pkt, int64_t pts, uint8_t *buf, unsigned int bufSize,
+	unsigned int *byteCount);
+
 #ifdef __cplusplus
 };
 #endif  
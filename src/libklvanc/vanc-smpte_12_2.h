@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved
+ *
+ * Address: Kernel Labs Inc., PO Box 745, St James, NY. 11780
+ * Contact: sales@kernellabs.com
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file	vanc-smpte_12_2.h
+ * @author	Steven Toth <stoth@kernellabs.com>
+ * @copyright	Copyright (c) 2017 Kernel Labs Inc. All Rights Reserved.
+ * @brief	SMPTE 12M-2 Ancillary Time Code (ATC), DID 0x60 SDID 0x60.\n
+ *		Each packet carries one 64 bit LTC or VITC word, a time address plus eight\n
+ *		binary groups, and two distributed binary bit bytes describing it.\n
+ *		The time address of the frame is also copied into the header of every packet\n
+ *		decoded after it, see struct vanc_timecode_s.
+ */
+
+#ifndef _VANC_SMPTE_12_2_H
+#define _VANC_SMPTE_12_2_H
+
+#include <libklvanc/vanc-packets.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* DBB1 payload types, SMPTE 12M-2 table 5 */
+#define SMPTE_12_2_DBB1_LTC		0x00
+#define SMPTE_12_2_DBB1_VITC1		0x01	/* VITC, first field */
+#define SMPTE_12_2_DBB1_VITC2		0x02	/* VITC, second field */
+
+/**
+ * @brief	A decoded ATC packet.
+ */
+struct packet_smpte_12_2_s
+{
+	struct packet_header_s hdr;
+
+	/* Distributed binary bits */
+	unsigned char dbb1;			/* Payload type, SMPTE_12_2_DBB1_* */
+	unsigned char dbb2;
+	unsigned char vitc_line_select;		/* DBB2 bits 0-4 */
+	unsigned char line_duplication_flag;	/* DBB2 bit 5 */
+	unsigned char tc_validity_flag;		/* DBB2 bit 6, set when the time code is invalid */
+	unsigned char user_bits_process_flag;	/* DBB2 bit 7 */
+
+	/* Time address */
+	unsigned char hours;
+	unsigned char minutes;
+	unsigned char seconds;
+	unsigned char frames;
+	unsigned char drop_frame_flag;		/* Bit 10 */
+	unsigned char color_frame_flag;		/* Bit 11 */
+
+	/* The meaning of these depends on the frame rate, SMPTE 12M-1 table 2.
+	 * 30 frame systems: 27 polarity correction (LTC) or field mark (VITC), 43 BGF0, 58 BGF1, 59 BGF2.
+	 * 25 frame systems: 27 BGF0, 43 BGF2, 58 BGF1, 59 polarity correction or field mark.
+	 */
+	unsigned char flag27;
+	unsigned char flag43;
+	unsigned char flag58;
+	unsigned char flag59;
+
+	unsigned char binary_group[8];		/* BG1-BG8, a nibble each */
+};
+
+/**
+ * @brief	Human readable name for a DBB1 payload type.
+ * @param[in]	unsigned char dbb1 - Payload type.
+ * @return	A static string.
+ */
+const char *smpte_12_2_dbb1_to_string(unsigned char dbb1);
+
+/**
+ * @brief	Print the decoded packet to the console.
+ * @param[in]	struct vanc_context_s *ctx, void *p - Context and struct packet_smpte_12_2_s.
+ * @return	0 - Success
+ * @return	< 0 - Error
+ */
+int dump_SMPTE_12_2(struct vanc_context_s *ctx, void *p);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* _VANC_SMPTE_12_2_H */
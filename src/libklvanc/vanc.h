@@ -39,6 +39,7 @@
 #include <sys/errno.h>
 #include <sys/errno.h>
 #include <libklvanc/klrestricted_code_path.h>
+#include <libklvanc/clock.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -83,6 +84,26 @@ struct vanc_context_s;
  */
 struct packet_kl_u64le_counter_s;
 
+/**
+ * @brief       Zero-copy packet description, see vanc_packet_parse_views().
+ */
+struct packet_view_s;
+
+/**
+ * @brief       A frame of VANC lines, see vanc_frame_parse().
+ */
+struct vanc_frame_s;
+
+/**
+ * @brief       A CEA-608 caption decoder event, see vanc_context_enable_eia_608_decoder().
+ */
+struct eia_608_event_s;
+
+/**
+ * @brief       SMPTE 12M-2 ancillary time code, see vanc-smpte_12_2.h.
+ */
+struct packet_smpte_12_2_s;
+
 /**
  * @brief       TODO - Brief description goes here.
  */
@@ -94,6 +115,11 @@ struct vanc_callbacks_s
 	int (*scte_104)(void *user_context, struct vanc_context_s *, struct packet_scte_104_s *);
 	int (*all)(void *user_context, struct vanc_context_s *, struct packet_header_s *);
 	int (*kl_i64le_counter)(void *user_context, struct vanc_context_s *, struct packet_kl_u64le_counter_s *);
+	int (*view)(void *user_context, struct vanc_context_s *, struct packet_view_s *);
+	int (*frame_begin)(void *user_context, struct vanc_context_s *, struct vanc_frame_s *);
+	int (*frame_end)(void *user_context, struct vanc_context_s *, struct vanc_frame_s *);
+	int (*eia_608_event)(void *user_context, struct vanc_context_s *, const struct eia_608_event_s *);
+	int (*smpte_12_2)(void *user_context, struct vanc_context_s *, struct packet_smpte_12_2_s *);
 };
 
 struct vanc_cache_s;
@@ -151,6 +177,119 @@ int vanc_context_destroy(struct vanc_context_s *ctx);
  */
 int vanc_context_dump(struct vanc_context_s *ctx);
 
+/**
+ * @brief	Have every decoder allocate its packet structs from a per-context arena, instead\n
+ *		of the heap. Decoded packets, and the hdr embedded in them, then remain valid\n
+ *		until the arena is reset. The packet_header_s passed to the all callback is not\n
+ *		one of them, the context reuses it for the next packet, so don't keep it beyond\n
+ *		the callback.\n
+ *		vanc_frame_parse() resets the arena itself once frame_end has returned, so\n
+ *		packets decoded for a frame live until the end of that call, and any packets\n
+ *		still held from earlier vanc_packet_parse() calls go with them. Callers using\n
+ *		only vanc_packet_parse() MUST reset it with vanc_context_arena_reset(), typically\n
+ *		once per frame, or it will continue to grow. The arena grows as needed during\n
+ *		warm-up, after which parsing performs no heap allocations.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	unsigned int sizeBytes - Initial arena size, 0 for a sensible default.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_enable_arena(struct vanc_context_s *ctx, unsigned int sizeBytes);
+
+/**
+ * @brief	Release every packet allocated from the context arena in one operation.\n
+ *		Any packet pointers previously passed to callbacks become invalid.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ */
+void vanc_context_arena_reset(struct vanc_context_s *ctx);
+
+/**
+ * @brief	Restrict the context to packets with a specific DID/SDID. Until the first call,\n
+ *		every packet is processed. Once a subscription exists, packets that don't match\n
+ *		any subscribed DID/SDID are skipped as soon as their header words are seen, they\n
+ *		are never allocated, cached, passed to callbacks or decoded.\n
+ *		For Type 1 packets (DID 80h-83h) the second word is a DBN, subscribe to each DBN of interest.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	uint8_t did - Data Identifier.
+ * @param[in]	uint8_t sdid - Secondary Data Identifier.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_subscribe(struct vanc_context_s *ctx, uint8_t did, uint8_t sdid);
+
+/**
+ * @brief	Remove a single DID/SDID subscription. See vanc_context_subscribe().
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	uint8_t did - Data Identifier.
+ * @param[in]	uint8_t sdid - Secondary Data Identifier.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_unsubscribe(struct vanc_context_s *ctx, uint8_t did, uint8_t sdid);
+
+/**
+ * @brief	Discard all subscriptions, the context goes back to processing every packet.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ */
+void vanc_context_subscribe_all(struct vanc_context_s *ctx);
+
+/**
+ * @brief	Only process packets found on lines firstLine through lastLine inclusive,\n
+ *		lines outside the range aren't scanned at all. Pass 0, 0 to process every line.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	unsigned int firstLine - First line of interest.
+ * @param[in]	unsigned int lastLine - Last line of interest.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_set_line_range(struct vanc_context_s *ctx, unsigned int firstLine, unsigned int lastLine);
+
+/**
+ * @brief	By default packets with a bad checksum, or a parity error in the DID, SDID/DBN or DC\n
+ *		word, are still delivered (with checksumValid set accordingly) and only counted, see\n
+ *		vanc_context_get_stats(). In strict mode they are dropped as soon as they're validated,\n
+ *		they are never cached, passed to callbacks or decoded. Decoders that carry their own\n
+ *		integrity checks, like the CDP checksum, also reject packets that fail them.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	int enable - 1 to enable, 0 to disable.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_set_strict(struct vanc_context_s *ctx, int enable);
+
+/**
+ * @brief	Deliver packets of a DID/SDID only when they change. Many types repeat every\n
+ *		frame with an identical payload, AFD or caption padding for example. With change\n
+ *		only delivery enabled, the context remembers a hash of the last packet seen on each\n
+ *		line, and a packet identical to it is counted (see vanc_stats_s changeOnlySkipped)\n
+ *		then dropped, it's never cached, passed to callbacks or decoded. The hash covers the\n
+ *		whole raw packet, except for CEA-708 CDPs (0x61/0x01), where the header and footer\n
+ *		sequence counters, any time_code_section, the CDP checksum and the packet checksum\n
+ *		are left out. A CDP that differs from the last one only in its sequence count and\n
+ *		time code, caption padding for example, is dropped too, so sequence_discontinuity\n
+ *		flags the gaps this leaves. Unchanged packets are still delivered once every refresh\n
+ *		interval, see vanc_context_set_change_only_refresh().\n
+ *		Decoders that keep state between packets, the CEA-608 caption decoder for example,\n
+ *		only see what's delivered. Don't enable it for types where repeats carry meaning.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	uint8_t did - Data Identifier.
+ * @param[in]	uint8_t sdid - Secondary Data Identifier.
+ * @param[in]	int enable - 1 to enable, 0 to deliver every packet again (the default).
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_set_change_only(struct vanc_context_s *ctx, uint8_t did, uint8_t sdid, int enable);
+
+/**
+ * @brief	How often an unchanged packet is delivered anyway, in change only mode. Measured\n
+ *		on the library clock (see clock.h), per DID/SDID and line.
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	unsigned int refreshMs - Interval, the default is 1000ms. 0 never refreshes.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_context_set_change_only_refresh(struct vanc_context_s *ctx, unsigned int refreshMs);
+
 /**
  * @brief	Parse a line of payload, trigger callbacks as necessary. lineNr is passed around and only\n
  *		used for reporting purposes, so we can figure out which line this came from in different\n
@@ -164,6 +303,20 @@ int vanc_context_dump(struct vanc_context_s *ctx);
  */
 int vanc_packet_parse(struct vanc_context_s *ctx, unsigned int lineNr, unsigned short *words, unsigned int wordCount);
 
+/**
+ * @brief	Scan a line of payload and deliver a zero-copy struct packet_view_s for every valid\n
+ *		packet found, via the view callback. Nothing is allocated or copied, packets are\n
+ *		not cached and are not decoded by type. The views point directly into words and\n
+ *		are only valid during the callback, see vanc_packet_view_clone().
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	unsigned int lineNr - SDI line number the array data came from. Used for information / tracking purposes only.
+ * @param[in]	unsigned short *words - Array of SDI words (10bit) that the caller wants parsed.
+ * @param[in]	unsigned int wordCount - Number of words in array.
+ * @return      >= 0 - Number of packets found
+ * @return      < 0 - Error
+ */
+int vanc_packet_parse_views(struct vanc_context_s *ctx, unsigned int lineNr, unsigned short *words, unsigned int wordCount);
+
 /**
  * @brief	TODO - Brief description goes here.
  * @param[in]	uint16_t *array - Array of SDI words (10bit) that the caller wants parsed.
@@ -184,6 +337,11 @@ void vanc_dump_words_console(uint16_t *vanc, int maxlen, unsigned int linenr, in
 #include <libklvanc/smpte2038.h>
 #include <libklvanc/cache.h>
 #include <libklvanc/vanc-kl_u64le_counter.h>
+#include <libklvanc/vanc-smpte_12_2.h>
+#include <libklvanc/vanc-frame.h>
+#include <libklvanc/buffer.h>
+#include <libklvanc/stats.h>
+#include <libklvanc/log.h>
 
 /**
  * @brief	Take an array of payload, create a fully formed VANC message.
@@ -204,6 +362,22 @@ int vanc_sdi_create_payload(uint8_t sdid, uint8_t did,
 	uint16_t **dst, uint16_t *dstWordCount,
 	uint32_t bitDepth);
 
+/**
+ * @brief	Frame a payload as a complete VANC packet, without allocating.\n
+ *		Writes ADF, DID, SDID, DC, the UDWs and the checksum into the caller's buffer,\n
+ *		computing parity and the checksum as it goes. No padding is added.
+ * @param[in]	uint8_t did, uint8_t sdid - Packet identifiers.
+ * @param[in]	const uint8_t *src - User data, up to 255 bytes.
+ * @param[in]	unsigned int srcByteCount - Number of bytes in src.
+ * @param[out]	uint16_t *words - Destination, at least srcByteCount + 7 words.
+ * @param[in]	unsigned int wordCount - Size of words.
+ * @return	> 0 - Number of words written
+ * @return	-ENOSPC - words is too small
+ * @return	-EINVAL - Bad arguments
+ */
+int vanc_encode_packet(uint8_t did, uint8_t sdid, const uint8_t *src, unsigned int srcByteCount,
+	uint16_t *words, unsigned int wordCount);
+
 /**
  * @brief	TODO - Brief description goes here.
  * @param[in]	enum packet_type_e type
@@ -232,6 +406,40 @@ int vanc_packet_copy(struct packet_header_s **dst, struct packet_header_s *src);
  */
 void vanc_packet_free(struct packet_header_s *src);
 
+/**
+ * @brief	Register a decoder for a DID/SDID, replacing any existing (including built in) decoder\n
+ *		for that DID/SDID on this context. Dispatch is by direct lookup, so the number of\n
+ *		registered decoders doesn't affect per packet cost. Packets handled by a registered\n
+ *		decoder carry the type VANC_TYPE_USER.\n
+ *		parse() receives the packet header and returns its decoded struct through pp, it's\n
+ *		also responsible for firing any application callbacks. dump() is called for\n
+ *		decoded packets when ctx->verbose == 2. free() releases the decoded struct, if NULL\n
+ *		the library calls free() on it (it must then be a single heap allocation).
+ * @param[in]	struct vanc_context_s *ctx - Context.
+ * @param[in]	uint8_t did - Data Identifier.
+ * @param[in]	uint8_t sdid - Secondary Data Identifier.
+ * @param[in]	parse - Mandatory, returns 0 on success.
+ * @param[in]	dump - Optional.
+ * @param[in]	free - Optional.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_register_decoder(struct vanc_context_s *ctx, uint8_t did, uint8_t sdid,
+	int (*parse)(struct vanc_context_s *ctx, struct packet_header_s *hdr, void **pp),
+	int (*dump)(struct vanc_context_s *ctx, void *p),
+	void (*free)(struct vanc_context_s *ctx, void *p));
+
+/**
+ * @brief	Materialize a packet view into a newly allocated struct packet_header_s.\n
+ *		This is the only point at which the view API allocates or copies, release\n
+ *		the result with vanc_packet_free().
+ * @param[out]	struct packet_header_s **dst - Newly allocated packet.
+ * @param[in]	const struct packet_view_s *src - View, typically received via the view callback.
+ * @return      0 - Success
+ * @return      < 0 - Error
+ */
+int vanc_packet_view_clone(struct packet_header_s **dst, const struct packet_view_s *src);
+
 #ifdef __cplusplus
 };
 #endif
@@ -25,15 +25,28 @@
 #include <string.h>
 #include <inttypes.h>
 #include <libklvanc/smpte2038.h>
+#include <libklvanc/vanc-checksum.h>
+#include <libklvanc/log.h>
 
 #define VANC8(n) ((n) & 0xff)
+#define SMPTE2038_PACKETIZER_DEBUG 0
 
-#if 0
+#if SMPTE2038_PACKETIZER_DEBUG
 static void hexdump(unsigned char *buf, unsigned int len, int bytesPerRow /* Typically 16 */)
 {
-        for (unsigned int i = 0; i < len; i++)
-                printf("%02x%s", buf[i], ((i + 1) % bytesPerRow) ? " " : "\n");
-        printf("\n");
+	char row[3 * 64 + 1];
+	int n = 0;
+
+	row[0] = 0;
+	for (unsigned int i = 0; i < len; i++) {
+		n += snprintf(row + n, sizeof(row) - n, "%02x ", buf[i]);
+		if (((i + 1) % bytesPerRow) == 0 || n >= (int)sizeof(row) - 3) {
+			vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_SMPTE2038, "%s\n", row);
+			n = 0;
+			row[0] = 0;
+		}
+	}
+	vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_SMPTE2038, "%s\n", row);
 }
 #endif
 
@@ -53,12 +66,12 @@ void smpte2038_anc_data_packet_free(struct smpte2038_anc_data_packet_s *pkt)
 	free(pkt);
 }
 
-#define SHOW_LINE_U32(indent, fn) printf("%s%s = %d (0x%x)\n", indent, #fn, fn, fn);
-#define SHOW_LINE_U64(indent, fn) printf("%s%s = %" PRIu64 " (0x%" PRIx64 ")\n", indent, #fn, fn, fn);
+#define SHOW_LINE_U32(indent, fn) vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s%s = %d (0x%x)\n", indent, #fn, fn, fn);
+#define SHOW_LINE_U64(indent, fn) vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s%s = %" PRIu64 " (0x%" PRIx64 ")\n", indent, #fn, fn, fn);
 
 void smpte2038_anc_data_packet_dump(struct smpte2038_anc_data_packet_s *h)
 {
-	printf("%s()\n", __func__);
+	vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "%s()\n", __func__);
 	SHOW_LINE_U32("  ", h->packet_start_code_prefix);
 	SHOW_LINE_U32("  ", h->stream_id);
 	SHOW_LINE_U32("  ", h->PES_packet_length);
@@ -79,25 +92,31 @@ void smpte2038_anc_data_packet_dump(struct smpte2038_anc_data_packet_s *h)
 	SHOW_LINE_U32("  ", h->lineCount);
 	for (int i = 0; i < h->lineCount; i++) {
 		struct smpte2038_anc_data_line_s *l = &h->lines[i];
-		printf("  LineEntry[%02d]\n", i);
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "  LineEntry[%02d]\n", i);
 		SHOW_LINE_U32("\t\t", l->line_number);
 		SHOW_LINE_U32("\t\t", l->c_not_y_channel_flag);
 		SHOW_LINE_U32("\t\t", l->horizontal_offset);
 		SHOW_LINE_U32("\t\t", l->DID);
 		SHOW_LINE_U32("\t\t", l->SDID);
 		SHOW_LINE_U32("\t\t", l->data_count);
-		printf("\t\t\t");
+		/* 16 words per row, 4 characters each. */
+		char row[4 * 16 + 1];
+		int n = 0;
+		row[0] = 0;
 		for (int j = 1; j <= VANC8(l->data_count); j++) {
-			printf("%03x ", l->user_data_words[j - 1]);
-			if (j % 16 == 0)
-				printf("\n\t\t\t");
+			n += snprintf(row + n, sizeof(row) - n, "%03x ", l->user_data_words[j - 1]);
+			if (j % 16 == 0) {
+				vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "\t\t\t%s\n", row);
+				n = 0;
+				row[0] = 0;
+			}
 		}
-		printf("\n");
+		vanc_log(VANC_LOG_INFO, VANC_LOG_CAT_DUMP, "\t\t\t%s\n", row);
 		SHOW_LINE_U32("\t\t", l->checksum_word);
 	}
 }
 
-#define VALIDATE(obj, val) if ((obj) != (val)) { printf("%s is invalid\n", #obj); goto err; }
+#define VALIDATE(obj, val) if ((obj) != (val)) { vanc_log(VANC_LOG_WARN, VANC_LOG_CAT_SMPTE2038, "%s is invalid\n", #obj); goto err; }
 int smpte2038_parse_pes_packet(uint8_t *section, unsigned int byteCount, struct smpte2038_anc_data_packet_s **result)
 {
 	int ret = -1;
@@ -207,8 +226,6 @@ err:
 }
 
 #define SMPTE2038_PACKETIZER_BUFFER_RESET_OFFSET 14
-#define SMPTE2038_PACKETIZER_DEBUG 0
-
 int smpte2038_packetizer_alloc(struct smpte2038_packetizer_s **ctx)
 {
 	struct smpte2038_packetizer_s *p = calloc(1, sizeof(*p));
@@ -238,10 +255,10 @@ static __inline void smpte2038_buffer_recalc(struct smpte2038_packetizer_s *ctx)
 static void smpte2038_buffer_adjust(struct smpte2038_packetizer_s *ctx, uint32_t newsizeBytes)
 {
 #if SMPTE2038_PACKETIZER_DEBUG
-	printf("%s(%d)\n", __func__, newsizeBytes);
+	vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_SMPTE2038, "%s(%d)\n", __func__, newsizeBytes);
 #endif
 	if (newsizeBytes > (128 * 1024)) {
-		fprintf(stderr, "%s() buffer exceeds impossible limit, with %d additional bytes\n", __func__, newsizeBytes);
+		vanc_log(VANC_LOG_ERR, VANC_LOG_CAT_SMPTE2038, "%s() buffer exceeds impossible limit, with %d additional bytes\n", __func__, newsizeBytes);
 		abort();
 	}
 	ctx->buf = realloc(ctx->buf, newsizeBytes);
@@ -279,7 +296,7 @@ int smpte2038_packetizer_begin(struct smpte2038_packetizer_s *ctx)
 int smpte2038_packetizer_append(struct smpte2038_packetizer_s *ctx, struct packet_header_s *pkt)
 {
 #if SMPTE2038_PACKETIZER_DEBUG
-	printf("%s()\n", __func__);
+	vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_SMPTE2038, "%s()\n", __func__);
 #endif
 	uint16_t offset = 0; /* TODO: Horizontal offset */
 	uint32_t reqd = pkt->payloadLengthWords * sizeof(uint16_t);
@@ -315,7 +332,7 @@ int smpte2038_packetizer_append(struct smpte2038_packetizer_s *ctx, struct packe
 	ctx->bufused += klbs_get_byte_count(ctx->bs);
 	smpte2038_buffer_recalc(ctx);
 #if SMPTE2038_PACKETIZER_DEBUG
-	printf("bufused = %d buffree = %d\n", ctx->bufused, ctx->buffree);
+	vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_SMPTE2038, "bufused = %d buffree = %d\n", ctx->bufused, ctx->buffree);
 #endif
 	return 0;
 }
@@ -326,7 +343,7 @@ int smpte2038_packetizer_end(struct smpte2038_packetizer_s *ctx, uint64_t pts)
 	if (ctx->bufused == SMPTE2038_PACKETIZER_BUFFER_RESET_OFFSET)
 		return -1;
 #if SMPTE2038_PACKETIZER_DEBUG
-	printf("%s() used = %d\n", __func__, ctx->bufused);
+	vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_SMPTE2038, "%s() used = %d\n", __func__, ctx->bufused);
 #endif
 	/* Now generate a correct looking PES frame and output it */
 	/* See smpte 2038-2008 - Page 5, Table 2 for description. */
@@ -372,22 +389,15 @@ int smpte2038_packetizer_end(struct smpte2038_packetizer_s *ctx, uint64_t pts)
 
 #if SMPTE2038_PACKETIZER_DEBUG
 	hexdump(ctx->buf, ctx->bufused, 32);
-	printf("%d buffer length\n", ctx->bufused);
-	printf("%d bs used\n", ctx->bs->reg_used);
+	vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_SMPTE2038, "%d buffer length\n", ctx->bufused);
+	vanc_log(VANC_LOG_DEBUG, VANC_LOG_CAT_SMPTE2038, "%d bs used\n", ctx->bs->reg_used);
 #endif
 
 	return 0;
 }
 
-int smpte2038_convert_line_to_words(struct smpte2038_anc_data_line_s *l, uint16_t **words, uint16_t *wordCount)
+static int convert_line(struct smpte2038_anc_data_line_s *l, uint16_t *arr)
 {
-	if (!l || !words || !wordCount)
-		return -1;
-
-	uint16_t *arr = malloc((7 + VANC8(l->data_count)) * sizeof(uint16_t));
-	if (!arr)
-		return -ENOMEM;
-
 	int i = 0;
 	arr[i++] = 0;
 	arr[i++] = 0x3ff;
@@ -402,24 +412,51 @@ int smpte2038_convert_line_to_words(struct smpte2038_anc_data_line_s *l, uint16_
 	if (l->DID & 0x300)
 		arr[i++] = l->DID;
 	else
-		arr[i++] = l->DID | (__builtin_parity(l->DID) ? 0x100 : 0x200);
+		arr[i++] = vanc_parity_word(l->DID);
 
 	if (l->SDID & 0x300)
 		arr[i++] = l->SDID;
 	else
-		arr[i++] = l->SDID | (__builtin_parity(l->SDID) ? 0x100 : 0x200);
+		arr[i++] = vanc_parity_word(l->SDID);
 
 	if (l->data_count & 0x300)
 		arr[i++] = l->data_count;
 	else
-		arr[i++] = l->data_count | (__builtin_parity(l->data_count) ? 0x100 : 0x200);
+		arr[i++] = vanc_parity_word(l->data_count);
 
 	for (int j = 0; j < VANC8(l->data_count); j++)
 		arr[i++] = l->user_data_words[j];
 	arr[i++] = l->checksum_word;
 
+	return i;
+}
+
+int smpte2038_convert_line_to_words(struct smpte2038_anc_data_line_s *l, uint16_t **words, uint16_t *wordCount)
+{
+	if (!l || !words || !wordCount)
+		return -1;
+
+	uint16_t *arr = malloc((7 + VANC8(l->data_count)) * sizeof(uint16_t));
+	if (!arr)
+		return -ENOMEM;
+
 	*words = arr;
-	*wordCount = i;
+	*wordCount = convert_line(l, arr);
 	return 0;
 }
 
+int smpte2038_convert_line_to_buffer(struct smpte2038_anc_data_line_s *l, struct buffer_s **buf)
+{
+	if (!l || !buf)
+		return -1;
+
+	struct buffer_s *b;
+	if (vanc_buffer_alloc(NULL, &b, (7 + VANC8(l->data_count)) * sizeof(uint16_t)) < 0)
+		return -ENOMEM;
+
+	b->used = convert_line(l, (uint16_t *)b->ptr) * sizeof(uint16_t);
+	b->nr = l->line_number;
+
+	*buf = b;
+	return 0;
+}
@@ -84,13 +84,23 @@ static int g_packetizeSMPTE2038 = 0;
 static int g_packetizePID = 0;
 static struct smpte2038_packetizer_s *smpte2038_ctx = 0;
 static uint8_t g_cc = 0;
+static int g_workerThreads = 0;
+static int g_parserStats = 0;
+static int g_captionChannel = 0;
 /* END:SMPTE 2038 */
 
+/* SCTE-35 */
+static int g_scte35PID = 0;
+static uint8_t g_scte35cc = 0;
+static int64_t g_vancStreamTime = VANC_NOPTS_VALUE;
+/* END:SCTE-35 */
+
 static IDeckLink *deckLink;
 static IDeckLinkInput *deckLinkInput;
 static IDeckLinkDisplayModeIterator *displayModeIterator;
 
 static BMDTimecodeFormat g_timecodeFormat = 0;
+static int g_timecodeATC = 0;
 static int g_videoModeIndex = -1;
 static uint32_t g_audioChannels = 2;
 static uint32_t g_audioSampleDepth = 16;
@@ -98,6 +108,7 @@ static const char *g_videoOutputFilename = NULL;
 static const char *g_audioOutputFilename = NULL;
 static const char *g_vancOutputFilename = NULL;
 static const char *g_vancInputFilename = NULL;
+static const char *g_pixelTestFilename = NULL;
 static int g_maxFrames = -1;
 static int g_shutdown = 0;
 static int g_monitor_reset = 0;
@@ -463,22 +474,189 @@ static void convert_colorspace_and_parse_vanc(unsigned char *buf, unsigned int u
 
 	/* Convert Blackmagic pixel format to nv20.
 	 * src pointer gets mangled during conversion, hence we need its own
-	 * ptr instead of passing vbiBufferPtr */
-	uint16_t decoded_words[16384];
-	memset(&decoded_words[0], 0, sizeof(decoded_words));
-	uint16_t *p_anc = decoded_words;
-	if (klvanc_v210_line_to_nv20_c(src, p_anc, sizeof(decoded_words), (uiWidth / 6) * 6) < 0)
+	 * ptr instead of passing vbiBufferPtr.
+	 * The conversion writes every luma and chroma word we parse, so the
+	 * recycled buffer doesn't need clearing.
+	 */
+	unsigned int width = (uiWidth / 6) * 6;
+	if (klvanc_v210_line_find_adf(src, width) < 0) {
+		/* No VANC on this line */
 		return;
+	}
 
-	int ret = vanc_packet_parse(vanchdl, lineNr, decoded_words, sizeof(decoded_words) / (sizeof(unsigned short)));
+	struct buffer_s *decoded;
+	if (vanc_buffer_alloc(NULL, &decoded, 16384 * sizeof(uint16_t)) < 0)
+		return;
+
+	uint16_t *p_anc = (uint16_t *)decoded->ptr;
+	if (klvanc_v210_line_to_nv20(src, p_anc, decoded->size, width) < 0) {
+		vanc_buffer_free(decoded);
+		return;
+	}
+
+	int ret = vanc_packet_parse(vanchdl, lineNr, p_anc, width * 2);
 	if (ret < 0) {
 		/* No VANC on this line */
 	}
+
+	vanc_buffer_free(decoded);
+}
+
+/* When the library worker pool is enabled (-j), lines are collected for the whole
+ * frame and handed to the library in one go via vanc_frame_parse().
+ */
+static struct buffer_s **g_frameBufs = 0;
+static struct vanc_frame_line_s *g_frameLines = 0;
+static unsigned int g_frameLineCount = 0;
+static unsigned int g_frameLinesAllocated = 0;
+
+static void frame_add_line(const unsigned char *buf, unsigned int len, unsigned int uiWidth, unsigned int lineNr)
+{
+	if (g_frameLineCount == g_frameLinesAllocated) {
+		unsigned int n = g_frameLinesAllocated ? g_frameLinesAllocated * 2 : 32;
+		struct buffer_s **bufs = (struct buffer_s **)realloc(g_frameBufs, n * sizeof(*g_frameBufs));
+		if (!bufs)
+			return;
+		g_frameBufs = bufs;
+
+		struct vanc_frame_line_s *lines = (struct vanc_frame_line_s *)realloc(g_frameLines, n * sizeof(*g_frameLines));
+		if (!lines)
+			return;
+		g_frameLines = lines;
+		g_frameLinesAllocated = n;
+	}
+
+	/* Held until the frame has been parsed, then recycled for the next frame. */
+	struct buffer_s *fb;
+	if (vanc_buffer_alloc(NULL, &fb, len) < 0)
+		return;
+	memcpy(fb->ptr, buf, len);
+	fb->used = len;
+	fb->nr = lineNr;
+	g_frameBufs[g_frameLineCount] = fb;
+
+	struct vanc_frame_line_s *l = &g_frameLines[g_frameLineCount++];
+	memset(l, 0, sizeof(*l));
+	l->lineNr = lineNr;
+	l->v210 = (const uint32_t *)fb->ptr;
+	l->v210Width = uiWidth;
+}
+
+static void frame_parse_vanc(int64_t streamTime)
+{
+	if (g_frameLineCount == 0)
+		return;
+
+	struct vanc_frame_s frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.lines = g_frameLines;
+	frame.lineCount = g_frameLineCount;
+	frame.pts = VANC_NOPTS_VALUE;
+	frame.streamTime = streamTime;
+
+	vanc_frame_parse(vanchdl, &frame);
+
+	for (unsigned int i = 0; i < g_frameLineCount; i++)
+		vanc_buffer_free(g_frameBufs[i]);
+	g_frameLineCount = 0;
 }
 
 #define VANC_SOL_INDICATOR 0xEFBEADDE
 #define VANC_EOL_INDICATOR 0xEDFEADDE
 #define TS_OUTPUT_NAME "/tmp/smpte2038-sample.ts"
+#define SCTE35_OUTPUT_NAME "/tmp/scte35-sample.ts"
+/* Check the SIMD pixel kernels produce exactly what the C reference does, on every line of a -V file. */
+static int SelfTestPixels(const char *fn)
+{
+	FILE *fh = fopen(fn, "rb");
+	if (!fh) {
+		fprintf(stderr, "Unable to open [%s]\n", fn);
+		return -1;
+	}
+
+	unsigned int maxbuflen = 16384;
+	unsigned char *buf = (unsigned char *)malloc(maxbuflen);
+	unsigned int bytes = maxbuflen * 4;
+	uint16_t *ref = (uint16_t *)malloc(bytes);
+	uint16_t *simd = (uint16_t *)malloc(bytes);
+	unsigned int lines = 0, mismatches = 0;
+
+	while (1) {
+		/* Warning: Balance these reads with the file writes in processVANC */
+		unsigned int hdr[5], uiEOL;
+		if (fread(hdr, sizeof(hdr), 1, fh) != 1)
+			break;
+		unsigned int uiLine = hdr[1], uiWidth = hdr[2], uiStride = hdr[4];
+		if (uiStride >= maxbuflen || fread(buf, uiStride, 1, fh) != 1 || fread(&uiEOL, sizeof(uiEOL), 1, fh) != 1)
+			break;
+		if (((uiWidth + 5) / 6) * 16 > uiStride)
+			continue;
+
+		const uint32_t *src = (const uint32_t *)buf;
+		unsigned int width = (uiWidth / 6) * 6;
+		int failed = 0;
+
+		memset(ref, 0, bytes);
+		memset(simd, 0, bytes);
+		klvanc_v210_line_to_nv20_c(src, ref, bytes, width);
+		klvanc_v210_line_to_nv20(src, simd, bytes, width);
+		if (memcmp(ref, simd, width * 2 * sizeof(uint16_t)))
+			failed |= 1;
+
+		/* Pack the unpacked line back up, both ways. */
+		uint32_t *v210ref = (uint32_t *)(ref + (width * 3));
+		uint32_t *v210simd = (uint32_t *)(simd + (width * 3));
+		klvanc_nv20_line_to_v210_c(ref, v210ref, KLVANC_V210_LINE_BYTES(width), width);
+		klvanc_nv20_line_to_v210(ref, v210simd, KLVANC_V210_LINE_BYTES(width), width);
+		if (memcmp(v210ref, v210simd, KLVANC_V210_LINE_BYTES(width)))
+			failed |= 2;
+
+		memset(ref, 0, bytes);
+		memset(simd, 0, bytes);
+		klvanc_v210_line_to_uyvy_c((uint32_t *)src, ref, uiWidth);
+		klvanc_v210_line_to_uyvy(src, simd, uiWidth);
+		if (memcmp(ref, simd, bytes))
+			failed |= 4;
+
+		/* And the UYVY line back to v210, both ways. */
+		v210ref = (uint32_t *)(ref + (((uiWidth + 5) / 6) * 12));
+		v210simd = (uint32_t *)(simd + (((uiWidth + 5) / 6) * 12));
+		klvanc_uyvy16_line_to_v210_c(ref, v210ref, KLVANC_V210_LINE_BYTES(uiWidth), uiWidth);
+		klvanc_uyvy16_line_to_v210(ref, v210simd, KLVANC_V210_LINE_BYTES(uiWidth), uiWidth);
+		if (memcmp(v210ref, v210simd, KLVANC_V210_LINE_BYTES(uiWidth)))
+			failed |= 16;
+
+		memset(ref, 0, bytes);
+		memset(simd, 0, bytes);
+		klvanc_v210_planar_unpack_c(src, ref, ref + uiWidth, ref + (uiWidth * 2), uiWidth);
+		klvanc_v210_planar_unpack(src, simd, simd + uiWidth, simd + (uiWidth * 2), uiWidth);
+		if (memcmp(ref, simd, bytes))
+			failed |= 8;
+
+		if (klvanc_v210_line_find_adf_c(src, width) != klvanc_v210_line_find_adf(src, width))
+			failed |= 32;
+
+		if (failed) {
+			fprintf(stdout, "Line: %04d Width: %d mismatch%s%s%s%s%s%s\n", uiLine, uiWidth,
+				failed & 1 ? " nv20" : "", failed & 2 ? " v210-pack" : "",
+				failed & 4 ? " uyvy" : "", failed & 8 ? " planar" : "",
+				failed & 16 ? " uyvy-pack" : "", failed & 32 ? " find-adf" : "");
+			mismatches++;
+		}
+		lines++;
+	}
+
+	fprintf(stdout, "Pixel self-test [%s] %s kernels: %d lines, %d mismatches\n",
+		fn, klvanc_pixels_isa(), lines, mismatches);
+
+	free(simd);
+	free(ref);
+	free(buf);
+	fclose(fh);
+
+	return mismatches ? -1 : 0;
+}
+
 static int AnalyzeVANC(const char *fn)
 {
 	FILE *fh = fopen(fn, "rb");
@@ -528,6 +706,10 @@ static int AnalyzeVANC(const char *fn)
 		if (g_verbose > 1)
 			hexdump(buf, uiStride, 64);
 
+		/* Line numbers restart with each frame, parse everything we collected for the last one. */
+		if (g_workerThreads && g_frameLineCount && uiLine <= g_frameLines[g_frameLineCount - 1].lineNr)
+			frame_parse_vanc(VANC_NOPTS_VALUE);
+
 		if (uiLine == 1 && g_packetizeSMPTE2038) {
 			if (smpte2038_packetizer_end(smpte2038_ctx, 0) == 0) {
 				printf("%s() PES buffer is complete\n", __func__);
@@ -550,8 +732,12 @@ static int AnalyzeVANC(const char *fn)
 			}
 			smpte2038_packetizer_begin(smpte2038_ctx);
 		}
-		convert_colorspace_and_parse_vanc(buf, uiStride, uiLine);
+		if (g_workerThreads)
+			frame_add_line(buf, maxbuflen, uiStride, uiLine);
+		else
+			convert_colorspace_and_parse_vanc(buf, uiStride, uiLine);
 	}
+	frame_parse_vanc(VANC_NOPTS_VALUE);
 
 	free(buf);
 	fclose(fh);
@@ -578,6 +764,13 @@ static void ProcessVANC(IDeckLinkVideoInputFrame * frame)
 	if (g_packetizeSMPTE2038)
 		smpte2038_packetizer_begin(smpte2038_ctx);
 
+	if (g_scte35PID) {
+		BMDTimeValue stream_time;
+		BMDTimeValue frame_duration;
+		frame->GetStreamTime(&stream_time, &frame_duration, 90000);
+		g_vancStreamTime = stream_time;
+	}
+
 	BMDDisplayMode dm = vanc->GetDisplayMode();
 	BMDPixelFormat pf = vanc->GetPixelFormat();
 
@@ -599,7 +792,10 @@ static void ProcessVANC(IDeckLinkVideoInputFrame * frame)
 		/* Process the line colorspace, hand-off to the vanc library for parsing
 		 * and prepare to receive callbacks.
 		 */
-		convert_colorspace_and_parse_vanc(buf, uiWidth, uiLine);
+		if (g_workerThreads)
+			frame_add_line(buf, uiStride, uiWidth, uiLine);
+		else
+			convert_colorspace_and_parse_vanc(buf, uiWidth, uiLine);
 
 		if (vancOutputFile >= 0) {
 			/* Warning: Balance these writes with the file reads in AnalyzeVANC */
@@ -679,6 +875,13 @@ static void ProcessVANC(IDeckLinkVideoInputFrame * frame)
 
 	}
 
+	if (g_workerThreads) {
+		BMDTimeValue stream_time;
+		BMDTimeValue frame_duration;
+		frame->GetStreamTime(&stream_time, &frame_duration, 90000);
+		frame_parse_vanc(stream_time);
+	}
+
 	if (g_packetizeSMPTE2038) {
 		BMDTimeValue stream_time;
 		BMDTimeValue frame_duration;
@@ -987,12 +1190,44 @@ static int cb_EIA_608(void *callback_context, struct vanc_context_s *ctx, struct
 	return 0;
 }
 
+static void scte35_output(struct packet_scte_104_s *pkt)
+{
+	/* A section starts in the payload after a pointer_field, which the packetizer doesn't add. */
+	uint8_t section[1 + SCTE_35_SECTION_MAX];
+	unsigned int sectionLength = 0;
+
+	section[0] = 0;
+	int ret = scte_104_to_scte_35(pkt, g_vancStreamTime, section + 1, sizeof(section) - 1, &sectionLength);
+	if (ret < 0) {
+		if (ret != -ENOTSUP)
+			fprintf(stderr, "Unable to convert SCTE-104 message to SCTE-35, ret = %d\n", ret);
+		return;
+	}
+
+	uint8_t *pkts = 0;
+	uint32_t packetCount = 0;
+	if (ts_packetizer(section, 1 + sectionLength, &pkts, &packetCount, 188, &g_scte35cc, g_scte35PID) < 0)
+		return;
+
+	FILE *fh = fopen(SCTE35_OUTPUT_NAME, "a+");
+	if (fh) {
+		if (g_verbose)
+			printf("Writing %d SCTE-35 TS packet(s) to %s\n", packetCount, SCTE35_OUTPUT_NAME);
+		fwrite(pkts, packetCount, 188, fh);
+		fclose(fh);
+	}
+	free(pkts);
+}
+
 static int cb_SCTE_104(void *callback_context, struct vanc_context_s *ctx, struct packet_scte_104_s *pkt)
 {
 	/* Have the library display some debug */
 	if (!g_monitor_mode)
 		dump_SCTE_104(ctx, pkt);
 
+	if (g_scte35PID)
+		scte35_output(pkt);
+
 	return 0;
 }
 
@@ -1009,6 +1244,24 @@ static int cb_all(void *callback_context, struct vanc_context_s *ctx, struct pac
 		}
 	}
 
+	if (g_timecodeATC && !g_monitor_mode) {
+		if (pkt->timecode.valid)
+			printf("[%02d:%02d:%02d%c%02d] ", pkt->timecode.hours, pkt->timecode.minutes,
+				pkt->timecode.seconds, pkt->timecode.dropFrame ? ';' : ':', pkt->timecode.frames);
+		else
+			printf("[--:--:--:--] ");
+		printf("Line %d DID 0x%02x SDID 0x%02x\n", pkt->lineNr, pkt->did & 0xff, pkt->dbnsdid & 0xff);
+	}
+
+	return 0;
+}
+
+static int cb_SMPTE_12_2(void *callback_context, struct vanc_context_s *ctx, struct packet_smpte_12_2_s *pkt)
+{
+	/* Have the library display some debug */
+	if (!g_monitor_mode && g_verbose)
+		dump_SMPTE_12_2(ctx, pkt);
+
 	return 0;
 }
 
@@ -1033,6 +1286,21 @@ static int cb_VANC_TYPE_KL_UINT64_COUNTER(void *callback_context, struct vanc_co
 	return 0;
 }
 
+static int cb_EIA_608_event(void *callback_context, struct vanc_context_s *ctx, const struct eia_608_event_s *ev)
+{
+	if (ev->type != EIA_608_EVENT_SCREEN || ev->channel != g_captionChannel)
+		return 0;
+
+	char row[(EIA_608_COLUMNS * 3) + 1];
+	printf("CC%d:\n", ev->channel);
+	for (int i = 0; i < EIA_608_ROWS; i++) {
+		if (eia_608_screen_row_to_utf8(ev->screen, i, row, sizeof(row)) > 0)
+			printf("  %02d: %s\n", i + 1, row);
+	}
+
+	return 0;
+}
+
 static struct vanc_callbacks_s callbacks =
 {
 	.payload_information    = cb_PAYLOAD_INFORMATION,
@@ -1041,6 +1309,8 @@ static struct vanc_callbacks_s callbacks =
 	.scte_104               = cb_SCTE_104,
 	.all                    = cb_all,
 	.kl_i64le_counter       = cb_VANC_TYPE_KL_UINT64_COUNTER,
+	.eia_608_event          = cb_EIA_608_event,
+	.smpte_12_2             = cb_SMPTE_12_2,
 };
 
 /* END - CALLBACKS for message notification */
@@ -1089,11 +1359,16 @@ static int usage(const char *progname, int status)
 		"        rp188:  RP 188\n"
 		"         vitc:  VITC\n"
 		"       serial:  Serial Timecode\n"
+		"          atc:  SMPTE 12M-2 ancillary timecode from the VANC, printed with each VANC packet\n"
 		"    -f <filename>   raw video output filename\n"
 		"    -a <filename>   raw audio output filanem\n"
 		"    -V <filename>   raw vanc output filename\n"
 		"    -I <filename>   Interpret and display input VANC filename (See -V)\n"
 		"    -l <linenr>     During -I parse, process a specific line# (def: 0 all)\n"
+		"    -X <filename>   Self-test the SIMD v210 kernels against the C reference on a VANC file (See -V)\n"
+		"    -j <threads>    Parse each frame of VANC using a pool of worker threads (def: 0 disabled)\n"
+		"    -S              Time the VANC parser and display its statistics on exit\n"
+		"    -C <channel>    Decode and display CEA-608 captions from channel 1-4 as they change\n"
 		"    -L              List availalble display modes\n"
 		"    -c <channels>   Audio Channels (2, 8 or 16 - def: 2)\n"
 		"    -s <depth>      Audio Sample Depth (16 or 32 - def: 16)\n"
@@ -1103,6 +1378,8 @@ static int usage(const char *progname, int status)
 		"    -i <number>     Capture from input port (def: 0)\n"
 		"    -P pid 0xNNNN   Packetsize all detected VANC into SMPTE2038 TS packets using pid.\n"
 		"                    The packets are store in file %s\n"
+		"    -T pid 0xNNNN   Convert SCTE-104 messages to SCTE-35 and write them as TS packets on pid.\n"
+		"                    The packets are stored in file %s\n"
 		"    -M              During VANC capture, display a Curses onscreen UI.\n"
 		"\n"
 		"Capture and display all VANC messages and show line/msg counts in an interactive UI (1080i 59.94):\n"
@@ -1115,6 +1392,7 @@ static int usage(const char *progname, int status)
 		"    %s -m13 -p1 -V vanc.raw\n"
 		"    %s          -I vanc.raw\n\n",
 		TS_OUTPUT_NAME,
+		SCTE35_OUTPUT_NAME,
 		basename((char *)progname),
 		basename((char *)progname),
 		basename((char *)progname),
@@ -1144,7 +1422,7 @@ static int _main(int argc, char *argv[])
 	pthread_mutex_init(&sleepMutex, NULL);
 	pthread_cond_init(&sleepCond, NULL);
 
-	while ((ch = getopt(argc, argv, "?h3c:s:f:a:m:n:p:t:vV:I:i:l:LP:M")) != -1) {
+	while ((ch = getopt(argc, argv, "?h3c:s:f:a:m:n:p:t:vV:C:I:i:j:l:LP:MST:X:")) != -1) {
 		switch (ch) {
 		case 'm':
 			g_videoModeIndex = atoi(optarg);
@@ -1172,9 +1450,21 @@ static int _main(int argc, char *argv[])
 		case 'I':
 			g_vancInputFilename = optarg;
 			break;
+		case 'X':
+			g_pixelTestFilename = optarg;
+			break;
 		case 'i':
 			portnr = atoi(optarg);
 			break;
+		case 'j':
+			g_workerThreads = atoi(optarg);
+			break;
+		case 'S':
+			g_parserStats = 1;
+			break;
+		case 'C':
+			g_captionChannel = atoi(optarg);
+			break;
 		case 'l':
 			g_linenr = atoi(optarg);
 			break;
@@ -1219,6 +1509,8 @@ static int _main(int argc, char *argv[])
 				g_timecodeFormat = bmdTimecodeVITC;
 			else if (!strcmp(optarg, "serial"))
 				g_timecodeFormat = bmdTimecodeSerial;
+			else if (!strcmp(optarg, "atc"))
+				g_timecodeATC = 1;
 			else {
 				fprintf(stderr, "Invalid argument: Timecode format \"%s\" is invalid\n", optarg);
 				goto bail;
@@ -1232,6 +1524,10 @@ static int _main(int argc, char *argv[])
 				/* Success */
 			}
 			break;
+		case 'T':
+			if ((sscanf(optarg, "0x%x", &g_scte35PID) != 1) || (g_scte35PID == 0) || (g_scte35PID > 0x1fff))
+				wantHelp = true;
+			break;
 		case '?':
 		case 'h':
 			wantHelp = true;
@@ -1243,6 +1539,9 @@ static int _main(int argc, char *argv[])
 		goto bail;
 	}
 
+	if (g_scte35PID)
+		unlink(SCTE35_OUTPUT_NAME);
+
  	if (g_packetizeSMPTE2038) {
 		unlink(TS_OUTPUT_NAME);
 		if (smpte2038_packetizer_alloc(&smpte2038_ctx) < 0) {
@@ -1261,8 +1560,25 @@ static int _main(int argc, char *argv[])
 	vanchdl->verbose = g_verbose;
 	vanchdl->callbacks = &callbacks;
 
+	if (g_workerThreads && vanc_context_enable_workers(vanchdl, g_workerThreads) < 0) {
+		fprintf(stderr, "Unable to start %d VANC worker threads, parsing line by line.\n", g_workerThreads);
+		g_workerThreads = 0;
+	}
+
+	if (g_parserStats)
+		vanc_context_enable_stats_timing(vanchdl, 1);
+
+	if (g_captionChannel)
+		vanc_context_enable_eia_608_decoder(vanchdl, 1);
+
+	if (g_pixelTestFilename != NULL)
+		return SelfTestPixels(g_pixelTestFilename);
+
 	if (g_vancInputFilename != NULL) {
-		return AnalyzeVANC(g_vancInputFilename);
+		int ret = AnalyzeVANC(g_vancInputFilename);
+		if (g_parserStats)
+			vanc_context_dump_stats(vanchdl);
+		return ret;
 	}
 
 
@@ -1412,6 +1728,8 @@ static int _main(int argc, char *argv[])
 #if HAVE_CURSES_H
 	vanc_monitor_stats_dump();
 #endif
+	if (g_parserStats)
+		vanc_context_dump_stats(vanchdl);
         vanc_context_destroy(vanchdl);
 	smpte2038_packetizer_free(&smpte2038_ctx);
 
@@ -21,6 +21,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 #include <libklvanc/vanc.h>
 
 /* CALLBACKS for message notification */
@@ -80,6 +82,25 @@ static int cb_VANC_TYPE_KL_UINT64_COUNTER(void *callback_context, struct vanc_co
 	return 0;
 }
 
+static int cb_frame_begin(void *callback_context, struct vanc_context_s *ctx, struct vanc_frame_s *frame)
+{
+	printf("%s:%s() frame %" PRIu64 ", %d lines\n", __FILE__, __func__, frame->frameNr, frame->lineCount);
+	return 0;
+}
+
+static int cb_frame_end(void *callback_context, struct vanc_context_s *ctx, struct vanc_frame_s *frame)
+{
+	printf("%s:%s() frame %" PRIu64 ", %d packets\n", __FILE__, __func__, frame->frameNr, frame->packetCount);
+
+	/* Every decoded packet in the frame, by type, without any per-line bookkeeping */
+	for (int i = 0; i < frame->types[VANC_TYPE_PAYLOAD_INFORMATION].count; i++) {
+		struct packet_payload_information_s *pkt = frame->types[VANC_TYPE_PAYLOAD_INFORMATION].packets[i];
+		printf("  AFD 0x%02x from line %d\n", pkt->afd, pkt->hdr.lineNr);
+	}
+
+	return 0;
+}
+
 static struct vanc_callbacks_s callbacks = 
 {
 	.payload_information	= cb_PAYLOAD_INFORMATION,
@@ -88,6 +109,8 @@ static struct vanc_callbacks_s callbacks =
 	.scte_104		= cb_SCTE_104,
 	.all			= cb_all,
 	.kl_i64le_counter	= cb_VANC_TYPE_KL_UINT64_COUNTER,
+	.frame_begin		= cb_frame_begin,
+	.frame_end		= cb_frame_end,
 };
 /* END - CALLBACKS for message notification */
 
@@ -144,6 +167,35 @@ static int test_EIA_708B(struct vanc_context_s *ctx)
 	return 0;
 }
 
+static int test_frame(struct vanc_context_s *ctx)
+{
+	unsigned short line13[] = {
+		0x000, 0x3ff, 0x3ff, 0x241, 0x105, 0x108,
+		0x07c, 0x000, 0x000, 0x000, 0x000, 0x010, 0x000, 0x008,
+		0x2e2,
+	};
+	unsigned short line14[] = {
+		0x040, 0x040, 0x040, 0x040, 0x040, 0x040, 0x040, 0x040,
+	};
+
+	struct vanc_frame_line_s lines[] = {
+		{ 13, line13, sizeof(line13) / sizeof(unsigned short) },
+		{ 14, line14, sizeof(line14) / sizeof(unsigned short) },
+	};
+
+	struct vanc_frame_s frame = { 0 };
+	frame.lines = lines;
+	frame.lineCount = sizeof(lines) / sizeof(lines[0]);
+	frame.pts = VANC_NOPTS_VALUE;
+	frame.streamTime = VANC_NOPTS_VALUE;
+
+	int ret = vanc_frame_parse(ctx, &frame);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
 static int test_checksum()
 {
 	/* 3 words ADF, 31 words of message, 1 words checksum */
@@ -176,11 +228,581 @@ static int test_checksum()
 	return 0;
 }
 
-int demo_main(int argc, char *argv[])
+/* Round trip tests. Encode a struct with its vanc_encode_*() helper, parse the words on a
+ * quiet context of its own, and compare what the decoder hands the callback with what went
+ * in. Each callback checks against rt->expected and counts what doesn't match.
+ */
+struct roundtrip_s
+{
+	const void *expected;
+	int delivered;
+	int mismatches;
+};
+
+#define RT_CHECK(rt, cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s: failed '%s'\n", __func__, #cond); \
+			(rt)->mismatches++; \
+		} \
+	} while (0)
+
+static int roundtrip_parse(struct vanc_callbacks_s *cbs, struct roundtrip_s *rt, uint16_t *words, int wordCount)
 {
 	struct vanc_context_s *ctx;
+
+	if (wordCount < 0)
+		return wordCount;
+
+	/* The encoders frame packets, so the checksum over DID through the checksum word must hold. */
+	if (wordCount < 7 || !vanc_checksum_is_valid(&words[3], (words[5] & 0xff) + 4))
+		return -1;
+
+	if (vanc_context_create(&ctx) < 0)
+		return -1;
+	ctx->callbacks = cbs;
+	ctx->callback_context = rt;
+
+	int ret = vanc_packet_parse(ctx, 9, words, wordCount);
+	vanc_context_destroy(ctx);
+	if (ret < 0)
+		return ret;
+
+	if (rt->delivered != 1 || rt->mismatches)
+		return -1;
+
+	return 0;
+}
+
+static int rt_PAYLOAD_INFORMATION(void *callback_context, struct vanc_context_s *ctx, struct packet_payload_information_s *pkt)
+{
+	struct roundtrip_s *rt = callback_context;
+	const struct packet_payload_information_s *e = rt->expected;
+
+	rt->delivered++;
+	RT_CHECK(rt, pkt->hdr.checksumValid);
+	RT_CHECK(rt, pkt->afd == e->afd);
+	RT_CHECK(rt, pkt->aspectRatio == e->aspectRatio);
+	RT_CHECK(rt, pkt->barDataFlags == e->barDataFlags);
+	RT_CHECK(rt, pkt->barDataValue[0] == e->barDataValue[0]);
+	RT_CHECK(rt, pkt->barDataValue[1] == e->barDataValue[1]);
+
+	return 0;
+}
+
+static int test_PAYLOAD_INFORMATION_roundtrip()
+{
+	struct packet_payload_information_s pkt = { 0 };
+	pkt.afd = AFD_16x9_WITH_ALTERNATIVE_4x3_CENTER;
+	pkt.aspectRatio = ASPECT_16x9;
+	pkt.barDataFlags = 0x0c;
+	pkt.barDataValue[0] = 0x0123;
+	pkt.barDataValue[1] = 0x3ed;
+
+	struct vanc_callbacks_s cbs = { .payload_information = rt_PAYLOAD_INFORMATION };
+	struct roundtrip_s rt = { &pkt, 0, 0 };
+	uint16_t words[VANC_PACKET_WORDS_MAX];
+
+	int ret = roundtrip_parse(&cbs, &rt, words, vanc_encode_payload_information(&pkt, words, VANC_PACKET_WORDS_MAX));
+	if (ret < 0)
+		return ret;
+
+	printf("PAYLOAD_INFORMATION round trip passed.\n");
+
+	return 0;
+}
+
+static int rt_EIA_608(void *callback_context, struct vanc_context_s *ctx, struct packet_eia_608_s *pkt)
+{
+	struct roundtrip_s *rt = callback_context;
+	const struct packet_eia_608_s *e = rt->expected;
+
+	rt->delivered++;
+	RT_CHECK(rt, pkt->hdr.checksumValid);
+	RT_CHECK(rt, pkt->field == e->field);
+	RT_CHECK(rt, pkt->line_offset == e->line_offset);
+	RT_CHECK(rt, pkt->cc_data_1 == e->cc_data_1);
+	RT_CHECK(rt, pkt->cc_data_2 == e->cc_data_2);
+
+	return 0;
+}
+
+static int test_EIA_608_roundtrip()
+{
+	struct packet_eia_608_s pkt = { 0 };
+	pkt.field = 2;
+	pkt.line_offset = 12;
+	pkt.cc_data_1 = 0x94;
+	pkt.cc_data_2 = 0x2c;
+
+	struct vanc_callbacks_s cbs = { .eia_608 = rt_EIA_608 };
+	struct roundtrip_s rt = { &pkt, 0, 0 };
+	uint16_t words[VANC_PACKET_WORDS_MAX];
+
+	int ret = roundtrip_parse(&cbs, &rt, words, vanc_encode_eia_608(&pkt, words, VANC_PACKET_WORDS_MAX));
+	if (ret < 0)
+		return ret;
+
+	printf("EIA_608 round trip passed.\n");
+
+	return 0;
+}
+
+static int rt_EIA_708B(void *callback_context, struct vanc_context_s *ctx, struct packet_eia_708b_s *pkt)
+{
+	struct roundtrip_s *rt = callback_context;
+	const struct packet_eia_708b_s *e = rt->expected;
+
+	rt->delivered++;
+	RT_CHECK(rt, pkt->hdr.checksumValid);
+
+	/* CDP framing: the length covers the header, every section and the footer. */
+	RT_CHECK(rt, pkt->cdp_identifier == EIA_708B_CDP_IDENTIFIER);
+	RT_CHECK(rt, pkt->cdp_length == 7 + 5 + 2 + (e->cc_count * 3) + 2 + (e->svc_count * 7) + 4);
+	RT_CHECK(rt, pkt->cdp_length == pkt->hdr.payloadLengthWords);
+	RT_CHECK(rt, pkt->checksum_valid);
+	RT_CHECK(rt, pkt->sequence_valid);
+	RT_CHECK(rt, pkt->cdp_footer_sequence_cntr == e->cdp_hdr_sequence_cntr);
+
+	RT_CHECK(rt, pkt->cdp_frame_rate == e->cdp_frame_rate);
+	RT_CHECK(rt, pkt->caption_service_active == e->caption_service_active);
+	RT_CHECK(rt, pkt->cdp_hdr_sequence_cntr == e->cdp_hdr_sequence_cntr);
+
+	RT_CHECK(rt, pkt->time_code_present == e->time_code_present);
+	RT_CHECK(rt, pkt->tc_hours == e->tc_hours);
+	RT_CHECK(rt, pkt->tc_minutes == e->tc_minutes);
+	RT_CHECK(rt, pkt->tc_seconds == e->tc_seconds);
+	RT_CHECK(rt, pkt->tc_frames == e->tc_frames);
+	RT_CHECK(rt, pkt->tc_field_flag == e->tc_field_flag);
+	RT_CHECK(rt, pkt->tc_drop_frame == e->tc_drop_frame);
+
+	RT_CHECK(rt, pkt->ccdata_present == e->ccdata_present);
+	RT_CHECK(rt, pkt->cc_count == e->cc_count);
+	for (int i = 0; i < pkt->cc_count && i < e->cc_count; i++) {
+		RT_CHECK(rt, pkt->cc_data[i].cc_valid == e->cc_data[i].cc_valid);
+		RT_CHECK(rt, pkt->cc_data[i].cc_type == e->cc_data[i].cc_type);
+		RT_CHECK(rt, pkt->cc_data[i].cc_data[0] == e->cc_data[i].cc_data[0]);
+		RT_CHECK(rt, pkt->cc_data[i].cc_data[1] == e->cc_data[i].cc_data[1]);
+	}
+
+	RT_CHECK(rt, pkt->svcinfo_present == e->svcinfo_present);
+	RT_CHECK(rt, pkt->svc_info_start == e->svc_info_start);
+	RT_CHECK(rt, pkt->svc_info_complete == e->svc_info_complete);
+	RT_CHECK(rt, pkt->svc_count == e->svc_count);
+	for (int i = 0; i < pkt->svc_count && i < e->svc_count; i++) {
+		RT_CHECK(rt, pkt->svc[i].caption_service_number == e->svc[i].caption_service_number);
+		RT_CHECK(rt, memcmp(pkt->svc[i].svc_data_byte, e->svc[i].svc_data_byte, sizeof(e->svc[i].svc_data_byte)) == 0);
+		RT_CHECK(rt, strcmp(pkt->svc[i].language, "eng") == 0);
+	}
+
+	return 0;
+}
+
+static int rt_EIA_708B_corrupt(void *callback_context, struct vanc_context_s *ctx, struct packet_eia_708b_s *pkt)
+{
+	struct roundtrip_s *rt = callback_context;
+
+	rt->delivered++;
+	RT_CHECK(rt, pkt->hdr.checksumValid);
+	RT_CHECK(rt, !pkt->checksum_valid);
+
+	return 0;
+}
+
+static int test_EIA_708B_roundtrip()
+{
+	struct packet_eia_708b_s pkt = { 0 };
+	pkt.cdp_frame_rate = 0x07;	/* 59.94 */
+	pkt.caption_service_active = 1;
+	pkt.cdp_hdr_sequence_cntr = 0xbeef;
+
+	pkt.time_code_present = 1;
+	pkt.tc_hours = 23;
+	pkt.tc_minutes = 59;
+	pkt.tc_seconds = 58;
+	pkt.tc_frames = 29;
+	pkt.tc_drop_frame = 1;
+
+	pkt.ccdata_present = 1;
+	pkt.cc_count = 3;
+	pkt.cc_data[0] = (struct eia_708b_cc_data_s){ 1, 0, { 0x94, 0x2c } };
+	pkt.cc_data[1] = (struct eia_708b_cc_data_s){ 0, 1, { 0x80, 0x80 } };
+	pkt.cc_data[2] = (struct eia_708b_cc_data_s){ 1, 3, { 0x02, 0x21 } };
+
+	pkt.svcinfo_present = 1;
+	pkt.svc_info_start = 1;
+	pkt.svc_info_complete = 1;
+	pkt.svc_count = 1;
+	pkt.svc[0].caption_service_number = 1;
+	memcpy(pkt.svc[0].svc_data_byte, "eng\x41\x3f\xff", 6);
+
+	struct vanc_callbacks_s cbs = { .eia_708b = rt_EIA_708B };
+	struct roundtrip_s rt = { &pkt, 0, 0 };
+	uint16_t words[VANC_PACKET_WORDS_MAX];
+
+	int len = vanc_encode_eia_708b(&pkt, words, VANC_PACKET_WORDS_MAX);
+	int ret = roundtrip_parse(&cbs, &rt, words, len);
+	if (ret < 0)
+		return ret;
+
+	/* Flip a caption byte inside the CDP and reframe it. The ancillary checksum is
+	 * recomputed and still holds, the CDP checksum no longer does.
+	 */
+	uint8_t cdp[VANC_PAYLOAD_WORDS_MAX];
+	int cdpLength = words[5] & 0xff;
+	for (int i = 0; i < cdpLength; i++)
+		cdp[i] = words[6 + i];
+	cdp[7 + 5 + 2 + 1] ^= 0x01;
+
+	cbs.eia_708b = rt_EIA_708B_corrupt;
+	rt.delivered = 0;
+	ret = roundtrip_parse(&cbs, &rt, words, vanc_encode_packet(0x61, 0x01, cdp, cdpLength, words, VANC_PACKET_WORDS_MAX));
+	if (ret < 0)
+		return ret;
+
+	printf("EIA_708B round trip passed.\n");
+
+	return 0;
+}
+
+static int rt_KL_UINT64_COUNTER(void *callback_context, struct vanc_context_s *ctx, struct packet_kl_u64le_counter_s *pkt)
+{
+	struct roundtrip_s *rt = callback_context;
+	const struct packet_kl_u64le_counter_s *e = rt->expected;
+
+	rt->delivered++;
+	RT_CHECK(rt, pkt->hdr.checksumValid);
+	RT_CHECK(rt, pkt->counter == e->counter);
+
+	return 0;
+}
+
+static int test_KL_UINT64_COUNTER_roundtrip()
+{
+	struct packet_kl_u64le_counter_s pkt = { 0 };
+	pkt.counter = 0x0123456789abcdefULL;
+
+	struct vanc_callbacks_s cbs = { .kl_i64le_counter = rt_KL_UINT64_COUNTER };
+	struct roundtrip_s rt = { &pkt, 0, 0 };
+	uint16_t words[VANC_PACKET_WORDS_MAX];
+
+	int ret = roundtrip_parse(&cbs, &rt, words, vanc_encode_kl_u64le_counter(&pkt, words, VANC_PACKET_WORDS_MAX));
+	if (ret < 0)
+		return ret;
+
+	printf("KL_UINT64_COUNTER round trip passed.\n");
+
+	return 0;
+}
+
+static void rt_splice_request_data(struct roundtrip_s *rt, const struct splice_request_data *d, const struct splice_request_data *e)
+{
+	RT_CHECK(rt, d->splice_insert_type == e->splice_insert_type);
+	RT_CHECK(rt, d->splice_event_id == e->splice_event_id);
+	RT_CHECK(rt, d->unique_program_id == e->unique_program_id);
+	RT_CHECK(rt, d->pre_roll_time == e->pre_roll_time);
+	RT_CHECK(rt, d->brk_duration == e->brk_duration);
+	RT_CHECK(rt, d->avail_num == e->avail_num);
+	RT_CHECK(rt, d->avails_expected == e->avails_expected);
+	RT_CHECK(rt, d->auto_return_flag == e->auto_return_flag);
+}
+
+static int rt_SCTE_104(void *callback_context, struct vanc_context_s *ctx, struct packet_scte_104_s *pkt)
+{
+	struct roundtrip_s *rt = callback_context;
+	const struct packet_scte_104_s *e = rt->expected;
+
+	rt->delivered++;
+	RT_CHECK(rt, pkt->hdr.checksumValid);
+	RT_CHECK(rt, pkt->version == 1);
+	RT_CHECK(rt, pkt->so_msg.opID == e->so_msg.opID);
+	RT_CHECK(rt, ((pkt->payload[2] << 8) | pkt->payload[3]) == pkt->payloadLengthBytes);
+
+	if (e->so_msg.opID == SO_INIT_REQUEST_DATA) {
+		RT_CHECK(rt, pkt->so_msg.protocol_version == e->so_msg.protocol_version);
+		RT_CHECK(rt, pkt->so_msg.AS_index == e->so_msg.AS_index);
+		RT_CHECK(rt, pkt->so_msg.message_number == e->so_msg.message_number);
+		RT_CHECK(rt, pkt->so_msg.DPI_PID_index == e->so_msg.DPI_PID_index);
+		rt_splice_request_data(rt, &pkt->sr_data, &e->sr_data);
+		return 0;
+	}
+
+	const struct multiple_operation_message *m = &pkt->mo_msg;
+	const struct multiple_operation_message *em = &e->mo_msg;
+	RT_CHECK(rt, m->AS_index == em->AS_index);
+	RT_CHECK(rt, m->message_number == em->message_number);
+	RT_CHECK(rt, m->DPI_PID_index == em->DPI_PID_index);
+	RT_CHECK(rt, m->timestamp.time_type == em->timestamp.time_type);
+	RT_CHECK(rt, m->timestamp.time_type_2.hours == em->timestamp.time_type_2.hours);
+	RT_CHECK(rt, m->timestamp.time_type_2.minutes == em->timestamp.time_type_2.minutes);
+	RT_CHECK(rt, m->timestamp.time_type_2.seconds == em->timestamp.time_type_2.seconds);
+	RT_CHECK(rt, m->timestamp.time_type_2.frames == em->timestamp.time_type_2.frames);
+	RT_CHECK(rt, m->num_ops == em->num_ops);
+	if (m->num_ops != em->num_ops)
+		return 0;
+
+	for (int i = 0; i < m->num_ops; i++) {
+		struct multiple_operation_message_operation *o = &m->ops[i];
+		const struct multiple_operation_message_operation *eo = &em->ops[i];
+
+		RT_CHECK(rt, o->opID == eo->opID);
+		if (eo->data) {
+			RT_CHECK(rt, o->data_length == eo->data_length);
+			RT_CHECK(rt, o->data_length == eo->data_length && memcmp(o->data, eo->data, eo->data_length) == 0);
+			continue;
+		}
+
+		RT_CHECK(rt, scte_104_decode_mom_op(o) == 0);
+		switch (eo->opID) {
+		case MO_SPLICE_REQUEST_DATA:
+			rt_splice_request_data(rt, &o->sr_data, &eo->sr_data);
+			break;
+		case MO_TIME_SIGNAL_REQUEST_DATA:
+			RT_CHECK(rt, o->timesignal_data.pre_roll_time == eo->timesignal_data.pre_roll_time);
+			break;
+		case MO_INSERT_SEGMENTATION_REQUEST_DATA: {
+			const struct scte104_segmentation_descriptor_request_data *d = &o->segmentation_data;
+			const struct scte104_segmentation_descriptor_request_data *ed = &eo->segmentation_data;
+			RT_CHECK(rt, d->segmentation_event_id == ed->segmentation_event_id);
+			RT_CHECK(rt, d->duration == ed->duration);
+			RT_CHECK(rt, d->segmentation_upid_type == ed->segmentation_upid_type);
+			RT_CHECK(rt, d->segmentation_upid_length == ed->segmentation_upid_length);
+			RT_CHECK(rt, d->segmentation_upid_length == ed->segmentation_upid_length &&
+				memcmp(d->segmentation_upid, ed->segmentation_upid, ed->segmentation_upid_length) == 0);
+			RT_CHECK(rt, d->segmentation_type_id == ed->segmentation_type_id);
+			RT_CHECK(rt, d->segment_num == ed->segment_num);
+			RT_CHECK(rt, d->segments_expected == ed->segments_expected);
+			RT_CHECK(rt, d->delivery_not_restricted_flag == ed->delivery_not_restricted_flag);
+			RT_CHECK(rt, d->archive_allowed_flag == ed->archive_allowed_flag);
+			RT_CHECK(rt, d->device_restrictions == ed->device_restrictions);
+			break;
+		}
+		}
+	}
+
+	return 0;
+}
+
+static int test_SCTE_104_roundtrip()
+{
+	struct vanc_callbacks_s cbs = { .scte_104 = rt_SCTE_104 };
+	uint16_t words[VANC_PACKET_WORDS_MAX * 2];
 	int ret;
 
+	/* Single operation message, the decoder only takes immediate splices in a SOM. */
+	struct packet_scte_104_s som;
+	memset(&som, 0, sizeof(som));
+	som.so_msg.opID = SO_INIT_REQUEST_DATA;
+	som.so_msg.message_number = 7;
+	som.so_msg.DPI_PID_index = 0x0102;
+	som.sr_data.splice_insert_type = SPLICESTART_IMMEDIATE;
+	som.sr_data.splice_event_id = 0x11223344;
+	som.sr_data.unique_program_id = 0x5566;
+	som.sr_data.pre_roll_time = 4000;
+	som.sr_data.brk_duration = 300;
+	som.sr_data.avail_num = 1;
+	som.sr_data.avails_expected = 2;
+	som.sr_data.auto_return_flag = 1;
+
+	struct roundtrip_s rt = { &som, 0, 0 };
+	ret = roundtrip_parse(&cbs, &rt, words, vanc_encode_scte_104(&som, words, VANC_PACKET_WORDS_MAX));
+	if (ret < 0)
+		return ret;
+
+	/* Multiple operation message, typed operations serialized by the encoder */
+	static const unsigned char upid[] = { 'A', 'B', 'C', 'D', '0', '1', '2', '3' };
+	struct multiple_operation_message_operation ops[3];
+	memset(ops, 0, sizeof(ops));
+	ops[0].opID = MO_SPLICE_REQUEST_DATA;
+	ops[0].sr_data = som.sr_data;
+	ops[1].opID = MO_TIME_SIGNAL_REQUEST_DATA;
+	ops[1].timesignal_data.pre_roll_time = 2000;
+	ops[2].opID = MO_INSERT_SEGMENTATION_REQUEST_DATA;
+	ops[2].segmentation_data.segmentation_event_id = 0xcafe0001;
+	ops[2].segmentation_data.duration = 60;
+	ops[2].segmentation_data.segmentation_upid_type = 0x0c;
+	ops[2].segmentation_data.segmentation_upid_length = sizeof(upid);
+	ops[2].segmentation_data.segmentation_upid = upid;
+	ops[2].segmentation_data.segmentation_type_id = 0x34;
+	ops[2].segmentation_data.segment_num = 1;
+	ops[2].segmentation_data.segments_expected = 1;
+	ops[2].segmentation_data.delivery_not_restricted_flag = 0;
+	ops[2].segmentation_data.archive_allowed_flag = 1;
+	ops[2].segmentation_data.device_restrictions = 2;
+
+	struct packet_scte_104_s mom;
+	memset(&mom, 0, sizeof(mom));
+	mom.so_msg.opID = 0xFFFF;
+	mom.mo_msg.AS_index = 1;
+	mom.mo_msg.message_number = 9;
+	mom.mo_msg.timestamp.time_type = 2;
+	mom.mo_msg.timestamp.time_type_2.hours = 1;
+	mom.mo_msg.timestamp.time_type_2.minutes = 2;
+	mom.mo_msg.timestamp.time_type_2.seconds = 3;
+	mom.mo_msg.timestamp.time_type_2.frames = 4;
+	mom.mo_msg.num_ops = 3;
+	mom.mo_msg.ops = ops;
+
+	rt = (struct roundtrip_s){ &mom, 0, 0 };
+	ret = roundtrip_parse(&cbs, &rt, words, vanc_encode_scte_104(&mom, words, VANC_PACKET_WORDS_MAX));
+	if (ret < 0)
+		return ret;
+
+	/* Too long for one packet, a raw proprietary operation splits the message over two
+	 * packets, the context reassembles them.
+	 */
+	unsigned char proprietary[300];
+	for (unsigned int i = 0; i < sizeof(proprietary); i++)
+		proprietary[i] = i;
+	ops[2].opID = MO_PROPRIETARY_COMMAND_REQUEST_DATA;
+	ops[2].data = proprietary;
+	ops[2].data_length = sizeof(proprietary);
+
+	rt = (struct roundtrip_s){ &mom, 0, 0 };
+	ret = vanc_encode_scte_104(&mom, words, VANC_PACKET_WORDS_MAX * 2);
+	if (ret <= VANC_PACKET_WORDS_MAX)
+		return -1;
+	ret = roundtrip_parse(&cbs, &rt, words, ret);
+	if (ret < 0)
+		return ret;
+
+	printf("SCTE_104 round trip passed.\n");
+
+	return 0;
+}
+
+/* Run every runtime dispatched v210 kernel against its C reference, whatever instruction
+ * set klvanc_pixels_isa() picked. Lines are random NV20 packed by the C packer, at widths
+ * with and without a partial group. ADFs are planted along the luma and the chroma for
+ * the ADF search. Outputs are compared over the whole buffer, so stray writes show too.
+ */
+#define PIXELS_WIDTH_MAX 3840
+#define PIXELS_SAMPLES ((PIXELS_WIDTH_MAX * 3) + 64)
+
+static int pixels_compare(const char *kernel, int width, const uint16_t *ref, const uint16_t *simd)
+{
+	if (memcmp(ref, simd, PIXELS_SAMPLES * sizeof(uint16_t)) == 0)
+		return 0;
+
+	fprintf(stderr, "%s() %s %s kernel differs from C at width %d\n", __func__, klvanc_pixels_isa(), kernel, width);
+	return 1;
+}
+
+static int pixels_find_adf(const uint32_t *v210, int width)
+{
+	int groups = (width / 6) * 6;
+	int ref = klvanc_v210_line_find_adf_c(v210, groups);
+
+	if (klvanc_v210_line_find_adf(v210, groups) != ref) {
+		fprintf(stderr, "%s() %s find_adf kernel differs from C at width %d\n", __func__, klvanc_pixels_isa(), width);
+		return -2;
+	}
+
+	return ref;
+}
+
+static int test_pixels()
+{
+	static const int widths[] = { 6, 7, 12, 17, 720, 1280, 1918, 1920, PIXELS_WIDTH_MAX };
+	unsigned int bytes = PIXELS_SAMPLES * sizeof(uint16_t);
+	uint16_t *nv20 = malloc(bytes);
+	uint16_t *ref = malloc(bytes);
+	uint16_t *simd = malloc(bytes);
+	uint32_t *v210 = malloc(bytes);
+	int failed = 0;
+
+	if (!nv20 || !ref || !simd || !v210) {
+		free(nv20);
+		free(ref);
+		free(simd);
+		free(v210);
+		return -1;
+	}
+
+	srand(2016);
+	for (unsigned int n = 0; n < sizeof(widths) / sizeof(widths[0]); n++) {
+		int w = widths[n];
+
+		for (int i = 0; i < w * 2; i++)
+			nv20[i] = rand() & 0x3ff;
+		memset(v210, 0, bytes);
+		klvanc_nv20_line_to_v210_c(nv20, v210, bytes, w);
+
+		memset(ref, 0xa5, bytes);
+		memset(simd, 0xa5, bytes);
+		klvanc_v210_line_to_nv20_c(v210, ref, bytes, w);
+		klvanc_v210_line_to_nv20(v210, simd, bytes, w);
+		failed += pixels_compare("v210_line_to_nv20", w, ref, simd);
+
+		memset(ref, 0xa5, bytes);
+		memset(simd, 0xa5, bytes);
+		klvanc_v210_line_to_uyvy_c(v210, ref, w);
+		klvanc_v210_line_to_uyvy(v210, simd, w);
+		failed += pixels_compare("v210_line_to_uyvy", w, ref, simd);
+
+		memset(ref, 0xa5, bytes);
+		memset(simd, 0xa5, bytes);
+		klvanc_v210_planar_unpack_c(v210, ref, ref + w, ref + (w * 2), w);
+		klvanc_v210_planar_unpack(v210, simd, simd + w, simd + (w * 2), w);
+		failed += pixels_compare("v210_planar_unpack", w, ref, simd);
+
+		memset(ref, 0xa5, bytes);
+		memset(simd, 0xa5, bytes);
+		klvanc_nv20_line_to_v210_c(nv20, (uint32_t *)ref, bytes, w);
+		klvanc_nv20_line_to_v210(nv20, (uint32_t *)simd, bytes, w);
+		failed += pixels_compare("nv20_line_to_v210", w, ref, simd);
+
+		/* The same random samples do as a UYVY line. */
+		memset(ref, 0xa5, bytes);
+		memset(simd, 0xa5, bytes);
+		klvanc_uyvy16_line_to_v210_c(nv20, (uint32_t *)ref, bytes, w);
+		klvanc_uyvy16_line_to_v210(nv20, (uint32_t *)simd, bytes, w);
+		failed += pixels_compare("uyvy16_line_to_v210", w, ref, simd);
+
+		/* An ADF at each position in the whole groups, luma then chroma, must be found. */
+		int step = w < 60 ? 1 : w / 29;
+		for (int plane = 0; plane < 2; plane++) {
+			uint16_t *p = nv20 + (plane * w);
+			for (int pos = 0; pos + 3 <= (w / 6) * 6; pos += step) {
+				uint16_t saved[3] = { p[pos], p[pos + 1], p[pos + 2] };
+				p[pos] = 0x000;
+				p[pos + 1] = 0x3ff;
+				p[pos + 2] = 0x3ff;
+				klvanc_nv20_line_to_v210_c(nv20, v210, bytes, w);
+
+				int ret = pixels_find_adf(v210, w);
+				if (ret == -1)
+					fprintf(stderr, "%s() ADF at %d of plane %d not found at width %d\n", __func__, pos, plane, w);
+				if (ret < 0)
+					failed++;
+
+				memcpy(&p[pos], saved, sizeof(saved));
+			}
+		}
+
+		klvanc_nv20_line_to_v210_c(nv20, v210, bytes, w);
+		if (pixels_find_adf(v210, w) == -2)
+			failed++;
+	}
+
+	free(nv20);
+	free(ref);
+	free(simd);
+	free(v210);
+
+	if (failed)
+		return -1;
+
+	printf("Pixel kernel test passed, %s kernels.\n", klvanc_pixels_isa());
+
+	return 0;
+}
+
+int demo_main(int argc, char *argv[])
+{
+	struct vanc_context_s *ctx;
+	int ret, failed = 0;
+
 	if (vanc_context_create(&ctx) < 0) {
 		fprintf(stderr, "Error initializing library context\n");
 		exit(1);
@@ -190,19 +812,67 @@ int demo_main(int argc, char *argv[])
 	printf("Library initialized.\n");
 
 	ret = test_PAYLOAD_INFORMATION(ctx);
-	if (ret < 0)
+	if (ret < 0) {
 		fprintf(stderr, "PAYLOAD_INFORMATION failed to parse\n");
+		failed++;
+	}
 
 	ret = test_EIA_708B(ctx);
-	if (ret < 0)
+	if (ret < 0) {
 		fprintf(stderr, "EIA_708B failed to parse\n");
+		failed++;
+	}
+
+	ret = test_frame(ctx);
+	if (ret < 0) {
+		fprintf(stderr, "Frame failed to parse\n");
+		failed++;
+	}
 
 	ret = test_checksum();
-	if (ret < 0)
+	if (ret < 0) {
 		fprintf(stderr, "Checksum calculation failed\n");
+		failed++;
+	}
+
+	ret = test_PAYLOAD_INFORMATION_roundtrip();
+	if (ret < 0) {
+		fprintf(stderr, "PAYLOAD_INFORMATION round trip failed\n");
+		failed++;
+	}
+
+	ret = test_EIA_608_roundtrip();
+	if (ret < 0) {
+		fprintf(stderr, "EIA_608 round trip failed\n");
+		failed++;
+	}
+
+	ret = test_EIA_708B_roundtrip();
+	if (ret < 0) {
+		fprintf(stderr, "EIA_708B round trip failed\n");
+		failed++;
+	}
+
+	ret = test_KL_UINT64_COUNTER_roundtrip();
+	if (ret < 0) {
+		fprintf(stderr, "KL_UINT64_COUNTER round trip failed\n");
+		failed++;
+	}
+
+	ret = test_SCTE_104_roundtrip();
+	if (ret < 0) {
+		fprintf(stderr, "SCTE_104 round trip failed\n");
+		failed++;
+	}
+
+	ret = test_pixels();
+	if (ret < 0) {
+		fprintf(stderr, "Pixel kernel test failed\n");
+		failed++;
+	}
 
 	vanc_context_destroy(ctx);
 	printf("Library destroyed.\n");
 
-	return 0;
+	return failed ? 1 : 0;
 }
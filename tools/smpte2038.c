@@ -87,11 +87,13 @@ pes_extractor_callback pes_cb(void *cb_context, uint8_t *buf, int byteCount)
 		for (int i = 0; i < pkt->lineCount; i++) {
 			struct smpte2038_anc_data_line_s *l = &pkt->lines[i];
 
-			uint16_t *words;
-			uint16_t wordCount;
-			if (smpte2038_convert_line_to_words(l, &words, &wordCount) < 0)
+			struct buffer_s *buf;
+			if (smpte2038_convert_line_to_buffer(l, &buf) < 0)
 				break;
 
+			uint16_t *words = (uint16_t *)buf->ptr;
+			uint16_t wordCount = buf->used / sizeof(uint16_t);
+
 			if (ctx->verbose > 1) {
 				printf("LineEntry[%d]: ", i);
 				for (int j = 0; j < wordCount; j++)
@@ -113,7 +115,7 @@ pes_extractor_callback pes_cb(void *cb_context, uint8_t *buf, int byteCount)
 			}
 			vanc_context_destroy(vanchdl);
 
-			free(words); /* Caller must free the resource */
+			vanc_buffer_free(buf); /* Caller must return the buffer to the pool */
 
 		}
 